@@ -0,0 +1,574 @@
+//
+//  noise_benchmark.cpp
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+#include "src/volume_core.h"
+
+// Throughput of the CPU noise kernels and of whole-volume generation, in voxels per
+// second, one JSON line per measurement:
+//
+//     noise          scalar double Perlin noise(), one sample per voxel
+//     noise_batch    noiseBatch on the same samples, with the dispatched SIMD kernel
+//     fbm            noiseLayer, per octave count
+//     fbm_row        noiseLayerRow on the same voxels
+//     voronoi        the brute-force voronoi() volume, per feature-point count (up to 64³)
+//     worley_grid    WorleyGrid::Distance on the same feature points
+//     generate       GenerateNoiseVolume, per thread count
+//
+// The per-voxel kernels run over the first few Z-slices of each size³ volume so the
+// scalar ones stay affordable at 256³; generate always fills the whole volume. Before
+// timing anything the SIMD kernels are checked against the scalar ones, WorleyGrid
+// against voronoi() at every feature-point count, and generation against itself on
+// every thread count; a mismatch fails the run. feature_points is what the grid
+// actually places, the nearest cube to the requested count.
+//
+//     noise_benchmark [--smoke] [--sizes 32,64,128,256] [--octaves 1,4,8,20]
+//                     [--feature-points 25,100,400] [--threads 1,8] [--min-time 0.25]
+//                     [--output results.json] [--baseline baseline.json] [--tolerance 0.2]
+//
+// --output writes the results in the format --baseline reads, each line tagged with the
+// kernel set and the host (CPU model and hardware threads). With --baseline every
+// measurement must reach (1 - tolerance) of its throughput in the baseline file, and
+// every baseline entry must have been measured again, or the run fails. A baseline
+// recorded with other kernels or on another host is skipped with a message, since its
+// numbers say nothing about this one. Exit status: 0 pass, 1 failed check, regression or
+// missing measurement, 2 bad arguments or unreadable baseline.
+struct BenchmarkOptions {
+    std::vector<int> sizes = { 32, 64, 128, 256 };
+    std::vector<int> octaves = { 1, 4, 8, 20 };
+    std::vector<int> featurePoints = { 25, 100, 400 };
+    std::vector<int> threads;
+    double minimumSeconds = 0.25;
+    double tolerance = 0.2;
+    std::string output, baseline;
+};
+
+struct BenchmarkResult {
+    std::string kernel;
+    int size = 0, octaves = 0, featurePoints = 0, threads = 1;
+    double voxels = 0, seconds = 0;
+
+    double VoxelsPerSecond() const { return seconds > 0 ? voxels / seconds : 0; }
+    std::string Key() const;
+    std::string Json() const;
+};
+
+const int benchmarkSlices = 8;
+const int voronoiMaximumSize = 64;
+
+volatile float benchmarkSink;
+
+// What the baseline's numbers are only comparable on: the CPU model and its hardware
+// threads, or the host name where the model cannot be read
+std::string benchmarkHost() {
+
+    std::string model;
+#if defined(__APPLE__)
+    char brand[256];
+    size_t length = sizeof(brand);
+    if (sysctlbyname("machdep.cpu.brand_string", brand, &length, nullptr, 0) == 0) model = brand;
+#elif defined(__linux__)
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (model.empty() && std::getline(cpuinfo, line)) {
+        size_t colon = line.find(':');
+        if (line.compare(0, 10, "model name") == 0 && colon != std::string::npos) model = line.substr(line.find_first_not_of(" \t", colon + 1));
+    }
+#endif
+    if (model.empty()) {
+        char name[256] = "unknown";
+        gethostname(name, sizeof(name) - 1);
+        model = name;
+    }
+
+    // Quotes would end the JSON string early; nothing else needs escaping here
+    for (char& c : model) if (c == '"' || c == '\\') c = ' ';
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    return model + ", " + std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+}
+
+std::string BenchmarkResult::Key() const {
+    char key[128];
+    snprintf(key, sizeof(key), "%s/%d/%d/%d/%d", kernel.c_str(), size, octaves, featurePoints, threads);
+    return key;
+}
+
+std::string BenchmarkResult::Json() const {
+    static const std::string host = benchmarkHost();
+
+    char line[640];
+    snprintf(line, sizeof(line),
+             "{\"kernel\": \"%s\", \"isa\": \"%s\", \"host\": \"%s\", \"size\": %d, \"octaves\": %d, \"feature_points\": %d, \"threads\": %d, "
+             "\"voxels\": %.0f, \"seconds\": %.6f, \"voxels_per_second\": %.1f}",
+             kernel.c_str(), noiseKernels().name, host.c_str(), size, octaves, featurePoints, threads, voxels, seconds, VoxelsPerSecond());
+    return line;
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+std::vector<int> parseList(const char* text) {
+    std::vector<int> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (std::atoi(item.c_str()) > 0) values.push_back(std::atoi(item.c_str()));
+    }
+    return values;
+}
+
+// Enough of JSON to read back the lines BenchmarkResult::Json writes
+bool jsonField(const std::string& line, const char* name, std::string& value) {
+    std::string pattern = std::string("\"") + name + "\": ";
+    size_t start = line.find(pattern);
+    if (start == std::string::npos) return false;
+    start += pattern.size();
+
+    if (line[start] == '"') {
+        size_t end = line.find('"', start + 1);
+        if (end == std::string::npos) return false;
+        value = line.substr(start + 1, end - start - 1);
+        return true;
+    }
+    size_t end = line.find_first_of(",}", start);
+    value = line.substr(start, end - start);
+    return true;
+}
+
+// Reads the entries of a baseline file recorded with kernel set `isa` on `host`. The
+// others are only counted in `skipped`, with where the last of them came from.
+bool loadBaseline(const std::string& path, const std::string& isa, const std::string& host,
+                  std::map<std::string, double>& baseline, int& skipped, std::string& recordedOn) {
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        BenchmarkResult result;
+        std::string kernel, size, octaves, featurePoints, threads, throughput, lineIsa, lineHost = "an unknown host";
+        if (!jsonField(line, "kernel", kernel) || !jsonField(line, "size", size) || !jsonField(line, "octaves", octaves) ||
+            !jsonField(line, "feature_points", featurePoints) || !jsonField(line, "threads", threads) ||
+            !jsonField(line, "voxels_per_second", throughput)) continue;
+
+        bool recordedHere = jsonField(line, "isa", lineIsa) && jsonField(line, "host", lineHost) && lineIsa == isa && lineHost == host;
+        if (!recordedHere) {
+            recordedOn = lineIsa + " on " + lineHost;
+            skipped++;
+            continue;
+        }
+
+        result.kernel = kernel;
+        result.size = std::atoi(size.c_str());
+        result.octaves = std::atoi(octaves.c_str());
+        result.featurePoints = std::atoi(featurePoints.c_str());
+        result.threads = std::atoi(threads.c_str());
+        baseline[result.Key()] = std::atof(throughput.c_str());
+    }
+    return true;
+}
+
+// Best of as many runs as fit in minimumSeconds, and at least one, so a run that lost
+// its core for a moment does not count against the kernel
+template <typename Function>
+double timeBest(double minimumSeconds, Function function) {
+    double best = 1e30, total = 0.0;
+    int runs = 0;
+    do {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, seconds);
+        total += seconds;
+        runs++;
+    } while (total < minimumSeconds && runs < 100);
+    return best;
+}
+
+// The voxel positions the per-voxel kernels sample: the first slices of a size³ volume
+// at the default noise frequency and seed offset, x fastest
+struct BenchmarkSamples {
+    int size, slices;
+    float offset, frequency;
+    std::vector<float> x, y, z;
+
+    static BenchmarkSamples Create(int size);
+    size_t Count() const { return x.size(); }
+};
+
+BenchmarkSamples BenchmarkSamples::Create(int size) {
+    NoiseParameters parameters = NoiseParameters();
+
+    BenchmarkSamples samples = BenchmarkSamples();
+    samples.size = size;
+    samples.slices = std::min(size, benchmarkSlices);
+    samples.offset = counterHash(parameters.seed, 0) % 10000000;
+    samples.frequency = parameters.frequency;
+
+    for (int z = 0; z < samples.slices; z++) {
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                samples.x.push_back((x + samples.offset) * samples.frequency);
+                samples.y.push_back((y + samples.offset) * samples.frequency);
+                samples.z.push_back((z + samples.offset) * samples.frequency);
+            }
+        }
+    }
+    return samples;
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+class NoiseBenchmark {
+public:
+    BenchmarkOptions options;
+    std::vector<BenchmarkResult> results;
+    int failures = 0;
+
+    void Check(const char* name, double error, double limit);
+    void Record(BenchmarkResult result);
+
+    void CheckKernels();
+    void RunNoise(int size);
+    void RunFbm(int size, int octaves);
+    void RunWorley(int size, int featurePoints);
+    void RunGenerate(int size);
+};
+
+void NoiseBenchmark::Check(const char* name, double error, double limit) {
+    bool passed = error <= limit;
+    fprintf(stderr, "check %-36s max error %.3g (limit %.3g) %s\n", name, error, limit, passed ? "ok" : "FAILED");
+    if (!passed) failures++;
+}
+
+void NoiseBenchmark::Record(BenchmarkResult result) {
+    std::string line = result.Json();
+    printf("%s\n", line.c_str());
+    fflush(stdout);
+    results.push_back(result);
+}
+
+// The SIMD kernels against the scalar double ones they replace, on coordinates well
+// away from the origin where float precision matters most
+void NoiseBenchmark::CheckKernels() {
+
+    const int count = 4099;
+    std::vector<float> x(count), y(count), z(count), batch(count), generic(count);
+    for (int i = 0; i < count; i++) {
+        x[i] = counterRandom(11, i) * 600.0f - 150.0f;
+        y[i] = counterRandom(12, i) * 600.0f - 150.0f;
+        z[i] = counterRandom(13, i) * 600.0f - 150.0f;
+    }
+
+    noiseBatch(x.data(), y.data(), z.data(), batch.data(), count);
+    noiseBatchGeneric(x.data(), y.data(), z.data(), generic.data(), count);
+
+    double batchError = 0.0, genericError = 0.0;
+    for (int i = 0; i < count; i++) {
+        double expected = noise(x[i], y[i], z[i]);
+        batchError = std::max(batchError, std::abs(batch[i] - expected));
+        genericError = std::max(genericError, std::abs(generic[i] - expected));
+    }
+    Check("noiseBatch vs noise", batchError, 1e-5);
+    Check("noiseBatchGeneric vs noise", genericError, 1e-5);
+
+    // 20 octaves at lacunarity 1.5 reach frequencies near 10^4, the worst case for float
+    NoiseParameters parameters = NoiseParameters();
+    BenchmarkSamples samples = BenchmarkSamples::Create(std::min(options.sizes.front(), 64));
+    int row = samples.size;
+    std::vector<float> layer(row), layerGeneric(row);
+
+    double rowError = 0.0, rowGenericError = 0.0;
+    for (size_t begin = 0; begin < samples.Count(); begin += row * 7) {
+        noiseLayerRow(&samples.x[begin], samples.y[begin], samples.z[begin], parameters.lacunarity, parameters.persistence, parameters.octaves, layer.data(), row);
+        noiseLayerRowGeneric(&samples.x[begin], samples.y[begin], samples.z[begin], parameters.lacunarity, parameters.persistence, parameters.octaves, layerGeneric.data(), row);
+
+        for (int i = 0; i < row; i++) {
+            double expected = noiseLayer(samples.x[begin + i], samples.y[begin], parameters.lacunarity, parameters.persistence, parameters.octaves, samples.z[begin]);
+            rowError = std::max(rowError, std::abs(layer[i] - expected));
+            rowGenericError = std::max(rowGenericError, std::abs(layerGeneric[i] - expected));
+        }
+    }
+    Check("noiseLayerRow vs noiseLayer", rowError, 1e-3);
+    Check("noiseLayerRowGeneric vs noiseLayer", rowGenericError, 1e-3);
+
+    // The cell grid has to find exactly the point the brute force finds, at every density
+    // that is benchmarked
+    for (int featurePoints : options.featurePoints) {
+        int size = 32;
+        WorleyGrid grid = WorleyGrid::Create(featurePoints, 1, size, 5, false);
+        std::vector<float> normalisedX(grid.pointsX.size()), normalisedY(grid.pointsY.size()), normalisedZ(grid.pointsZ.size());
+        for (size_t i = 0; i < grid.pointsX.size(); i++) {
+            normalisedX[i] = grid.pointsX[i] / size;
+            normalisedY[i] = grid.pointsY[i] / size;
+            normalisedZ[i] = grid.pointsZ[i] / size;
+        }
+
+        float*** map = voronoi(normalisedX.data(), normalisedY.data(), normalisedZ.data(), (int)normalisedX.size(), size);
+        double worleyError = 0.0;
+        for (int vx = 0; vx < size; vx++) {
+            for (int vy = 0; vy < size; vy++) {
+                for (int vz = 0; vz < size; vz++) {
+                    worleyError = std::max(worleyError, (double)std::abs(grid.Distance(vx, vy, vz) / grid.globalMaxDist - map[vx][vy][vz]));
+                }
+                free(map[vx][vy]);
+            }
+            free(map[vx]);
+        }
+        free(map);
+
+        char name[64];
+        snprintf(name, sizeof(name), "WorleyGrid vs voronoi, %d³ cells", grid.cells);
+        Check(name, worleyError, 1e-4);
+    }
+}
+
+void NoiseBenchmark::RunNoise(int size) {
+    BenchmarkSamples samples = BenchmarkSamples::Create(size);
+    std::vector<float> out(samples.Count());
+
+    BenchmarkResult result;
+    result.size = size;
+    result.voxels = (double)samples.Count();
+
+    result.kernel = "noise";
+    result.seconds = timeBest(options.minimumSeconds, [&]() {
+        for (size_t i = 0; i < samples.Count(); i++) out[i] = (float)noise(samples.x[i], samples.y[i], samples.z[i]);
+        benchmarkSink = out[samples.Count() / 2];
+    });
+    Record(result);
+
+    result.kernel = "noise_batch";
+    result.seconds = timeBest(options.minimumSeconds, [&]() {
+        noiseBatch(samples.x.data(), samples.y.data(), samples.z.data(), out.data(), (int)samples.Count());
+        benchmarkSink = out[samples.Count() / 2];
+    });
+    Record(result);
+}
+
+void NoiseBenchmark::RunFbm(int size, int octaves) {
+    NoiseParameters parameters = NoiseParameters();
+    BenchmarkSamples samples = BenchmarkSamples::Create(size);
+    std::vector<float> out(samples.Count());
+
+    BenchmarkResult result;
+    result.size = size;
+    result.octaves = octaves;
+    result.voxels = (double)samples.Count();
+
+    result.kernel = "fbm";
+    result.seconds = timeBest(options.minimumSeconds, [&]() {
+        for (size_t i = 0; i < samples.Count(); i++) {
+            out[i] = (float)noiseLayer(samples.x[i], samples.y[i], parameters.lacunarity, parameters.persistence, octaves, samples.z[i]);
+        }
+        benchmarkSink = out[samples.Count() / 2];
+    });
+    Record(result);
+
+    result.kernel = "fbm_row";
+    result.seconds = timeBest(options.minimumSeconds, [&]() {
+        for (size_t begin = 0; begin < samples.Count(); begin += size) {
+            noiseLayerRow(&samples.x[begin], samples.y[begin], samples.z[begin], parameters.lacunarity, parameters.persistence, octaves, &out[begin], size);
+        }
+        benchmarkSink = out[samples.Count() / 2];
+    });
+    Record(result);
+}
+
+void NoiseBenchmark::RunWorley(int size, int featurePoints) {
+    WorleyGrid grid = WorleyGrid::Create(featurePoints, 1, size, 5, false);
+    int slices = std::min(size, benchmarkSlices);
+
+    BenchmarkResult result;
+    result.size = size;
+    result.featurePoints = (int)grid.pointsX.size();
+
+    if (size <= voronoiMaximumSize) {
+        std::vector<float> normalisedX(grid.pointsX.size()), normalisedY(grid.pointsY.size()), normalisedZ(grid.pointsZ.size());
+        for (size_t i = 0; i < grid.pointsX.size(); i++) {
+            normalisedX[i] = grid.pointsX[i] / size;
+            normalisedY[i] = grid.pointsY[i] / size;
+            normalisedZ[i] = grid.pointsZ[i] / size;
+        }
+
+        // voronoi() only comes as a whole volume
+        result.kernel = "voronoi";
+        result.voxels = (double)size * size * size;
+        result.seconds = timeBest(options.minimumSeconds, [&]() {
+            float*** map = voronoi(normalisedX.data(), normalisedY.data(), normalisedZ.data(), (int)normalisedX.size(), size);
+            benchmarkSink = map[size / 2][size / 2][size / 2];
+            for (int x = 0; x < size; x++) {
+                for (int y = 0; y < size; y++) free(map[x][y]);
+                free(map[x]);
+            }
+            free(map);
+        });
+        Record(result);
+    }
+
+    std::vector<float> out((size_t)size * size * slices);
+    result.kernel = "worley_grid";
+    result.voxels = (double)out.size();
+    result.seconds = timeBest(options.minimumSeconds, [&]() {
+        size_t i = 0;
+        for (int z = 0; z < slices; z++) {
+            for (int y = 0; y < size; y++) {
+                for (int x = 0; x < size; x++) out[i++] = grid.Distance(x, y, z) / grid.globalMaxDist;
+            }
+        }
+        benchmarkSink = out[out.size() / 2];
+    });
+    Record(result);
+}
+
+// Every thread count has to produce the volume the first one did, bit for bit
+void NoiseBenchmark::RunGenerate(int size) {
+    NoiseParameters parameters = NoiseParameters();
+    parameters.size = size;
+
+    std::vector<float> first;
+
+    for (int threads : options.threads) {
+        ThreadPool pool(threads - 1);
+        std::vector<float> voxels;
+
+        BenchmarkResult result;
+        result.kernel = "generate";
+        result.size = size;
+        result.octaves = parameters.octaves;
+        result.featurePoints = parameters.featurePoints;
+        result.threads = threads;
+        result.voxels = (double)size * size * size;
+        result.seconds = timeBest(options.minimumSeconds, [&]() {
+            voxels = GenerateNoiseVolume(parameters, pool);
+        });
+        Record(result);
+
+        if (first.empty()) first = voxels;
+        else {
+            char name[64];
+            snprintf(name, sizeof(name), "generate %d³ on %d threads", size, threads);
+            Check(name, memcmp(first.data(), voxels.data(), first.size() * sizeof(float)) == 0 ? 0.0 : 1.0, 0.0);
+        }
+    }
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+int main(int argc, const char * argv[]) {
+
+    NoiseBenchmark benchmark;
+    BenchmarkOptions& options = benchmark.options;
+
+    int hardware = (int)std::max(1u, std::thread::hardware_concurrency());
+    options.threads = { 1 };
+    if (hardware > 1) options.threads.push_back(hardware);
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        // Just enough to prove every kernel builds, runs and agrees with the reference
+        if (argument == "--smoke") {
+            options.sizes = { 32 };
+            options.octaves = { 4 };
+            options.featurePoints = { 25, 2000 };
+            options.threads = { 1, 2 };
+            options.minimumSeconds = 0.0;
+        }
+        else if (argument == "--sizes" && hasValue) options.sizes = parseList(argv[++i]);
+        else if (argument == "--octaves" && hasValue) options.octaves = parseList(argv[++i]);
+        else if (argument == "--feature-points" && hasValue) options.featurePoints = parseList(argv[++i]);
+        else if (argument == "--threads" && hasValue) options.threads = parseList(argv[++i]);
+        else if (argument == "--min-time" && hasValue) options.minimumSeconds = std::max(std::atof(argv[++i]), 0.0);
+        else if (argument == "--tolerance" && hasValue) options.tolerance = std::clamp(std::atof(argv[++i]), 0.0, 1.0);
+        else if (argument == "--output" && hasValue) options.output = argv[++i];
+        else if (argument == "--baseline" && hasValue) options.baseline = argv[++i];
+        else {
+            fprintf(stderr, "unknown argument %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    if (options.sizes.empty() || options.octaves.empty() || options.featurePoints.empty() || options.threads.empty()) {
+        fprintf(stderr, "empty size, octave, feature point or thread list\n");
+        return 2;
+    }
+
+    std::string host = benchmarkHost();
+    std::map<std::string, double> baseline;
+    int skipped = 0;
+    std::string recordedOn;
+
+    if (!options.baseline.empty() && !loadBaseline(options.baseline, noiseKernels().name, host, baseline, skipped, recordedOn)) {
+        fprintf(stderr, "cannot read baseline %s\n", options.baseline.c_str());
+        return 2;
+    }
+    if (skipped > 0) {
+        fprintf(stderr, "skipping %d entries of %s recorded with %s; this is %s on %s\n",
+                skipped, options.baseline.c_str(), recordedOn.c_str(), noiseKernels().name, host.c_str());
+    }
+
+    fprintf(stderr, "noise kernels: %s, %s\n", noiseKernels().name, host.c_str());
+    benchmark.CheckKernels();
+
+    for (int size : options.sizes) {
+        benchmark.RunNoise(size);
+        for (int octaves : options.octaves) benchmark.RunFbm(size, octaves);
+        for (int featurePoints : options.featurePoints) benchmark.RunWorley(size, featurePoints);
+        benchmark.RunGenerate(size);
+    }
+
+    int regressions = 0;
+    std::set<std::string> measured;
+    for (const BenchmarkResult& result : benchmark.results) {
+        measured.insert(result.Key());
+        auto expected = baseline.find(result.Key());
+        if (expected == baseline.end()) continue;
+
+        double ratio = result.VoxelsPerSecond() / expected->second;
+        if (ratio < 1.0 - options.tolerance) {
+            fprintf(stderr, "regression %-32s %.3g voxels/s, baseline %.3g (%.0f%%)\n",
+                    result.Key().c_str(), result.VoxelsPerSecond(), expected->second, ratio * 100.0);
+            regressions++;
+        }
+    }
+
+    // A kernel that was renamed or dropped must not pass by no longer being compared
+    int missing = 0;
+    for (const auto& entry : baseline) {
+        if (measured.count(entry.first)) continue;
+        fprintf(stderr, "missing    %-32s in the baseline but not measured\n", entry.first.c_str());
+        missing++;
+    }
+
+    if (!options.output.empty()) {
+        std::ofstream file(options.output, std::ios::trunc);
+        for (const BenchmarkResult& result : benchmark.results) file << result.Json() << "\n";
+    }
+
+    if (!baseline.empty()) fprintf(stderr, "%d regressions, %d missing against %s\n", regressions, missing, options.baseline.c_str());
+    else if (!options.baseline.empty()) fprintf(stderr, "nothing in %s to compare against on this host\n", options.baseline.c_str());
+    return benchmark.failures > 0 || regressions > 0 || missing > 0 ? 1 : 0;
+}
@@ -0,0 +1,62 @@
+//
+//  macrocells_test.cpp
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "src/volume_core.h"
+
+// The macrocell pyramid has to bound every value the marcher can read: a filtered sample
+// at any lod in [0, maxLod] must lie within the (min, max) of the cell it falls in at
+// MacrocellGrid::Level(lod). The volume is empty but for scattered single-voxel spikes,
+// so nearly every cell is empty and a spike just over a cell's border is only caught
+// by its apron. It is tested at a power-of-two size and at one the cells do not divide
+// evenly. Exits 1 if any sample escapes its cell.
+int main() {
+
+    int failures = 0;
+
+    for (int size : { 64, 72 }) {
+        std::vector<float> voxels((size_t)size * size * size);
+        for (size_t i = 0; i < voxels.size(); i++) voxels[i] = counterRandom(21, i) < 0.0005f ? 1.0f : 0.0f;
+
+        VolumeMipChain mips = BuildVolumeMips(voxels.data(), size);
+        MacrocellGrid grid = MacrocellGrid::Build(voxels.data(), size);
+
+        ReferenceScene scene = ReferenceScene();
+        scene.voxels = voxels.data();
+        scene.size = size;
+        scene.mips = &mips;
+
+        int escaped = 0, empty = 0;
+        const int samples = 400000;
+        for (int i = 0; i < samples; i++) {
+            float u = counterRandom(22, i), v = counterRandom(23, i), w = counterRandom(24, i);
+            float lod = i % 4 == 0 ? (float)(i / 4 % macrocellLevels) : counterRandom(25, i) * (macrocellLevels - 1);
+
+            int level = MacrocellGrid::Level(lod);
+            const MacrocellLevel& cells = grid.levels[level];
+            float span = (float)(macrocellSize << level) / size;
+            int cx = std::clamp((int)(u / span), 0, cells.cells - 1),
+                cy = std::clamp((int)(v / span), 0, cells.cells - 1),
+                cz = std::clamp((int)(w / span), 0, cells.cells - 1);
+
+            const float* range = &cells.minMax[((size_t)cx + (size_t)cy * cells.cells + (size_t)cz * cells.cells * cells.cells) * 2];
+            float value = sampleVolumeLod(scene, u, v, w, lod);
+            if (value < range[0] - 1e-5f || value > range[1] + 1e-5f) escaped++;
+            if (range[1] <= 0.0f) empty++;
+        }
+
+        bool passed = escaped == 0;
+        fprintf(stderr, "%d³ volume: %d of %d samples outside their macrocell, %d in empty ones %s\n",
+                size, escaped, samples, empty, passed ? "ok" : "FAILED");
+        if (!passed) failures++;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+//
+//  noise_graph_test.cpp
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "src/volume_core.h"
+
+// fBm over arbitrary points (the path a domain warp takes) against fBm over rows, at
+// the largest seed offsets GenerateNoiseVolume uses. With no warp both see the same
+// coordinates and have to agree to within float accumulation. Exits 1 if they do not.
+int main() {
+
+    NoiseParameters parameters = NoiseParameters();
+    const int size = 32;
+    int failures = 0;
+
+    for (float offset : { 0.0f, 9900000.0f }) {
+        auto clouds = fbm(parameters.frequency, parameters.lacunarity, parameters.persistence, offset, parameters.octaves);
+        auto warped = domainWarp(fbm<4>(parameters.frequency * 4.0f, 2.0f, 0.5f, offset + 57.0f), 0.0f, clouds);
+
+        std::vector<float> rows = GenerateGraphVolume(clouds, size), points = GenerateGraphVolume(warped, size);
+
+        double error = 0.0;
+        for (size_t i = 0; i < rows.size(); i++) error = std::max(error, (double)std::abs(rows[i] - points[i]));
+
+        bool passed = error <= 1e-4;
+        fprintf(stderr, "fbm points vs rows, offset %-9.0f max error %.3g (limit 1e-4) %s\n", offset, error, passed ? "ok" : "FAILED");
+        if (!passed) failures++;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+//
+//  noise_simd_test.cpp
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "src/volume_core.h"
+
+// Every noise kernel set the CPU can run (AVX2, SSE2, NEON, generic) against the scalar
+// double noise() and noiseLayer() they replace. Coordinates sit near the origin and around
+// the largest seed offsets the generator uses, where float precision matters most. Exits 1
+// if any kernel is off by more than its limit, or if the SIMD path this build targets is
+// missing from the dispatch and only the portable loop was tested.
+int failures = 0;
+
+#if NOISE_SIMD_X86
+const char* expectedKernels = "sse2";
+#elif NOISE_SIMD_NEON
+const char* expectedKernels = "neon";
+#else
+const char* expectedKernels = nullptr;
+#endif
+
+void check(const char* kernels, const char* name, double error, double limit) {
+    bool passed = error <= limit;
+    fprintf(stderr, "%-8s %-28s max error %.3g (limit %.3g) %s\n", kernels, name, error, limit, passed ? "ok" : "FAILED");
+    if (!passed) failures++;
+}
+
+int main() {
+
+    const int count = 4099;
+    const double origins[2] = { -150.0, 9999999.0 * 0.0042 };
+
+    std::vector<NoiseKernels> available = availableNoiseKernels();
+    if (expectedKernels) {
+        bool found = false;
+        for (const NoiseKernels& kernels : available) found = found || strcmp(kernels.name, expectedKernels) == 0;
+        fprintf(stderr, "%-8s %-28s %s\n", expectedKernels, "in the dispatch", found ? "ok" : "FAILED");
+        if (!found) failures++;
+    }
+
+    for (const NoiseKernels& kernels : available) {
+        for (double origin : origins) {
+
+            std::vector<float> x(count), y(count), z(count), out(count);
+            for (int i = 0; i < count; i++) {
+                x[i] = (float)(origin + counterRandom(11, i) * 600.0);
+                y[i] = (float)(origin + counterRandom(12, i) * 600.0);
+                z[i] = (float)(origin + counterRandom(13, i) * 600.0);
+            }
+
+            kernels.batch(x.data(), y.data(), z.data(), out.data(), count);
+
+            double batchError = 0.0;
+            for (int i = 0; i < count; i++) batchError = std::max(batchError, std::abs(out[i] - noise(x[i], y[i], z[i])));
+            check(kernels.name, origin < 0.0 ? "noiseBatch" : "noiseBatch, far", batchError, 1e-5);
+
+            // The scale is applied in double, so the reference sees the same coordinates
+            const double scale = 2.0 * std::pow(1.5, 19.0);
+            kernels.batchScaled(x.data(), y.data(), z.data(), scale, out.data(), count);
+
+            double scaledError = 0.0;
+            for (int i = 0; i < count; i++) {
+                scaledError = std::max(scaledError, std::abs(out[i] - noise(x[i] * scale, y[i] * scale, z[i] * scale)));
+            }
+            check(kernels.name, origin < 0.0 ? "noiseBatchScaled" : "noiseBatchScaled, far", scaledError, 1e-5);
+
+            // Rows of an odd length, so every kernel also runs its scalar tail. 20 octaves
+            // at lacunarity 1.5 reach frequencies near 10^4.
+            const int row = 67;
+            double rowError = 0.0;
+            for (int begin = 0; begin + row <= count; begin += row * 5) {
+                kernels.layerRow(&x[begin], y[begin], z[begin], 1.5, 0.7, 20, out.data(), row);
+                for (int i = 0; i < row; i++) {
+                    rowError = std::max(rowError, std::abs(out[i] - noiseLayer(x[begin + i], y[begin], 1.5, 0.7, 20, z[begin])));
+                }
+            }
+            check(kernels.name, origin < 0.0 ? "noiseLayerRow" : "noiseLayerRow, far", rowError, 1e-4);
+        }
+    }
+
+    return failures > 0 ? 1 : 0;
+}
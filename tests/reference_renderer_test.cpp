@@ -0,0 +1,147 @@
+//
+//  reference_renderer_test.cpp
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "src/volume_core.h"
+
+// Renders a small fixed scene with the CPU reference renderer and compares it with a
+// checked-in golden image, so the renderer cannot drift from the cloud shader it ports
+// without someone regenerating the image on purpose. The scene is the default one of
+// RayMarchingQuad on a 32³ volume, lit and backed by the atmosphere tables. Filtering,
+// SIMD kernels and libm differ a little between hosts, so the image only has to match
+// on average and in all but a few channels.
+//
+//     reference_renderer_test golden.pfm [--update]
+//
+// --update rewrites the golden image instead. Exits 1 if the image differs, 2 if the
+// golden image cannot be read.
+const float referenceMeanError = 2e-3f;        // mean absolute difference over all channels
+const float referenceChannelError = 0.02f;     // a channel further off than this counts as wrong
+const double referenceWrongFraction = 0.005;   // share of channels allowed to be wrong
+
+// The float PFM that ReferenceImage::Write produces, little-endian, bottom row first
+bool readGolden(const std::string& path, int& width, int& height, std::vector<float>& pixels) {
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    char magic[3] = {};
+    float scale = 0.0f;
+    bool header = fscanf(file, "%2s %d %d %f", magic, &width, &height, &scale) == 4 && strcmp(magic, "PF") == 0 && scale < 0.0f;
+    fgetc(file);
+
+    pixels.resize((size_t)width * height * 3);
+    bool read = header && fread(pixels.data(), sizeof(float), pixels.size(), file) == pixels.size();
+    fclose(file);
+    return read;
+}
+
+ReferenceImage renderScene() {
+
+    NoiseParameters noise = NoiseParameters();
+    noise.size = 32;
+    std::vector<float> voxels = GenerateNoiseVolume(noise);
+    VolumeMipChain mips = BuildVolumeMips(voxels.data(), noise.size);
+    MacrocellGrid macrocells = MacrocellGrid::Build(voxels.data(), noise.size);
+
+    const float boxPosition[3] = { 0.0f, 0.0f, -10.0f }, halfSize[3] = { 4.5f, 4.5f, 4.5f };
+    const float light[3] = { 1.0f, 1.0f, 0.5f };
+    float lightLength = std::sqrt(light[0] * light[0] + light[1] * light[1] + light[2] * light[2]);
+
+    TransmittanceParameters lightParameters = TransmittanceParameters();
+    for (int axis = 0; axis < 3; axis++) {
+        lightParameters.lightDirection[axis] = light[axis] / lightLength;
+        lightParameters.boxSize[axis] = halfSize[axis] * 2.0f;
+    }
+    std::vector<float> transmittance = ComputeTransmittanceVolume(voxels.data(), noise.size, lightParameters);
+
+    AtmosphereParameters atmosphere = AtmosphereParameters();
+    // The default half-degree step, not VOLUMETRIC_SKY_THRESHOLD: the scene is fixed
+    atmosphere.sunZenith = std::cos(snappedSunZenith(lightParameters.lightDirection[1], 0.5f * 3.14159265f / 180.0f));
+    AtmosphereLut atmosphereTransmittance = ComputeTransmittanceLut(atmosphere);
+    AtmosphereLut skyView = ComputeSkyViewLut(atmosphere, atmosphereTransmittance);
+
+    ReferenceScene scene = ReferenceScene();
+    scene.voxels = voxels.data();
+    scene.size = noise.size;
+    scene.mips = &mips;
+    scene.macrocells = &macrocells;
+    scene.transmittance = transmittance.data();
+    scene.atmosphere = &atmosphere;
+    scene.atmosphereTransmittance = &atmosphereTransmittance;
+    scene.skyView = &skyView;
+    for (int axis = 0; axis < 3; axis++) {
+        scene.boxPosition[axis] = boxPosition[axis];
+        scene.halfSize[axis] = halfSize[axis];
+        scene.lightDirection[axis] = lightParameters.lightDirection[axis];
+    }
+
+    // From the default camera position, tilted up a little so the sky is in the frame
+    ReferenceView view = ReferenceView();
+    view.position[0] = 0.0f;
+    view.position[1] = 0.0f;
+    view.position[2] = 2.0f;
+    view.yaw = 3.14159265f * 1.5f;
+    view.pitch = 0.15f;
+    view.width = 96;
+    view.height = 54;
+
+    return RenderReference(scene, view);
+}
+
+int main(int argc, const char * argv[]) {
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: reference_renderer_test golden.pfm [--update]\n");
+        return 2;
+    }
+    std::string golden = argv[1];
+    bool update = argc > 2 && strcmp(argv[2], "--update") == 0;
+
+    ReferenceImage image = renderScene();
+
+    if (update) {
+        if (!image.Write(golden)) {
+            fprintf(stderr, "cannot write %s\n", golden.c_str());
+            return 2;
+        }
+        fprintf(stderr, "wrote %s\n", golden.c_str());
+        return 0;
+    }
+
+    int width, height;
+    std::vector<float> expected;
+    if (!readGolden(golden, width, height, expected)) {
+        fprintf(stderr, "cannot read %s\n", golden.c_str());
+        return 2;
+    }
+    if (width != image.width || height != image.height) {
+        fprintf(stderr, "golden image is %dx%d, rendered %dx%d FAILED\n", width, height, image.width, image.height);
+        return 1;
+    }
+
+    double sum = 0.0, largest = 0.0;
+    size_t wrong = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        double error = std::abs(image.pixels[i] - expected[i]);
+        sum += error;
+        largest = std::max(largest, error);
+        if (error > referenceChannelError) wrong++;
+    }
+
+    double mean = sum / expected.size(), wrongFraction = (double)wrong / expected.size();
+    bool passed = mean <= referenceMeanError && wrongFraction <= referenceWrongFraction;
+    fprintf(stderr, "%dx%d against %s: mean error %.3g (limit %.3g), largest %.3g, %.2f%% of channels off by more than %.3g (limit %.2f%%) %s\n",
+            width, height, golden.c_str(), mean, referenceMeanError, largest, wrongFraction * 100.0, referenceChannelError,
+            referenceWrongFraction * 100.0, passed ? "ok" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -10,6 +10,28 @@
 
 int main(int argc, const char * argv[]) {
     
-    initialize();
+    HeadlessOptions options;
+    bool headless = false;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        
+        if (argument == "--headless") headless = true;
+        else if (argument == "--frames" && hasValue) options.frames = std::max(std::atoi(argv[++i]), 1);
+        else if (argument == "--warmup" && hasValue) options.warmupFrames = std::max(std::atoi(argv[++i]), 0);
+        else if (argument == "--width" && hasValue) options.width = std::atoi(argv[++i]);
+        else if (argument == "--height" && hasValue) options.height = std::atoi(argv[++i]);
+        else if (argument == "--camera-path" && hasValue) options.cameraPath = argv[++i];
+        else if (argument == "--output" && hasValue) options.output = argv[++i];
+        else if (argument == "--reference" && hasValue) options.reference = argv[++i];
+        else if (argument == "--volume-error") options.volumeError = true;
+        else if (argument == "--volume-size" && hasValue) options.volumeSize = std::max(std::atoi(argv[++i]), 4);
+    }
+    
+    if (options.volumeError) reportVolumeError(options);
+    else if (!options.reference.empty()) renderReference(options);
+    else if (headless) initializeHeadless(options);
+    else initialize();
     return 0;
 }
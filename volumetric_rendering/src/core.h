@@ -10,6 +10,8 @@
 
 GLFWwindow* window;
 
+#include <chrono>
+#include <ctime>
 #include <fstream>
 #include <sstream>
 #include <vector>
@@ -22,19 +24,81 @@ GLFWwindow* window;
 
 #include <glm/gtc/matrix_transform.hpp>
 
-#include "rendering/noise.h"
+std::string shaderPath(const char* name);
+
+#include "utility/file_watcher.h"
+#include "utility/telemetry.h"
+
+#include "volume_core.h"
+
+#include "rendering/surface.h"
+#include "rendering/profiler.h"
 
 #include "object/vertex.h"
+#include "object/program_cache.h"
 #include "object/shader.h"
 #include "object/cube.h"
 
 #include "object/camera.h"
+#include "object/camera_uniforms.h"
+#include "object/mesh_batch.h"
 
 #include "rendering/deferred_renderer.h"
+#include "rendering/volume_upload.h"
+#include "rendering/wind_volume.h"
+#include "rendering/sparse_volume.h"
+#include "rendering/sky_atmosphere.h"
 #include "rendering/ray_marching.h"
+#include "rendering/cloud_reprojection.h"
+
+#include "headless.h"
+
+// Shader folders live under VOLUMETRIC_SHADER_DIR when it is set (headless build machines),
+// otherwise in the project checkout
+std::string shaderPath(const char* name) {
+    const char* directory = std::getenv("VOLUMETRIC_SHADER_DIR");
+    std::string root = directory ? directory : "/Users/dmitriwamback/Documents/Projects/volumetric_rendering/volumetric_rendering/src/shaders";
+    
+    // Outside that checkout, the shaders relative to the working directory
+    if (!directory && !std::filesystem::exists(root)) root = "src/shaders";
+    return root + "/" + name;
+}
+
+// The cube the scene has always had, plus VOLUMETRIC_OCCLUDERS cubes around it
+MeshBatch createMeshBatch() {
+    MeshBatch meshes = MeshBatch::Create();
+    meshes.Add(glm::vec3(0.0f));
+    meshes.Scatter(MeshBatch::OccludersFromEnvironment(), 500.0f, 7);
+    return meshes;
+}
+
+void renderFrame(Shader& shader, MeshBatch& meshes, RayMarchingQuad& quad, DeferredRenderer& renderer, CloudReprojection& clouds) {
+    
+    profiler.BeginFrame();
+    cameraUniforms.Update();
+    sky.Update(quad.lightDirection);
+    
+    {
+        ScopedGpuTimer timer("gbuffer");
+        renderer.Bind();
+        glClearColor(0.0, 0.0, 0.0, 0.0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        meshes.Render(shader);
+        renderer.Unbind();
+    }
+    
+    glClearColor(0.3, 0.3, 0.3, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    
+    {
+        ScopedGpuTimer timer("clouds");
+        clouds.Render(quad, renderer);
+    }
+}
 
 void initialize() {
     
+    telemetry.Start();
     glfwInit();
     
 #if defined(__APPLE__)
@@ -51,18 +115,46 @@ void initialize() {
     glewInit();
     glEnable(GL_DEPTH_TEST);
     
+    programCache = ProgramCache::Create();
     Camera::Initialize();
+    cameraUniforms = CameraUniforms::Create();
+    profiler = Profiler::Create();
     glfwSetCursorPosCallback(window, cursor_position_callback);
     
-    Shader shader = Shader::Create("/Users/dmitriwamback/Documents/Projects/volumetric_rendering/volumetric_rendering/src/shaders/main"),
-           rayMarchingShader = Shader::Create("/Users/dmitriwamback/Documents/Projects/volumetric_rendering/volumetric_rendering/src/shaders/atmospheric_clouds");
-    Cube cube = Cube::Create();
+    DeferredRenderer renderer = DeferredRenderer::Create(DeferredRenderer::LayoutFromEnvironment());
+    
+    MeshBatch meshes = createMeshBatch();
+    Shader shader = Shader::Create(shaderPath("main").c_str(), renderer.Defines() + meshes.Defines());
     RayMarchingQuad quad = RayMarchingQuad::Create();
+    sky = SkyAtmosphere::Create(quad.lightDirection);
+    CloudReprojection clouds = CloudReprojection::Create(CloudReprojection::ResolutionFromEnvironment(), CloudReprojection::BoundsFromEnvironment(), renderer.Defines() + quad.Defines() + sky.Defines());
+    
+    // Edited shaders are rebuilt and swapped in while the window is open
+    Shader::WatchSources();
     
-    DeferredRenderer renderer = DeferredRenderer::Create();
+    // P toggles the timings in the window title, VOLUMETRIC_PROFILE_CSV collects them in a file
+    const char* profileCsv = std::getenv("VOLUMETRIC_PROFILE_CSV");
+    bool overlayKeyDown = false;
+    int frame = 0;
+    auto frameStart = std::chrono::steady_clock::now();
     
     while (!glfwWindowShouldClose(window)) {
         
+        frame++;
+        auto now = std::chrono::steady_clock::now();
+        telemetry.Frame(frame, std::chrono::duration<double, std::milli>(now - frameStart).count());
+        frameStart = now;
+        
+        bool overlayKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+        if (overlayKey && !overlayKeyDown) {
+            profiler.overlay = !profiler.overlay;
+            if (!profiler.overlay) glfwSetWindowTitle(window, "Volumetric Rendering");
+        }
+        overlayKeyDown = overlayKey;
+        
+        if (profiler.overlay && frame % 30 == 0) glfwSetWindowTitle(window, ("Volumetric Rendering | " + profiler.Summary()).c_str());
+        if (profileCsv && frame % profilerWindow == 0) profiler.WriteCsv(profileCsv);
+        
         
         glm::vec4 movement = glm::vec4(0.0f);
         
@@ -71,29 +163,176 @@ void initialize() {
         movement.x = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS ?  0.05f : 0;
         movement.y = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS ? -0.05f : 0;
         
+        Shader::ReloadChanged();
+        
         if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) quad.GenerateNoiseTexture();
+        quad.Update();
                 
         camera.Update(movement);
-        std::cout << camera.position.x << " " << camera.position.y << " " << camera.position.z << '\n';
+        telemetry.Camera(&camera.position.x, camera.yaw, camera.pitch);
         
-        renderer.Bind();
-        glClearColor(0.0, 0.0, 0.0, 0.0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        shader.Use();
-        shader.SetVector3("cameraPosition", camera.position);
-        shader.SetMatrix4("projection", camera.projection);
-        shader.SetMatrix4("lookAt", camera.lookAt);
-        cube.Render(shader);
-        renderer.Unbind();
-        
-        glClearColor(0.3, 0.3, 0.3, 0.0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        quad.Render(rayMarchingShader, renderer);
+        renderFrame(shader, meshes, quad, renderer, clouds);
         
         glfwPollEvents();
         glfwSwapBuffers(window);
     }
     
     glfwDestroyWindow(window);
+    telemetry.Stop();
+}
+
+// Renders a scripted camera path offscreen and reports frame-time statistics as JSON
+void initializeHeadless(HeadlessOptions options) {
+    
+    telemetry.Start();
+    if (!createHeadlessContext()) {
+        std::cout << "failed to create a headless OpenGL context\n";
+        return;
+    }
+    glEnable(GL_DEPTH_TEST);
+    
+    programCache = ProgramCache::Create();
+    Surface::CreateOffscreen(options.width, options.height);
+    Camera::Initialize();
+    cameraUniforms = CameraUniforms::Create();
+    profiler = Profiler::Create();
+    
+    DeferredRenderer renderer = DeferredRenderer::Create(DeferredRenderer::LayoutFromEnvironment());
+    
+    MeshBatch meshes = createMeshBatch();
+    Shader shader = Shader::Create(shaderPath("main").c_str(), renderer.Defines() + meshes.Defines());
+    RayMarchingQuad quad = RayMarchingQuad::Create();
+    sky = SkyAtmosphere::Create(quad.lightDirection);
+    CloudReprojection clouds = CloudReprojection::Create(CloudReprojection::ResolutionFromEnvironment(), CloudReprojection::BoundsFromEnvironment(), renderer.Defines() + quad.Defines() + sky.Defines());
+    CameraPath path = CameraPath::Load(options.cameraPath);
+    
+    std::vector<double> frameTimes;
+    int totalFrames = options.warmupFrames + options.frames;
+    
+    for (int frame = 0; frame < totalFrames; frame++) {
+        
+        glm::vec3 position;
+        float yaw, pitch;
+        path.Sample(options.frames > 1 ? (float)std::max(frame - options.warmupFrames, 0) / (options.frames - 1) : 0.0f, position, yaw, pitch);
+        
+        auto start = std::chrono::steady_clock::now();
+        
+        camera.Place(position, yaw, pitch);
+        quad.Update();
+        renderFrame(shader, meshes, quad, renderer, clouds);
+        
+        // Without a swap chain nothing paces the GPU, so wait for the frame to finish
+        glFinish();
+        
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (frame >= options.warmupFrames) frameTimes.push_back(milliseconds);
+        telemetry.Frame(frame, milliseconds);
+        telemetry.Camera(&camera.position.x, camera.yaw, camera.pitch);
+    }
+    
+    writeFrameTimes(options, frameTimes);
+    telemetry.Stop();
+}
+
+// Renders the first camera-path keyframe with the CPU reference renderer and writes it
+// to options.reference (.pfm for floats, otherwise .ppm). Needs no OpenGL context.
+void renderReference(HeadlessOptions options) {
+    
+    RayMarchingQuad quad = RayMarchingQuad();
+    int size = quad.noiseParameters.size;
+    
+    VolumeCache cache = VolumeCache::Create();
+    SharedVoxels voxels = LoadNoiseVolume(quad.noiseParameters, cache);
+    VolumeMipChain mips = BuildVolumeMips(voxels.get(), size);
+    MacrocellGrid macrocells = MacrocellGrid::Build(voxels.get(), size);
+    SharedVoxels transmittance = LoadTransmittanceVolume(quad.noiseParameters, voxels.get(), quad.LightParameters(), cache);
+    
+    ReferenceScene scene = ReferenceScene();
+    scene.voxels = voxels.get();
+    scene.size = size;
+    scene.mips = &mips;
+    scene.macrocells = &macrocells;
+    scene.transmittance = transmittance.get();
+    
+    glm::vec3 lightDirection = glm::normalize(quad.lightDirection);
+    for (int axis = 0; axis < 3; axis++) {
+        scene.boxPosition[axis] = quad.boxPosition[axis];
+        scene.halfSize[axis] = quad.boxHalfSize[axis];
+        scene.lightDirection[axis] = lightDirection[axis];
+    }
+    
+    // The tables SkyAtmosphere would upload for this sun, so the image matches the default
+    // GPU sky; VOLUMETRIC_SKY=gradient compares against the gradient instead
+    AtmosphereParameters atmosphere = AtmosphereParameters();
+    AtmosphereLut atmosphereTransmittance, skyView;
+    if (atmosphereSkyEnabled()) {
+        atmosphere.sunZenith = std::cos(snappedSunZenith(lightDirection.y, atmosphereSkyThreshold()));
+        atmosphereTransmittance = LoadTransmittanceLut(atmosphere, cache);
+        skyView = LoadSkyViewLut(atmosphere, atmosphereTransmittance, cache);
+        
+        scene.atmosphere = &atmosphere;
+        scene.atmosphereTransmittance = &atmosphereTransmittance;
+        scene.skyView = &skyView;
+    }
+    
+    glm::vec3 position;
+    ReferenceView view = ReferenceView();
+    CameraPath::Load(options.cameraPath).Sample(0.0f, position, view.yaw, view.pitch);
+    view.position[0] = position.x;
+    view.position[1] = position.y;
+    view.position[2] = position.z;
+    view.width = options.width;
+    view.height = options.height;
+    
+    ReferenceImage image = RenderReference(scene, view);
+    if (!image.Write(options.reference)) {
+        std::cout << "failed to write " << options.reference << '\n';
+        return;
+    }
+    
+    char summary[256];
+    snprintf(summary, sizeof(summary), "{\"width\": %d, \"height\": %d, \"threads\": %d, \"seconds\": %.4f, \"rays_per_second\": %.0f}\n",
+             image.width, image.height, ThreadPool::Shared().ThreadCount(), image.seconds, image.RaysPerSecond());
+    std::cout << summary;
+}
+
+// Encodes the noise volume in every smaller format and prints, one JSON line each, how
+// much memory it takes and how far it is from the float source. Needs no OpenGL context.
+void reportVolumeError(HeadlessOptions options) {
+    
+    NoiseParameters parameters = RayMarchingQuad().noiseParameters;
+    if (options.volumeSize > 0) parameters.size = options.volumeSize;
+    
+    int size = parameters.size;
+    size_t count = (size_t)size * size * size;
+    std::vector<float> voxels = GenerateNoiseVolume(parameters);
+    VolumeRange range = MeasureVolumeRange(voxels.data(), count);
+    
+    std::string json;
+    auto report = [&](const char* name, size_t bytes, const std::vector<float>& decoded) {
+        VolumeError error = MeasureVolumeError(voxels.data(), decoded.data(), count, range);
+        
+        char line[320];
+        snprintf(line, sizeof(line), "{\"format\": \"%s\", \"size\": %d, \"bytes\": %zu, \"ratio\": %.2f, "
+                 "\"max_error\": %.6g, \"rms_error\": %.6g, \"psnr_db\": %.2f, \"density_max_error\": %.6g}\n",
+                 name, size, bytes, (double)(count * sizeof(float)) / bytes, error.maximum, error.rms, error.psnr, error.densityMaximum);
+        json += line;
+    };
+    
+    const VolumeFormat formats[] = { VolumeFormatUnorm16, VolumeFormatUnorm8 };
+    const char* names[] = { "r16", "r8" };
+    for (int i = 0; i < 2; i++) {
+        QuantizedVolume quantized = QuantizedVolume::Encode(voxels.data(), size, nullptr, formats[i]);
+        report(names[i], quantized.levels[0].size(), quantized.Decode());
+    }
+    
+    std::vector<uint8_t> blocks = CompressVolumeBC4(voxels.data(), size, range);
+    report("bc4", sizeof(range) + blocks.size(), DecompressVolumeBC4(blocks.data(), size, range));
+    
+    if (options.output.empty()) {
+        std::cout << json;
+        return;
+    }
+    std::ofstream file(options.output);
+    file << json;
 }
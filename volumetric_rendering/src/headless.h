@@ -0,0 +1,182 @@
+//
+//  headless.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef headless_h
+#define headless_h
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+struct HeadlessOptions {
+    int width = 1280, height = 720;
+    int frames = 300, warmupFrames = 10;
+    std::string cameraPath;
+    std::string output;
+    std::string reference;
+    bool volumeError = false;
+    int volumeSize = 0;
+};
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+// Scripted camera: one keyframe per line, "x y z yaw pitch", '#' starts a comment.
+// The keyframes are spread evenly over the frames and interpolated linearly.
+class CameraPath {
+public:
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> angles;
+
+    static CameraPath Load(const std::string& path);
+    void Sample(float t, glm::vec3& position, float& yaw, float& pitch);
+};
+
+CameraPath CameraPath::Load(const std::string& path) {
+    CameraPath cameraPath = CameraPath();
+
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+
+        std::stringstream stream(line);
+        glm::vec3 position;
+        glm::vec2 angle;
+        if (stream >> position.x >> position.y >> position.z >> angle.x >> angle.y) {
+            cameraPath.positions.push_back(position);
+            cameraPath.angles.push_back(angle);
+        }
+    }
+
+    // Without a path, hold the default camera still
+    if (cameraPath.positions.empty()) {
+        cameraPath.positions.push_back(glm::vec3(0.0f, 0.0f, 2.0f));
+        cameraPath.angles.push_back(glm::vec2(3.0f * 3.14159265358f/2.0f, 0.0f));
+    }
+    return cameraPath;
+}
+
+void CameraPath::Sample(float t, glm::vec3& position, float& yaw, float& pitch) {
+
+    float scaled = std::clamp(t, 0.0f, 1.0f) * (positions.size() - 1);
+    int index = std::min((int)scaled, (int)positions.size() - 1);
+    int next = std::min(index + 1, (int)positions.size() - 1);
+    float blend = scaled - index;
+
+    position = positions[index] + (positions[next] - positions[index]) * blend;
+    yaw = angles[index].x + (angles[next].x - angles[index].x) * blend;
+    pitch = angles[index].y + (angles[next].y - angles[index].y) * blend;
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+// Creates a GL 4.1 core context without a visible window. On Linux this is an EGL
+// surfaceless context, which Mesa's llvmpipe provides without any GPU or display;
+// elsewhere (or if EGL is unavailable) it is a hidden GLFW window.
+bool createHeadlessContext() {
+
+#if defined(__linux__)
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    EGLDisplay display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr)
+                                            : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr) && eglBindAPI(EGL_OPENGL_API)) {
+
+        EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLConfig config;
+        EGLint configCount = 0;
+        eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+
+        EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 1,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        EGLContext context = eglCreateContext(display, configCount > 0 ? config : (EGLConfig)0, EGL_NO_CONTEXT, contextAttributes);
+
+        if (context != EGL_NO_CONTEXT && eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            // glewInit() insists on a GLX display; only the core entry points are needed here
+            glewExperimental = GL_TRUE;
+            return glewContextInit() == GLEW_OK;
+        }
+    }
+#endif
+
+    glfwInit();
+#if defined(__APPLE__)
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#endif
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+    window = glfwCreateWindow(64, 64, "Volumetric Rendering", nullptr, nullptr);
+    if (!window) return false;
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    return glewInit() == GLEW_OK;
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+double percentile(const std::vector<double>& sorted, double fraction) {
+    double position = fraction * (sorted.size() - 1);
+    size_t index = (size_t)position;
+    size_t next = std::min(index + 1, sorted.size() - 1);
+    return sorted[index] + (sorted[next] - sorted[index]) * (position - index);
+}
+
+void writeFrameTimes(const HeadlessOptions& options, std::vector<double> frameTimes) {
+
+    std::sort(frameTimes.begin(), frameTimes.end());
+
+    double total = 0.0;
+    for (double frameTime : frameTimes) total += frameTime;
+
+    char summary[512];
+    snprintf(summary, sizeof(summary),
+             "{\"frames\": %d, \"width\": %d, \"height\": %d, \"renderer\": \"%s\", "
+             "\"min_ms\": %.4f, \"median_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, \"mean_ms\": %.4f",
+             (int)frameTimes.size(), options.width, options.height, (const char*)glGetString(GL_RENDERER),
+             frameTimes.front(), percentile(frameTimes, 0.5), percentile(frameTimes, 0.95), percentile(frameTimes, 0.99),
+             frameTimes.back(), total / frameTimes.size());
+
+    // Rolling per-pass means from the profiler, over its last profilerWindow samples
+    std::string json = std::string(summary) + ", \"passes\": {";
+    for (int i = 0; i < (int)profiler.passes.size(); i++) {
+        double mean, minimum, maximum;
+        profiler.Statistics(i, mean, minimum, maximum);
+
+        char pass[160];
+        snprintf(pass, sizeof(pass), "%s\"%s\": {\"kind\": \"%s\", \"mean_ms\": %.4f, \"min_ms\": %.4f, \"max_ms\": %.4f}",
+                 i == 0 ? "" : ", ", profiler.passes[i].name.c_str(), profiler.passes[i].gpu ? "gpu" : "cpu", mean, minimum, maximum);
+        json += pass;
+    }
+    json += "}}\n";
+
+    if (options.output.empty()) {
+        std::cout << json;
+        return;
+    }
+    std::ofstream file(options.output);
+    file << json;
+}
+
+#endif /* headless_h */
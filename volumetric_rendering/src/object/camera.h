@@ -21,6 +21,7 @@ public:
     
     static void Initialize();
     void Update(glm::vec4 movement);
+    void Place(glm::vec3 position, float yaw, float pitch);
 };
 
 Camera camera;
@@ -54,12 +55,22 @@ void Camera::Update(glm::vec4 movement) {
     lookAt = glm::lookAt(position, position + lookDirection, glm::vec3(0.0f, 1.0f, 0.0f));
     
     int width, height;
-    glfwGetWindowSize(window, &width, &height);
+    surface.GetWindowSize(&width, &height);
     float aspect = (float)width / (float)height;
     
     projection = glm::perspective(3.14159265358f/2.0f, aspect, 0.1f, 1000.0f);
 }
 
+// Puts the camera at a scripted pose instead of integrating keyboard and mouse input
+void Camera::Place(glm::vec3 position, float yaw, float pitch) {
+    
+    this->position = position;
+    this->yaw = yaw;
+    this->pitch = pitch;
+    
+    Update(glm::vec4(0.0f));
+}
+
 static void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
     
     if (glfwGetMouseButton(window, camera.mouseButton)) {
@@ -0,0 +1,69 @@
+//
+//  camera_uniforms.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef camera_uniforms_h
+#define camera_uniforms_h
+
+// The camera as every program sees it: one std140 uniform buffer, written once per
+// frame and bound at CameraBlock's binding point, instead of each pass uploading its
+// own matrices (and inverting them) every frame.
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 lookAt;
+    glm::mat4 inverseProjection;
+    glm::mat4 inverseLookAt;
+    glm::vec4 position;         // vec3 cameraPosition, padded to 16 bytes
+    glm::vec4 screenSize;       // vec2 screenSize at the next 16-byte boundary
+};
+static_assert(sizeof(CameraBlock) == 288, "CameraBlock must match the std140 layout in the shaders");
+
+const int cameraBlockBinding = 0;
+
+class CameraUniforms {
+public:
+    static CameraUniforms Create();
+    void Update();
+private:
+    uint32_t uniformBuffer;
+};
+
+CameraUniforms cameraUniforms;
+
+CameraUniforms CameraUniforms::Create() {
+    CameraUniforms uniforms = CameraUniforms();
+
+    glGenBuffers(1, &uniforms.uniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, uniforms.uniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, cameraBlockBinding, uniforms.uniformBuffer);
+
+    return uniforms;
+}
+
+void CameraUniforms::Update() {
+
+    int width, height;
+    surface.GetFramebufferSize(&width, &height);
+
+    CameraBlock block;
+    block.projection = camera.projection;
+    block.lookAt = camera.lookAt;
+    block.inverseProjection = glm::inverse(camera.projection);
+    block.inverseLookAt = glm::inverse(camera.lookAt);
+    block.position = glm::vec4(camera.position, 1.0f);
+    block.screenSize = glm::vec4(width, height, 0.0f, 0.0f);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, cameraBlockBinding, uniformBuffer);
+}
+
+#endif /* camera_uniforms_h */
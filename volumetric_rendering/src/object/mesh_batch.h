@@ -0,0 +1,284 @@
+//
+//  mesh_batch.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef mesh_batch_h
+#define mesh_batch_h
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// Many copies of the unit cube drawn with one glDrawElementsInstanced. Transforms are
+// kept as separate arrays (structure of arrays) and a model matrix and world bounds are
+// only rebuilt for instances marked dirty. Every frame the bounds are culled against the
+// camera frustum and the matrices of the visible instances are streamed into the
+// per-instance attribute buffer (locations 3 to 6, see INSTANCED in shaders/main).
+class MeshBatch {
+public:
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+
+    // Per instance: position, scale and rotation in degrees, applied as in Cube
+    std::vector<glm::vec3> positions, scales, rotations;
+    int visibleCount = 0;
+
+    static MeshBatch Create();
+    static int OccludersFromEnvironment();
+    std::string Defines();
+
+    int Add(glm::vec3 position, glm::vec3 scale = glm::vec3(1.0f), glm::vec3 rotation = glm::vec3(0.0f));
+    void SetTransform(int instance, glm::vec3 position, glm::vec3 scale, glm::vec3 rotation);
+    void Scatter(int count, float radius, uint32_t seed);
+    int Count();
+
+    void Render(Shader shader);
+
+private:
+    uint32_t vertexArrayObject, vertexBufferObject, indexBufferObject, instanceBufferObject;
+    size_t instanceCapacity = 0;
+
+    std::vector<glm::mat4> models;
+    std::vector<uint8_t> dirty;
+    std::vector<float> centreX, centreY, centreZ, extentX, extentY, extentZ;
+    bool anyDirty = false;
+
+    std::vector<glm::mat4> visible;
+    glm::mat4 culledViewProjection = glm::mat4(0.0f);
+
+    void UpdateDirty();
+    void Cull(const glm::mat4& viewProjection);
+};
+
+// The cube's six faces, four corners each, wound as in Cube
+MeshBatch MeshBatch::Create() {
+
+    MeshBatch batch = MeshBatch();
+
+    batch.vertices = {
+        // Front face
+        {{-0.5f, -0.5f,  0.5f}, { 0,  0,  1}, {0, 0}},
+        {{ 0.5f, -0.5f,  0.5f}, { 0,  0,  1}, {1, 0}},
+        {{ 0.5f,  0.5f,  0.5f}, { 0,  0,  1}, {1, 1}},
+        {{-0.5f,  0.5f,  0.5f}, { 0,  0,  1}, {0, 1}},
+
+        // Back face
+        {{ 0.5f, -0.5f, -0.5f}, { 0,  0, -1}, {0, 0}},
+        {{-0.5f, -0.5f, -0.5f}, { 0,  0, -1}, {1, 0}},
+        {{-0.5f,  0.5f, -0.5f}, { 0,  0, -1}, {1, 1}},
+        {{ 0.5f,  0.5f, -0.5f}, { 0,  0, -1}, {0, 1}},
+
+        // Right face
+        {{ 0.5f, -0.5f,  0.5f}, { 1,  0,  0}, {0, 0}},
+        {{ 0.5f, -0.5f, -0.5f}, { 1,  0,  0}, {1, 0}},
+        {{ 0.5f,  0.5f, -0.5f}, { 1,  0,  0}, {1, 1}},
+        {{ 0.5f,  0.5f,  0.5f}, { 1,  0,  0}, {0, 1}},
+
+        // Left face
+        {{-0.5f, -0.5f, -0.5f}, {-1,  0,  0}, {0, 0}},
+        {{-0.5f, -0.5f,  0.5f}, {-1,  0,  0}, {1, 0}},
+        {{-0.5f,  0.5f,  0.5f}, {-1,  0,  0}, {1, 1}},
+        {{-0.5f,  0.5f, -0.5f}, {-1,  0,  0}, {0, 1}},
+
+        // Top face
+        {{-0.5f,  0.5f,  0.5f}, { 0,  1,  0}, {0, 0}},
+        {{ 0.5f,  0.5f,  0.5f}, { 0,  1,  0}, {1, 0}},
+        {{ 0.5f,  0.5f, -0.5f}, { 0,  1,  0}, {1, 1}},
+        {{-0.5f,  0.5f, -0.5f}, { 0,  1,  0}, {0, 1}},
+
+        // Bottom face
+        {{-0.5f, -0.5f, -0.5f}, { 0, -1,  0}, {0, 0}},
+        {{ 0.5f, -0.5f, -0.5f}, { 0, -1,  0}, {1, 0}},
+        {{ 0.5f, -0.5f,  0.5f}, { 0, -1,  0}, {1, 1}},
+        {{-0.5f, -0.5f,  0.5f}, { 0, -1,  0}, {0, 1}},
+    };
+
+    for (uint32_t face = 0; face < 6; face++) {
+        uint32_t corner = face * 4;
+        batch.indices.insert(batch.indices.end(), { corner, corner + 1, corner + 2, corner + 2, corner + 3, corner });
+    }
+
+    glGenVertexArrays(1, &batch.vertexArrayObject);
+    glBindVertexArray(batch.vertexArrayObject);
+
+    glGenBuffers(1, &batch.vertexBufferObject);
+    glBindBuffer(GL_ARRAY_BUFFER, batch.vertexBufferObject);
+    glBufferData(GL_ARRAY_BUFFER, batch.vertices.size() * sizeof(Vertex), batch.vertices.data(), GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, vertex));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, uv));
+
+    glGenBuffers(1, &batch.indexBufferObject);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.indexBufferObject);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, batch.indices.size() * sizeof(uint32_t), batch.indices.data(), GL_STATIC_DRAW);
+
+    // One mat4 per instance, as four vec4 columns
+    glGenBuffers(1, &batch.instanceBufferObject);
+    glBindBuffer(GL_ARRAY_BUFFER, batch.instanceBufferObject);
+    for (int column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * column));
+        glVertexAttribDivisor(3 + column, 1);
+    }
+
+    glBindVertexArray(0);
+
+    return batch;
+}
+
+// VOLUMETRIC_OCCLUDERS=<count> scatters that many extra cubes around the scene; 0 when unset
+int MeshBatch::OccludersFromEnvironment() {
+    const char* occluders = std::getenv("VOLUMETRIC_OCCLUDERS");
+    return occluders ? std::max(std::atoi(occluders), 0) : 0;
+}
+
+// Programs drawing the batch read the model matrix from the instance attributes
+std::string MeshBatch::Defines() {
+    return "#define INSTANCED\n";
+}
+
+int MeshBatch::Add(glm::vec3 position, glm::vec3 scale, glm::vec3 rotation) {
+    positions.push_back(position);
+    scales.push_back(scale);
+    rotations.push_back(rotation);
+
+    models.push_back(glm::mat4(1.0f));
+    dirty.push_back(1);
+    for (std::vector<float>* bounds : { &centreX, &centreY, &centreZ, &extentX, &extentY, &extentZ }) bounds->push_back(0.0f);
+
+    anyDirty = true;
+    return (int)positions.size() - 1;
+}
+
+void MeshBatch::SetTransform(int instance, glm::vec3 position, glm::vec3 scale, glm::vec3 rotation) {
+    positions[instance] = position;
+    scales[instance] = scale;
+    rotations[instance] = rotation;
+    dirty[instance] = 1;
+    anyDirty = true;
+}
+
+// `count` cubes of random size and heading on the ground around the origin
+void MeshBatch::Scatter(int count, float radius, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> place(-radius, radius), size(0.5f, 4.0f), heading(0.0f, 360.0f);
+
+    for (int i = 0; i < count; i++) {
+        glm::vec3 scale = glm::vec3(size(random), size(random) * 2.0f, size(random));
+        Add(glm::vec3(place(random), scale.y * 0.5f - 6.0f, place(random)), scale, glm::vec3(0.0f, heading(random), 0.0f));
+    }
+}
+
+int MeshBatch::Count() {
+    return (int)positions.size();
+}
+
+// translate * rotateX * rotateY * rotateZ * scale written out, and the world AABB of the
+// rotated box from the absolute values of the same matrix
+void MeshBatch::UpdateDirty() {
+
+    if (!anyDirty) return;
+
+    for (int i = 0; i < Count(); i++) {
+        if (!dirty[i]) continue;
+
+        glm::vec3 angles = glm::radians(rotations[i]);
+        float cx = std::cos(angles.x), sx = std::sin(angles.x);
+        float cy = std::cos(angles.y), sy = std::sin(angles.y);
+        float cz = std::cos(angles.z), sz = std::sin(angles.z);
+
+        glm::mat3 rotation;
+        rotation[0] = glm::vec3(cy * cz, sx * sy * cz + cx * sz, -cx * sy * cz + sx * sz);
+        rotation[1] = glm::vec3(-cy * sz, -sx * sy * sz + cx * cz, cx * sy * sz + sx * cz);
+        rotation[2] = glm::vec3(sy, -sx * cy, cx * cy);
+
+        glm::mat4& model = models[i];
+        model[0] = glm::vec4(rotation[0] * scales[i].x, 0.0f);
+        model[1] = glm::vec4(rotation[1] * scales[i].y, 0.0f);
+        model[2] = glm::vec4(rotation[2] * scales[i].z, 0.0f);
+        model[3] = glm::vec4(positions[i], 1.0f);
+
+        glm::vec3 extent = 0.5f * (glm::abs(glm::vec3(model[0])) + glm::abs(glm::vec3(model[1])) + glm::abs(glm::vec3(model[2])));
+        centreX[i] = positions[i].x;
+        centreY[i] = positions[i].y;
+        centreZ[i] = positions[i].z;
+        extentX[i] = extent.x;
+        extentY[i] = extent.y;
+        extentZ[i] = extent.z;
+
+        dirty[i] = 0;
+    }
+
+    anyDirty = false;
+    culledViewProjection = glm::mat4(0.0f);
+}
+
+// Gribb-Hartmann planes of the view-projection matrix; an instance is dropped when its
+// box lies entirely behind one of them
+void MeshBatch::Cull(const glm::mat4& viewProjection) {
+
+    glm::vec4 rows[4];
+    for (int row = 0; row < 4; row++) rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+
+    glm::vec4 planes[6] = {
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2],
+    };
+
+    visible.clear();
+    int count = Count();
+
+    for (int i = 0; i < count; i++) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++) {
+            const glm::vec4& plane = planes[p];
+            float distance = plane.x * centreX[i] + plane.y * centreY[i] + plane.z * centreZ[i] + plane.w;
+            float reach = std::fabs(plane.x) * extentX[i] + std::fabs(plane.y) * extentY[i] + std::fabs(plane.z) * extentZ[i];
+            inside = distance + reach >= 0.0f;
+        }
+        if (inside) visible.push_back(models[i]);
+    }
+
+    visibleCount = (int)visible.size();
+    culledViewProjection = viewProjection;
+}
+
+void MeshBatch::Render(Shader shader) {
+
+    {
+        ScopedCpuTimer timer("culling");
+        UpdateDirty();
+
+        // A still camera over unchanged instances sees the same set, already in the buffer
+        glm::mat4 viewProjection = camera.projection * camera.lookAt;
+        if (viewProjection != culledViewProjection) {
+            Cull(viewProjection);
+
+            size_t bytes = visible.size() * sizeof(glm::mat4);
+            if (bytes > instanceCapacity) instanceCapacity = std::max(bytes, instanceCapacity * 2);
+
+            // Orphaning the old storage means the driver need not wait on the previous frame
+            glBindBuffer(GL_ARRAY_BUFFER, instanceBufferObject);
+            glBufferData(GL_ARRAY_BUFFER, instanceCapacity, nullptr, GL_STREAM_DRAW);
+            if (bytes > 0) glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, visible.data());
+        }
+    }
+
+    if (visibleCount == 0) return;
+
+    shader.Use();
+    glBindVertexArray(vertexArrayObject);
+    glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, nullptr, visibleCount);
+    glBindVertexArray(0);
+}
+
+#endif /* mesh_batch_h */
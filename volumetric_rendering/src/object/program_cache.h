@@ -0,0 +1,148 @@
+//
+//  program_cache.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef program_cache_h
+#define program_cache_h
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Linked programs kept on disk with glGetProgramBinary, so a start with unchanged shaders
+// skips compiling and linking. A file is named after a hash of both preprocessed stages
+// and the driver's vendor, renderer and version strings, so an edited shader or a driver
+// update is a miss. A binary the driver refuses at load time is a miss as well.
+struct ProgramCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t size;
+    uint64_t checksum;
+};
+static_assert(sizeof(ProgramCacheHeader) == 32, "program cache header layout changed");
+
+const uint32_t programCacheVersion = 1;
+
+class ProgramCache {
+public:
+    std::string directory;
+    bool enabled = false;
+
+    static ProgramCache Create();
+
+    uint64_t Key(const std::string& vertexSource, const std::string& fragmentSource);
+    bool Load(uint32_t program, uint64_t key);
+    bool Store(uint32_t program, uint64_t key);
+
+private:
+    std::string driver;
+    std::string PathForKey(uint64_t key);
+};
+
+ProgramCache programCache;
+
+// Lives next to the volume cache. VOLUMETRIC_PROGRAM_CACHE=0 turns it off; it is also off
+// when the driver offers no binary formats. Needs a current context.
+ProgramCache ProgramCache::Create() {
+    ProgramCache cache = ProgramCache();
+    cache.directory = VolumeCache::Create().directory;
+
+    int formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+    const char* setting = std::getenv("VOLUMETRIC_PROGRAM_CACHE");
+    cache.enabled = formats > 0 && !(setting && std::string(setting) == "0");
+
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+        const GLubyte* value = glGetString(name);
+        cache.driver += value ? (const char*)value : "";
+        cache.driver += '\n';
+    }
+
+    return cache;
+}
+
+uint64_t ProgramCache::Key(const std::string& vertexSource, const std::string& fragmentSource) {
+    uint64_t hash = hashBytes(&programCacheVersion, sizeof(programCacheVersion));
+    hash = hashBytes(driver.data(), driver.size(), hash);
+    hash = hashBytes(vertexSource.data(), vertexSource.size(), hash);
+    return hashBytes(fragmentSource.data(), fragmentSource.size(), hash);
+}
+
+std::string ProgramCache::PathForKey(uint64_t key) {
+    char name[64];
+    snprintf(name, sizeof(name), "program_%016llx.bin", (unsigned long long)key);
+    return directory + "/" + name;
+}
+
+bool ProgramCache::Load(uint32_t program, uint64_t key) {
+
+    if (!enabled) return false;
+
+    std::ifstream file(PathForKey(key), std::ios::binary);
+    if (!file) return false;
+
+    ProgramCacheHeader header;
+    if (!file.read((char*)&header, sizeof(header))) return false;
+    if (memcmp(header.magic, "VRNP", 4) != 0 || header.version != programCacheVersion || header.key != key) return false;
+
+    std::vector<char> binary(header.size);
+    if (!file.read(binary.data(), header.size) || checksumBytes(binary.data(), binary.size()) != header.checksum) return false;
+
+    glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+
+    int linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked != 0;
+}
+
+bool ProgramCache::Store(uint32_t program, uint64_t key) {
+
+    if (!enabled) return false;
+
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return false;
+
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    binary.resize(length);
+
+    ProgramCacheHeader header;
+    memcpy(header.magic, "VRNP", 4);
+    header.version = programCacheVersion;
+    header.key = key;
+    header.format = format;
+    header.size = (uint32_t)binary.size();
+    header.checksum = checksumBytes(binary.data(), binary.size());
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    // Same write-and-rename as the volume cache, so a crash never leaves a half-written hit
+    std::string path = PathForKey(key);
+    std::string temporaryPath = path + ".tmp";
+
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    file.write((const char*)&header, sizeof(header));
+    file.write(binary.data(), (std::streamsize)binary.size());
+    file.close();
+
+    if (!file || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+#endif /* program_cache_h */
@@ -8,44 +8,274 @@
 #ifndef shader_h
 #define shader_h
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Uniform blocks shared by every program, bound once at these binding points
+const char* uniformBlockBindings[] = {
+    "CameraBlock",
+};
+
+// Active uniforms of a linked program, sorted by name. Filled once after linking so
+// setting a uniform is a search through a few strings instead of a driver call.
+struct ShaderProgram {
+    uint32_t program;
+    std::vector<std::string> uniformNames;
+    std::vector<int> uniformLocations;
+    
+    // What it was built from, to rebuild it when one of its sources changes
+    std::string folder, defines;
+};
+
+// A rebuild submitted to the driver that has not been swapped in yet
+struct PendingProgram {
+    std::weak_ptr<ShaderProgram> target;
+    uint32_t program;
+    uint64_t key;
+};
+
+// Every program created so far, and the watcher that reports edits to their folders
+std::vector<std::weak_ptr<ShaderProgram>> shaderPrograms;
+std::vector<PendingProgram> pendingPrograms;
+FileWatcher shaderWatcher;
+
 class Shader {
 public:
-    static Shader Create(const char* shaderFolderPath);
+    static Shader Create(const char* shaderFolderPath, const std::string& defines = "");
     void Use();
     void SetMatrix4(const char* variableName, glm::mat4& mat);
     void SetVector3(const char* variableName, glm::vec3 vec);
     void SetVector2(const char *variableName, glm::vec2 vec);
     void SetInt(const char* variableName, int value);
+    void SetFloat(const char* variableName, float value);
+    int UniformLocation(const char* variableName);
+    
+    static void WatchSources();
+    static void ReloadChanged();
 private:
     static void CompileShader(int shader, const char* source);
     static void PrintShaderLog(int shader);
-    static int LoadShaderSource(const char* shaderPath, int shaderType);
-    uint32_t program;
+    static std::string LoadShaderSource(const char* shaderPath, const std::string& defines);
+    static uint32_t BuildProgram(const std::string& vertexSource, const std::string& fragmentSource);
+    static bool LinkSucceeded(uint32_t program);
+    static bool ParallelCompile();
+    static void Reflect(ShaderProgram& program);
+    std::shared_ptr<ShaderProgram> state;
 };
 
-Shader Shader::Create(const char* shaderFolderPath) {
+// `defines` is spliced in right after the #version line of both stages. The linked
+// program comes from programCache when both preprocessed stages are unchanged.
+Shader Shader::Create(const char* shaderFolderPath, const std::string& defines) {
     Shader shader = Shader();
     
-    std::string vsSrc = (std::string(shaderFolderPath) + "/vMain.glsl");
-    std::string fsSrc = (std::string(shaderFolderPath) + "/fMain.glsl");
-        
-    const char* vertexShaderPath = vsSrc.c_str();
-    const char* fragmentShaderPath = fsSrc.c_str();
-            
-    int vert = Shader::LoadShaderSource(vertexShaderPath, GL_VERTEX_SHADER);
-    int frag = Shader::LoadShaderSource(fragmentShaderPath, GL_FRAGMENT_SHADER);
+    shader.state = std::make_shared<ShaderProgram>();
+    shader.state->folder = shaderFolderPath;
+    shader.state->defines = defines;
+    
+    std::string vertexSource = Shader::LoadShaderSource((shader.state->folder + "/vMain.glsl").c_str(), defines);
+    std::string fragmentSource = Shader::LoadShaderSource((shader.state->folder + "/fMain.glsl").c_str(), defines);
+    uint64_t key = programCache.Key(vertexSource, fragmentSource);
+    
+    shader.state->program = glCreateProgram();
+    if (!programCache.Load(shader.state->program, key)) {
+        glDeleteProgram(shader.state->program);
+        shader.state->program = Shader::BuildProgram(vertexSource, fragmentSource);
+        if (Shader::LinkSucceeded(shader.state->program)) programCache.Store(shader.state->program, key);
+    }
     
-    shader.program = glCreateProgram();
-    glAttachShader(shader.program, vert);
-    glAttachShader(shader.program, frag);
-    glLinkProgram(shader.program);
+    Shader::Reflect(*shader.state);
+    
+    shaderPrograms.push_back(shader.state);
+    shaderWatcher.Watch(shader.state->folder);
+    
+    return shader;
+}
+
+// Compiles both stages and links them. With KHR_parallel_shader_compile this returns
+// before the driver is done; LinkSucceeded waits for it.
+uint32_t Shader::BuildProgram(const std::string& vertexSource, const std::string& fragmentSource) {
+    
+    int vert = glCreateShader(GL_VERTEX_SHADER);
+    int frag = glCreateShader(GL_FRAGMENT_SHADER);
+    Shader::CompileShader(vert, vertexSource.c_str());
+    Shader::CompileShader(frag, fragmentSource.c_str());
+    
+    uint32_t program = glCreateProgram();
+    glAttachShader(program, vert);
+    glAttachShader(program, frag);
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+    
+    // Only flagged while attached, so their logs can still be read
     glDeleteShader(vert);
     glDeleteShader(frag);
     
-    return shader;
+    return program;
+}
+
+bool Shader::LinkSucceeded(uint32_t program) {
+    
+    uint32_t shaders[2];
+    int shaderCount = 0;
+    glGetAttachedShaders(program, 2, &shaderCount, shaders);
+    for (int i = 0; i < shaderCount; i++) Shader::PrintShaderLog(shaders[i]);
+    
+    int linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char infoLog[1024];
+        glGetProgramInfoLog(program, 1024, NULL, infoLog);
+        telemetry.Log(infoLog);
+    }
+    return linked != 0;
+}
+
+bool Shader::ParallelCompile() {
+    
+    static int supported = -1;
+    if (supported >= 0) return supported;
+    
+    supported = 0;
+    int extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (int i = 0; i < extensionCount; i++) {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (name && (strcmp(name, "GL_KHR_parallel_shader_compile") == 0 || strcmp(name, "GL_ARB_parallel_shader_compile") == 0)) supported = 1;
+    }
+    return supported;
 }
 
-int Shader::LoadShaderSource(const char* shaderPath, int shaderType) {
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+// Starts watching the folder of every program for edits
+void Shader::WatchSources() {
+    shaderWatcher.Start();
+}
+
+// Once a frame, on the GL thread. Programs whose folder had a .glsl file change are
+// rebuilt; where the driver compiles in parallel the new program is picked up on a later
+// frame once it completes, otherwise it is waited on here. Only a program that linked
+// replaces the old one, in the state every copy of its Shader shares. A failed build is
+// logged and dropped, and the old program stays.
+void Shader::ReloadChanged() {
+    
+    std::vector<std::string> folders;
+    for (const std::string& path : shaderWatcher.Changed()) {
+        if (std::filesystem::path(path).extension() != ".glsl") continue;
+        
+        std::string folder = std::filesystem::path(path).parent_path().string();
+        if (std::find(folders.begin(), folders.end(), folder) == folders.end()) folders.push_back(folder);
+    }
+    
+    for (const std::string& folder : folders) {
+        for (const std::weak_ptr<ShaderProgram>& program : shaderPrograms) {
+            std::shared_ptr<ShaderProgram> state = program.lock();
+            if (!state || state->folder != folder) continue;
+            
+            std::string vertexSource = Shader::LoadShaderSource((folder + "/vMain.glsl").c_str(), state->defines);
+            std::string fragmentSource = Shader::LoadShaderSource((folder + "/fMain.glsl").c_str(), state->defines);
+            pendingPrograms.push_back({ state, Shader::BuildProgram(vertexSource, fragmentSource), programCache.Key(vertexSource, fragmentSource) });
+        }
+    }
+    
+    bool parallel = Shader::ParallelCompile();
+    for (auto pending = pendingPrograms.begin(); pending != pendingPrograms.end();) {
+        
+        int complete = 1;
+        if (parallel) glGetProgramiv(pending->program, GL_COMPLETION_STATUS_KHR, &complete);
+        if (!complete) {
+            pending++;
+            continue;
+        }
+        
+        std::shared_ptr<ShaderProgram> state = pending->target.lock();
+        if (state && Shader::LinkSucceeded(pending->program)) {
+            programCache.Store(pending->program, pending->key);
+            glDeleteProgram(state->program);
+            state->program = pending->program;
+            Shader::Reflect(*state);
+        }
+        else {
+            glDeleteProgram(pending->program);
+        }
+        pending = pendingPrograms.erase(pending);
+    }
+    
+    shaderPrograms.erase(std::remove_if(shaderPrograms.begin(), shaderPrograms.end(), [](const std::weak_ptr<ShaderProgram>& program) {
+        return program.expired();
+    }), shaderPrograms.end());
+}
+
+void Shader::Reflect(ShaderProgram& program) {
+    
+    int uniformCount = 0;
+    glGetProgramiv(program.program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    
+    std::vector<std::pair<std::string, int>> uniforms;
+    char name[256];
+    
+    for (int i = 0; i < uniformCount; i++) {
+        int length, arraySize;
+        GLenum type;
+        glGetActiveUniform(program.program, i, sizeof(name), &length, &arraySize, &type, name);
+        
+        // Members of uniform blocks have no location
+        std::string uniformName(name, length);
+        if (glGetUniformLocation(program.program, uniformName.c_str()) < 0) continue;
+        
+        // Arrays are reported as "name[0]"; register the bare name and every element
+        size_t bracket = uniformName.find('[');
+        if (bracket != std::string::npos) {
+            std::string base = uniformName.substr(0, bracket);
+            uniforms.push_back({ base, glGetUniformLocation(program.program, base.c_str()) });
+            for (int element = 0; element < arraySize; element++) {
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                uniforms.push_back({ elementName, glGetUniformLocation(program.program, elementName.c_str()) });
+            }
+            continue;
+        }
+        uniforms.push_back({ uniformName, glGetUniformLocation(program.program, uniformName.c_str()) });
+    }
+    
+    std::sort(uniforms.begin(), uniforms.end());
+    program.uniformNames.clear();
+    program.uniformLocations.clear();
+    for (auto& uniform : uniforms) {
+        program.uniformNames.push_back(uniform.first);
+        program.uniformLocations.push_back(uniform.second);
+    }
+    
+    int blockCount = 0;
+    glGetProgramiv(program.program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    
+    for (int i = 0; i < blockCount; i++) {
+        glGetActiveUniformBlockName(program.program, i, sizeof(name), nullptr, name);
+        for (int binding = 0; binding < (int)(sizeof(uniformBlockBindings) / sizeof(uniformBlockBindings[0])); binding++) {
+            if (strcmp(name, uniformBlockBindings[binding]) == 0) glUniformBlockBinding(program.program, i, binding);
+        }
+    }
+}
+
+int Shader::UniformLocation(const char* variableName) {
+    
+    std::vector<std::string>& names = state->uniformNames;
+    auto found = std::lower_bound(names.begin(), names.end(), variableName, [](const std::string& name, const char* value) {
+        return strcmp(name.c_str(), value) < 0;
+    });
+    
+    if (found == names.end() || *found != variableName) return -1;
+    return state->uniformLocations[found - names.begin()];
+}
+
+std::string Shader::LoadShaderSource(const char* shaderPath, const std::string& defines) {
     
     std::ifstream shader;
     shader.open(shaderPath);
@@ -55,13 +285,14 @@ int Shader::LoadShaderSource(const char* shaderPath, int shaderType) {
     shader.close();
     
     std::string shaderSourceStr = stream.str();
-    const char* shaderSourceConstChar = shaderSourceStr.c_str();
     
-    int shaderProgram = glCreateShader(shaderType);
-    Shader::CompileShader(shaderProgram, shaderSourceConstChar);
-    Shader::PrintShaderLog(shaderProgram);
+    size_t version = shaderSourceStr.find("#version");
+    if (!defines.empty() && version != std::string::npos) {
+        size_t lineEnd = shaderSourceStr.find('\n', version);
+        shaderSourceStr.insert(lineEnd == std::string::npos ? shaderSourceStr.size() : lineEnd + 1, defines);
+    }
     
-    return shaderProgram;
+    return shaderSourceStr;
 }
 
 void Shader::CompileShader(int shader, const char* source) {
@@ -78,34 +309,39 @@ void Shader::PrintShaderLog(int shader) {
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if (!success) {
         glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-        std::cout << infoLog << '\n';
+        telemetry.Log(infoLog);
     }
     else {
-        std::cout << "successfully compiled shader\n";
+        telemetry.Log("successfully compiled shader");
     }
 }
 
 void Shader::Use() {
-    glUseProgram(program);
+    glUseProgram(state->program);
 }
 
 void Shader::SetMatrix4(const char* variableName, glm::mat4& mat) {
-    int location = glGetUniformLocation(program, variableName);
+    int location = UniformLocation(variableName);
     glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
 }
 
 void Shader::SetVector3(const char* variableName, glm::vec3 vec) {
-    int location = glGetUniformLocation(program, variableName);
+    int location = UniformLocation(variableName);
     glUniform3fv(location, 1, &vec[0]);
 }
 void Shader::SetVector2(const char *variableName, glm::vec2 vec) {
-    int location = glGetUniformLocation(program, variableName);
+    int location = UniformLocation(variableName);
     glUniform2fv(location, 1, &vec[0]);
 }
 
 void Shader::SetInt(const char *variableName, int value) {
-    int location = glGetUniformLocation(program, variableName);
+    int location = UniformLocation(variableName);
     glUniform1i(location, value);
 }
 
+void Shader::SetFloat(const char *variableName, float value) {
+    int location = UniformLocation(variableName);
+    glUniform1f(location, value);
+}
+
 #endif /* shader_h */
@@ -0,0 +1,415 @@
+//
+//  atmosphere.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef atmosphere_h
+#define atmosphere_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Rayleigh, Mie and ozone sky after Hillaire, "A Scalable and Production Ready Sky and
+// Atmosphere Rendering Technique" (2020), reduced to the two tables the shaders read:
+//
+//   transmittance   RGB transmittance from a point to the top of the atmosphere, by
+//                   altitude and view zenith. Independent of the sun.
+//   sky view        single-scattered sky luminance seen from the observer, by view
+//                   zenith and azimuth from the sun, for a sun illuminance of 1. With
+//                   azimuth measured from the sun only the sun's elevation matters.
+//
+// Lengths are in kilometres. +y is up, as everywhere else in the renderer. There is no
+// multiple-scattering table; the sky is single scattering plus a Lambertian ground.
+struct AtmosphereParameters {
+    float sunZenith = 0.0f;                 // cosine of the sun's zenith angle
+    float bottomRadius = 6360.0f;
+    float topRadius = 6460.0f;
+    float observerAltitude = 0.2f;
+
+    float rayleighScattering[3] = { 5.802e-3f, 13.558e-3f, 33.1e-3f };
+    float rayleighHeight = 8.0f;
+
+    float mieScattering = 3.996e-3f;
+    float mieExtinction = 4.44e-3f;
+    float mieHeight = 1.2f;
+    float mieAnisotropy = 0.8f;
+
+    float ozoneAbsorption[3] = { 0.650e-3f, 1.881e-3f, 0.085e-3f };
+    float ozoneCentre = 25.0f;
+    float ozoneWidth = 15.0f;
+
+    float groundAlbedo = 0.3f;
+
+    float ObserverRadius() const { return bottomRadius + observerAltitude; }
+};
+
+// Bump whenever the tables change for the same parameters, so cached ones are recomputed
+const uint32_t atmosphereGeneratorVersion = 1;
+
+const int transmittanceLutWidth = 256, transmittanceLutHeight = 64;
+const int skyViewLutWidth = 192, skyViewLutHeight = 108;
+
+// Sky luminance to display colour, 1 - exp(-L * exposure)
+const float atmosphereSkyExposure = 30.0f;
+
+// VOLUMETRIC_SKY=gradient keeps the old zenith/horizon gradient, on the GPU and in the
+// reference renderer alike
+bool atmosphereSkyEnabled() {
+    const char* setting = std::getenv("VOLUMETRIC_SKY");
+    return !(setting && strcmp(setting, "gradient") == 0);
+}
+
+// Radians of sun elevation before the sky view is recomputed, VOLUMETRIC_SKY_THRESHOLD
+// in degrees
+float atmosphereSkyThreshold() {
+    const char* threshold = std::getenv("VOLUMETRIC_SKY_THRESHOLD");
+    return (threshold ? std::max((float)atof(threshold), 0.0f) : 0.5f) * 3.14159265f / 180.0f;
+}
+
+// Zenith angle of a sun whose direction has this y, snapped to multiples of `threshold`
+// so earlier suns come from the cache
+float snappedSunZenith(float sunY, float threshold) {
+    float zenith = std::acos(std::clamp(sunY, -1.0f, 1.0f));
+    return threshold > 0.0f ? std::round(zenith / threshold) * threshold : zenith;
+}
+
+// Interleaved RGB floats, row by row, as GL_RGB32F takes them
+struct AtmosphereLut {
+    int width = 0, height = 0;
+    std::vector<float> texels;
+
+    float* At(int x, int y) { return &texels[((size_t)y * width + x) * 3]; }
+    const float* At(int x, int y) const { return &texels[((size_t)y * width + x) * 3]; }
+    void Sample(float u, float v, float rgb[3]) const;
+};
+
+// GL_LINEAR with CLAMP_TO_EDGE, like sampleVolume for one 2D level
+void AtmosphereLut::Sample(float u, float v, float rgb[3]) const {
+
+    float x = u * width - 0.5f, y = v * height - 0.5f;
+    int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+    float fx = x - x0, fy = y - y0;
+
+    int x1 = std::clamp(x0 + 1, 0, width - 1), y1 = std::clamp(y0 + 1, 0, height - 1);
+    x0 = std::clamp(x0, 0, width - 1);
+    y0 = std::clamp(y0, 0, height - 1);
+
+    for (int c = 0; c < 3; c++) {
+        float top = At(x0, y0)[c] + (At(x1, y0)[c] - At(x0, y0)[c]) * fx,
+              bottom = At(x0, y1)[c] + (At(x1, y1)[c] - At(x0, y1)[c]) * fx;
+        rgb[c] = top + (bottom - top) * fy;
+    }
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+// Distance along a ray from radius r at zenith cosine mu to the sphere of `radius`,
+// the far intersection when starting inside; negative if there is none
+float raySphereDistance(float r, float mu, float radius) {
+    float discriminant = r * r * (mu * mu - 1.0f) + radius * radius;
+    if (discriminant < 0.0f) return -1.0f;
+    float root = std::sqrt(discriminant);
+    float nearDistance = -r * mu - root;
+    return nearDistance >= 0.0f ? nearDistance : -r * mu + root;
+}
+
+// Whether a ray from radius r at zenith cosine mu hits the ground
+bool rayHitsGround(float r, float mu, float bottomRadius) {
+    return mu < 0.0f && r * r * (mu * mu - 1.0f) + bottomRadius * bottomRadius >= 0.0f;
+}
+
+// Scattering and extinction per kilometre at an altitude
+void atmosphereCoefficients(const AtmosphereParameters& atmosphere, float altitude, float rayleigh[3], float& mie, float extinction[3]) {
+
+    float rayleighDensity = std::exp(-altitude / atmosphere.rayleighHeight),
+          mieDensity = std::exp(-altitude / atmosphere.mieHeight),
+          ozoneDensity = std::max(0.0f, 1.0f - std::abs(altitude - atmosphere.ozoneCentre) / atmosphere.ozoneWidth);
+
+    mie = atmosphere.mieScattering * mieDensity;
+    for (int c = 0; c < 3; c++) {
+        rayleigh[c] = atmosphere.rayleighScattering[c] * rayleighDensity;
+        extinction[c] = rayleigh[c] + atmosphere.mieExtinction * mieDensity + atmosphere.ozoneAbsorption[c] * ozoneDensity;
+    }
+}
+
+// Texel coordinates of the transmittance table (Bruneton's mapping, which spends the
+// resolution near the horizon) and back
+void transmittanceLutUV(const AtmosphereParameters& atmosphere, float r, float mu, float& u, float& v) {
+    float horizon = std::sqrt(atmosphere.topRadius * atmosphere.topRadius - atmosphere.bottomRadius * atmosphere.bottomRadius);
+    float rho = std::sqrt(std::max(r * r - atmosphere.bottomRadius * atmosphere.bottomRadius, 0.0f));
+
+    float distance = std::max(raySphereDistance(r, mu, atmosphere.topRadius), 0.0f);
+    float minimum = atmosphere.topRadius - r, maximum = rho + horizon;
+
+    u = (distance - minimum) / (maximum - minimum);
+    v = rho / horizon;
+}
+
+void transmittanceLutParameters(const AtmosphereParameters& atmosphere, float u, float v, float& r, float& mu) {
+    float horizon = std::sqrt(atmosphere.topRadius * atmosphere.topRadius - atmosphere.bottomRadius * atmosphere.bottomRadius);
+    float rho = horizon * v;
+    r = std::sqrt(rho * rho + atmosphere.bottomRadius * atmosphere.bottomRadius);
+
+    float minimum = atmosphere.topRadius - r, maximum = rho + horizon;
+    float distance = minimum + u * (maximum - minimum);
+    mu = distance == 0.0f ? 1.0f : (horizon * horizon - rho * rho - distance * distance) / (2.0f * r * distance);
+    mu = std::clamp(mu, -1.0f, 1.0f);
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+AtmosphereLut ComputeTransmittanceLut(const AtmosphereParameters& atmosphere, ThreadPool& pool = ThreadPool::Shared()) {
+
+    const int steps = 40;
+
+    AtmosphereLut lut = AtmosphereLut();
+    lut.width = transmittanceLutWidth;
+    lut.height = transmittanceLutHeight;
+    lut.texels.resize((size_t)lut.width * lut.height * 3);
+
+    pool.ParallelFor(0, lut.height, 1, [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+            for (int x = 0; x < lut.width; x++) {
+
+                float r, mu;
+                transmittanceLutParameters(atmosphere, (x + 0.5f) / lut.width, (y + 0.5f) / lut.height, r, mu);
+
+                float length = std::max(raySphereDistance(r, mu, atmosphere.topRadius), 0.0f);
+                float stepLength = length / steps;
+                float opticalDepth[3] = { 0.0f, 0.0f, 0.0f };
+
+                for (int i = 0; i < steps; i++) {
+                    float t = (i + 0.5f) * stepLength;
+                    float altitude = std::sqrt(r * r + t * t + 2.0f * r * mu * t) - atmosphere.bottomRadius;
+
+                    float rayleigh[3], mie, extinction[3];
+                    atmosphereCoefficients(atmosphere, altitude, rayleigh, mie, extinction);
+                    for (int c = 0; c < 3; c++) opticalDepth[c] += extinction[c] * stepLength;
+                }
+
+                float* texel = lut.At(x, y);
+                for (int c = 0; c < 3; c++) texel[c] = std::exp(-opticalDepth[c]);
+            }
+        }
+    });
+
+    return lut;
+}
+
+// Transmittance toward the sun from radius r where the sun's zenith cosine is mu, zero
+// behind the planet
+void sunTransmittance(const AtmosphereParameters& atmosphere, const AtmosphereLut& transmittance, float r, float mu, float rgb[3]) {
+    if (rayHitsGround(r, mu, atmosphere.bottomRadius)) {
+        rgb[0] = rgb[1] = rgb[2] = 0.0f;
+        return;
+    }
+    float u, v;
+    transmittanceLutUV(atmosphere, r, mu, u, v);
+    transmittance.Sample(u, v, rgb);
+}
+
+// View zenith angle of a sky-view texel row. Rows below the middle look above the
+// horizon, rows above it at the ground, both squeezed toward the horizon where the sky
+// changes fastest. The shader inverts this in skyViewUV().
+float skyViewZenithAngle(const AtmosphereParameters& atmosphere, float v) {
+    const float pi = 3.14159265f;
+    float r = atmosphere.ObserverRadius();
+    float beta = std::acos(std::sqrt(r * r - atmosphere.bottomRadius * atmosphere.bottomRadius) / r);
+    float horizonZenith = pi - beta;
+
+    if (v < 0.5f) {
+        float coordinate = 1.0f - 2.0f * v;
+        return horizonZenith * (1.0f - coordinate * coordinate);
+    }
+    float coordinate = 2.0f * v - 1.0f;
+    return horizonZenith + beta * coordinate * coordinate;
+}
+
+// Single scattering toward the observer, every texel marching its own view ray, rows
+// spread over the pool. Columns are the cosine of the azimuth from the sun, squared
+// toward the sun side.
+AtmosphereLut ComputeSkyViewLut(const AtmosphereParameters& atmosphere, const AtmosphereLut& transmittance, ThreadPool& pool = ThreadPool::Shared()) {
+
+    const float pi = 3.14159265f;
+    const int steps = 30;
+
+    AtmosphereLut lut = AtmosphereLut();
+    lut.width = skyViewLutWidth;
+    lut.height = skyViewLutHeight;
+    lut.texels.resize((size_t)lut.width * lut.height * 3);
+
+    float observer = atmosphere.ObserverRadius();
+    float sunZenith = std::clamp(atmosphere.sunZenith, -1.0f, 1.0f);
+    float sun[3] = { std::sqrt(1.0f - sunZenith * sunZenith), sunZenith, 0.0f };
+
+    float g = atmosphere.mieAnisotropy;
+
+    pool.ParallelFor(0, lut.height, 1, [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+
+            float zenithAngle = skyViewZenithAngle(atmosphere, (y + 0.5f) / lut.height);
+            float viewZenith = std::cos(zenithAngle), viewHorizontal = std::sin(zenithAngle);
+
+            bool ground = rayHitsGround(observer, viewZenith, atmosphere.bottomRadius);
+            float length = ground ? raySphereDistance(observer, viewZenith, atmosphere.bottomRadius)
+                                  : std::max(raySphereDistance(observer, viewZenith, atmosphere.topRadius), 0.0f);
+            float stepLength = length / steps;
+
+            for (int x = 0; x < lut.width; x++) {
+
+                float coordinate = (x + 0.5f) / lut.width;
+                float azimuth = 1.0f - 2.0f * coordinate * coordinate;
+                float view[3] = { viewHorizontal * azimuth, viewZenith, viewHorizontal * std::sqrt(std::max(1.0f - azimuth * azimuth, 0.0f)) };
+
+                float cosine = view[0] * sun[0] + view[1] * sun[1] + view[2] * sun[2];
+                float rayleighPhase = 3.0f / (16.0f * pi) * (1.0f + cosine * cosine);
+                float miePhase = 3.0f / (8.0f * pi) * ((1.0f - g * g) * (1.0f + cosine * cosine)) /
+                                 ((2.0f + g * g) * std::pow(std::max(1.0f + g * g - 2.0f * g * cosine, 1e-4f), 1.5f));
+
+                float luminance[3] = { 0.0f, 0.0f, 0.0f }, throughput[3] = { 1.0f, 1.0f, 1.0f };
+
+                for (int i = 0; i < steps; i++) {
+                    float t = (i + 0.5f) * stepLength;
+                    float position[3] = { view[0] * t, observer + view[1] * t, view[2] * t };
+                    float r = std::sqrt(position[0] * position[0] + position[1] * position[1] + position[2] * position[2]);
+                    float localSunZenith = (position[0] * sun[0] + position[1] * sun[1] + position[2] * sun[2]) / r;
+
+                    float rayleigh[3], mie, extinction[3], sunLight[3];
+                    atmosphereCoefficients(atmosphere, r - atmosphere.bottomRadius, rayleigh, mie, extinction);
+                    sunTransmittance(atmosphere, transmittance, r, localSunZenith, sunLight);
+
+                    // Scattering integrated analytically over the step, so long steps do not overshoot
+                    for (int c = 0; c < 3; c++) {
+                        float scattering = (rayleigh[c] * rayleighPhase + mie * miePhase) * sunLight[c];
+                        float stepTransmittance = std::exp(-extinction[c] * stepLength);
+                        luminance[c] += throughput[c] * scattering * (1.0f - stepTransmittance) / std::max(extinction[c], 1e-7f);
+                        throughput[c] *= stepTransmittance;
+                    }
+                }
+
+                if (ground) {
+                    float position[3] = { view[0] * length, observer + view[1] * length, view[2] * length };
+                    float r = atmosphere.bottomRadius;
+                    float lit = std::max((position[0] * sun[0] + position[1] * sun[1] + position[2] * sun[2]) / r, 0.0f);
+
+                    float sunLight[3];
+                    sunTransmittance(atmosphere, transmittance, r, lit, sunLight);
+                    for (int c = 0; c < 3; c++) luminance[c] += throughput[c] * sunLight[c] * lit * atmosphere.groundAlbedo / pi;
+                }
+
+                float* texel = lut.At(x, y);
+                for (int c = 0; c < 3; c++) texel[c] = luminance[c];
+            }
+        }
+    });
+
+    return lut;
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+// Cache key for a table: the generator version and every parameter it depends on
+struct AtmosphereCacheParameters {
+    uint32_t generatorVersion;
+    AtmosphereParameters atmosphere;
+};
+
+bool openCachedLut(VolumeCache& cache, const char* prefix, const AtmosphereCacheParameters& parameters, AtmosphereLut& lut) {
+
+    MappedVolume cached;
+    if (!cache.Open(prefix, lut.width, lut.height, 3, VolumeFloat32, &parameters, sizeof(parameters), 0, cached)) return false;
+    if (cached.header->payloadSize != lut.texels.size() * sizeof(float)) return false;
+
+    memcpy(lut.texels.data(), cached.data, cached.header->payloadSize);
+    return true;
+}
+
+// The transmittance table for these parameters from the cache, or computed and written
+// back. It does not depend on the sun, so the sun is left out of the key.
+AtmosphereLut LoadTransmittanceLut(AtmosphereParameters atmosphere, VolumeCache& cache) {
+
+    atmosphere.sunZenith = 0.0f;
+    AtmosphereCacheParameters parameters = { atmosphereGeneratorVersion, atmosphere };
+
+    AtmosphereLut lut = AtmosphereLut();
+    lut.width = transmittanceLutWidth;
+    lut.height = transmittanceLutHeight;
+    lut.texels.resize((size_t)lut.width * lut.height * 3);
+    if (openCachedLut(cache, "sky_transmittance", parameters, lut)) return lut;
+
+    lut = ComputeTransmittanceLut(atmosphere);
+    cache.Write("sky_transmittance", lut.width, lut.height, 3, VolumeFloat32, &parameters, sizeof(parameters), 0, lut.texels.data(), lut.texels.size() * sizeof(float));
+    return lut;
+}
+
+AtmosphereLut LoadSkyViewLut(const AtmosphereParameters& atmosphere, const AtmosphereLut& transmittance, VolumeCache& cache) {
+
+    AtmosphereCacheParameters parameters = { atmosphereGeneratorVersion, atmosphere };
+
+    AtmosphereLut lut = AtmosphereLut();
+    lut.width = skyViewLutWidth;
+    lut.height = skyViewLutHeight;
+    lut.texels.resize((size_t)lut.width * lut.height * 3);
+    if (openCachedLut(cache, "sky_view", parameters, lut)) return lut;
+
+    lut = ComputeSkyViewLut(atmosphere, transmittance);
+    cache.Write("sky_view", lut.width, lut.height, 3, VolumeFloat32, &parameters, sizeof(parameters), 0, lut.texels.data(), lut.texels.size() * sizeof(float));
+    return lut;
+}
+
+// Loads or computes the sky-view table for a new sun on a background thread. The result
+// may only be touched once Finished() is true.
+class SkyViewJob {
+public:
+    AtmosphereParameters atmosphere;
+    std::shared_ptr<const AtmosphereLut> transmittance;
+    AtmosphereLut skyView;
+    double milliseconds = 0.0;
+
+    static std::shared_ptr<SkyViewJob> Start(const AtmosphereParameters& atmosphere, std::shared_ptr<const AtmosphereLut> transmittance);
+    bool Finished();
+    ~SkyViewJob();
+
+private:
+    std::thread worker;
+    std::atomic<bool> finished{false};
+};
+
+std::shared_ptr<SkyViewJob> SkyViewJob::Start(const AtmosphereParameters& atmosphere, std::shared_ptr<const AtmosphereLut> transmittance) {
+    std::shared_ptr<SkyViewJob> job = std::make_shared<SkyViewJob>();
+    job->atmosphere = atmosphere;
+    job->transmittance = transmittance;
+
+    SkyViewJob* state = job.get();
+    job->worker = std::thread([state]() {
+        auto start = std::chrono::steady_clock::now();
+        VolumeCache cache = VolumeCache::Create();
+        state->skyView = LoadSkyViewLut(state->atmosphere, *state->transmittance, cache);
+        state->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        state->finished.store(true, std::memory_order_release);
+    });
+
+    return job;
+}
+
+bool SkyViewJob::Finished() {
+    return finished.load(std::memory_order_acquire);
+}
+
+SkyViewJob::~SkyViewJob() {
+    if (worker.joinable()) worker.join();
+}
+
+#endif /* atmosphere_h */
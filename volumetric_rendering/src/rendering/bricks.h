@@ -0,0 +1,277 @@
+//
+//  bricks.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef bricks_h
+#define bricks_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// A sparse virtual cloud volume, much larger than any dense texture: a grid of bricks,
+// each brickSize³ voxels of the same noise GenerateNoiseVolume produces, evaluated in
+// world voxel coordinates so neighbouring bricks line up. Every brick is stored with a
+// one-voxel apron copied from its neighbours, so trilinear filtering inside the atlas
+// never reads another brick's data.
+const int brickSize = 32;
+const int brickApron = 1;
+const int brickStoredSize = brickSize + 2 * brickApron;
+
+struct SparseVolumeParameters {
+    int bricks[3] = { 128, 4, 128 };                        // extent of the virtual volume, in bricks
+    float origin[3] = { -2048.0f, 16.0f, -2048.0f };        // world position of its minimum corner
+    float voxelSize = 1.0f;
+    int worleyTile = 256;                                   // voxels after which the Worley cells repeat
+    float coverageFrequency = 0.002f;                       // scale of the clear gaps between cloud fields
+    float coverageBias = 0.0f;                              // raise for more cloud, lower for more sky
+    NoiseParameters noise;
+
+    SparseVolumeParameters() {
+        // The feature-point density of the 128³ volume over the larger Worley tile: its
+        // 100 points become a 5³ grid, so twice the tile needs a 10³ grid
+        noise.featurePoints = 1000;
+        noise.worleyPeriodic = true;
+    }
+
+    int BrickCount() const { return bricks[0] * bricks[1] * bricks[2]; }
+    int BrickIndex(int x, int y, int z) const { return x + y * bricks[0] + z * bricks[0] * bricks[1]; }
+    void BrickCoordinate(int index, int& x, int& y, int& z) const {
+        x = index % bricks[0];
+        y = (index / bricks[0]) % bricks[1];
+        z = index / (bricks[0] * bricks[1]);
+    }
+};
+
+// Whether a noise value can produce any density in the cloud shader (see macrocellSkip)
+inline bool brickDensityVisible(float maximum) {
+    return std::clamp(maximum * maximum * 3.0f - 0.2f, 0.0f, 1.0f) * 2.5f >= 0.01f;
+}
+
+WorleyGrid sparseWorleyGrid(const SparseVolumeParameters& parameters) {
+    uint64_t worleySeed = ((uint64_t)1 << 32) | parameters.noise.seed;
+    return WorleyGrid::Create(parameters.noise.featurePoints, parameters.noise.worleyPointsPerCell, parameters.worleyTile, worleySeed, true);
+}
+
+// Fills brickStoredSize³ voxels (apron included) for one brick. The layer fades in over
+// its lowest fifth and out over its top two fifths, and a low-frequency coverage noise
+// opens clear sky between cloud fields. Returns false when no voxel can reach cloud
+// density, in which case the brick is never allocated.
+bool GenerateBrick(const SparseVolumeParameters& parameters, WorleyGrid& worley, int brick, float* voxels) {
+
+    int bx, by, bz;
+    parameters.BrickCoordinate(brick, bx, by, bz);
+
+    const NoiseParameters& noise = parameters.noise;
+    float seed = counterHash(noise.seed, 0) % 10000000;
+    int layerHeight = parameters.bricks[1] * brickSize;
+    int tile = parameters.worleyTile;
+
+    int x0 = bx * brickSize - brickApron, y0 = by * brickSize - brickApron, z0 = bz * brickSize - brickApron;
+
+    float rowX[brickStoredSize], row[brickStoredSize];
+    for (int x = 0; x < brickStoredSize; x++) rowX[x] = (x0 + x + seed) * noise.frequency;
+
+    // One coverage value per column
+    float coverage[brickStoredSize * brickStoredSize];
+    bool covered = false;
+    for (int z = 0; z < brickStoredSize; z++) {
+        for (int x = 0; x < brickStoredSize; x++) {
+            double sample = ::noise((x0 + x + seed) * parameters.coverageFrequency, 0.5, (z0 + z + seed) * parameters.coverageFrequency);
+            coverage[x + z * brickStoredSize] = std::clamp(((float)sample + parameters.coverageBias) * 4.0f, 0.0f, 1.0f);
+            covered = covered || coverage[x + z * brickStoredSize] > 0.0f;
+        }
+    }
+    if (!covered) return false;
+
+    float maximum = 0.0f;
+    for (int z = 0; z < brickStoredSize; z++) {
+        for (int y = 0; y < brickStoredSize; y++) {
+
+            int gy = y0 + y, gz = z0 + z;
+            float height = (gy + 0.5f) / layerHeight;
+            float profile = std::clamp(height / 0.2f, 0.0f, 1.0f) * std::clamp((1.0f - height) / 0.4f, 0.0f, 1.0f);
+
+            float* out = &voxels[(size_t)y * brickStoredSize + (size_t)z * brickStoredSize * brickStoredSize];
+            const float* columns = &coverage[z * brickStoredSize];
+            if (profile <= 0.0f) {
+                std::fill(out, out + brickStoredSize, 0.0f);
+                continue;
+            }
+
+            noiseLayerRow(rowX, (gy + seed) * noise.frequency, (gz + seed) * noise.frequency, noise.lacunarity, noise.persistence, noise.octaves, row, brickStoredSize);
+
+            float wy = (float)(((gy % tile) + tile) % tile), wz = (float)(((gz % tile) + tile) % tile);
+            for (int x = 0; x < brickStoredSize; x++) {
+                float wx = (float)((((x0 + x) % tile) + tile) % tile);
+                float voronoiValue = 1 - worley.Distance(wx, wy, wz) / worley.globalMaxDist;
+
+                out[x] = std::clamp((row[x] * 0.5f + 0.5f) * voronoiValue * profile * columns[x], 0.0f, 1.0f);
+                maximum = std::max(maximum, out[x]);
+            }
+        }
+    }
+
+    return brickDensityVisible(maximum);
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+enum BrickState : uint8_t {
+    BrickMissing = 0,
+    BrickResident = 1,
+    BrickEmpty = 2,         // generated once, found empty, never given a slot
+    BrickLoading = 3,
+};
+
+// Decides which bricks live in the atlas. Bricks within `radius` bricks of the camera
+// are requested nearest first; a new brick takes a free slot, or evicts the resident
+// brick farthest from the camera if that one is farther away than the new brick.
+class BrickResidency {
+public:
+    SparseVolumeParameters parameters;
+    int radius;
+
+    std::vector<uint8_t> states;        // per brick, a BrickState
+    std::vector<int> slots;             // per brick, its atlas slot or -1
+    std::vector<int> slotBricks;        // per slot, the brick in it or -1
+
+    static BrickResidency Create(const SparseVolumeParameters& parameters, int slotCount, int radius);
+
+    std::vector<int> Requests(const float cameraPosition[3], int maxCount);
+    int Allocate(int brick, const float cameraPosition[3], int& evicted);
+    void MarkEmpty(int brick);
+    void Cancel(int brick);
+
+    int ResidentCount();
+
+private:
+    std::vector<int> freeSlots;
+    float DistanceSquared(int brick, const float cameraPosition[3]);
+};
+
+BrickResidency BrickResidency::Create(const SparseVolumeParameters& parameters, int slotCount, int radius) {
+    BrickResidency residency = BrickResidency();
+    residency.parameters = parameters;
+    residency.radius = radius;
+
+    residency.states.assign(parameters.BrickCount(), BrickMissing);
+    residency.slots.assign(parameters.BrickCount(), -1);
+    residency.slotBricks.assign(slotCount, -1);
+
+    // Handed out from the back, so slot 0 is used first
+    for (int slot = slotCount - 1; slot >= 0; slot--) residency.freeSlots.push_back(slot);
+
+    return residency;
+}
+
+float BrickResidency::DistanceSquared(int brick, const float cameraPosition[3]) {
+    int coordinate[3];
+    parameters.BrickCoordinate(brick, coordinate[0], coordinate[1], coordinate[2]);
+
+    float distance = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        float centre = parameters.origin[axis] + (coordinate[axis] + 0.5f) * brickSize * parameters.voxelSize;
+        distance += (centre - cameraPosition[axis]) * (centre - cameraPosition[axis]);
+    }
+    return distance;
+}
+
+// Up to maxCount missing bricks around the camera, nearest first. They are marked as
+// loading until Allocate, MarkEmpty or Cancel settles them.
+std::vector<int> BrickResidency::Requests(const float cameraPosition[3], int maxCount) {
+
+    int lower[3], upper[3];
+    for (int axis = 0; axis < 3; axis++) {
+        int centre = (int)std::floor((cameraPosition[axis] - parameters.origin[axis]) / (brickSize * parameters.voxelSize));
+        lower[axis] = std::max(centre - radius, 0);
+        upper[axis] = std::min(centre + radius, parameters.bricks[axis] - 1);
+    }
+
+    // With the atlas full, only bricks that would displace a farther one are worth generating
+    float limit = INFINITY;
+    if (freeSlots.empty()) {
+        limit = 0.0f;
+        for (int brick : slotBricks) limit = std::max(limit, DistanceSquared(brick, cameraPosition));
+    }
+
+    std::vector<std::pair<float, int>> candidates;
+    for (int z = lower[2]; z <= upper[2]; z++) {
+        for (int y = lower[1]; y <= upper[1]; y++) {
+            for (int x = lower[0]; x <= upper[0]; x++) {
+                int brick = parameters.BrickIndex(x, y, z);
+                if (states[brick] != BrickMissing) continue;
+
+                float distance = DistanceSquared(brick, cameraPosition);
+                if (distance < limit) candidates.push_back({ distance, brick });
+            }
+        }
+    }
+
+    int count = std::min((int)candidates.size(), maxCount);
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+
+    std::vector<int> requests;
+    for (int i = 0; i < count; i++) {
+        requests.push_back(candidates[i].second);
+        states[candidates[i].second] = BrickLoading;
+    }
+    return requests;
+}
+
+// Slot for a non-empty brick, or -1 if the atlas is full of nearer bricks. `evicted`
+// is the brick that had to leave, or -1.
+int BrickResidency::Allocate(int brick, const float cameraPosition[3], int& evicted) {
+
+    evicted = -1;
+
+    if (freeSlots.empty()) {
+        int farthestSlot = -1;
+        float farthest = DistanceSquared(brick, cameraPosition);
+
+        for (int slot = 0; slot < (int)slotBricks.size(); slot++) {
+            float distance = DistanceSquared(slotBricks[slot], cameraPosition);
+            if (distance > farthest) {
+                farthest = distance;
+                farthestSlot = slot;
+            }
+        }
+
+        if (farthestSlot < 0) {
+            states[brick] = BrickMissing;
+            return -1;
+        }
+
+        evicted = slotBricks[farthestSlot];
+        states[evicted] = BrickMissing;
+        slots[evicted] = -1;
+        freeSlots.push_back(farthestSlot);
+    }
+
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+
+    slotBricks[slot] = brick;
+    slots[brick] = slot;
+    states[brick] = BrickResident;
+    return slot;
+}
+
+void BrickResidency::MarkEmpty(int brick) {
+    states[brick] = BrickEmpty;
+}
+
+void BrickResidency::Cancel(int brick) {
+    if (states[brick] == BrickLoading) states[brick] = BrickMissing;
+}
+
+int BrickResidency::ResidentCount() {
+    return (int)(slotBricks.size() - freeSlots.size());
+}
+
+#endif /* bricks_h */
@@ -0,0 +1,376 @@
+//
+//  cloud_reprojection.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef cloud_reprojection_h
+#define cloud_reprojection_h
+
+// Marches the clouds into a reduced-resolution target and brings them back up to the
+// screen in two cheap full-resolution passes:
+//
+//   1. atmospheric_clouds (CLOUD_TARGET)  one ray per cloudScale x cloudScale block
+//   2. cloud_reprojection                 depth-aware upsample, blended with last frame
+//   3. cloud_composite                    background plus the premultiplied clouds
+//
+// Half and quarter always march the same pixel of each block and only upsample.
+// Checkerboard marches at half resolution but moves the marched pixel around the 2x2
+// block every frame, so four frames of reprojected history fill in full resolution.
+//
+// Only pixels that can see the cloud box are marched. With CloudBoundsScissor the box
+// is projected on the CPU and the march is scissored to its screen rectangle; with
+// CloudBoundsProxy the back faces of the box are rasterised instead of the quad, which
+// covers exactly its silhouette. Either way the full-resolution path draws the sky and
+// G-buffer background in a pass of its own (cloud_composite, BACKGROUND_PASS) and
+// blends the premultiplied clouds over it, so the march costs in proportion to the
+// box's share of the screen. CloudBoundsScreen marches every pixel as before.
+enum CloudResolution {
+    CloudFull,
+    CloudHalf,
+    CloudQuarter,
+    CloudCheckerboard,
+};
+
+enum CloudBounds {
+    CloudBoundsScreen,
+    CloudBoundsScissor,
+    CloudBoundsProxy,
+};
+
+class CloudReprojection {
+public:
+    CloudResolution resolution;
+    CloudBounds bounds;
+    int scale;
+
+    static CloudReprojection Create(CloudResolution resolution, CloudBounds bounds, const std::string& defines);
+    static CloudResolution ResolutionFromEnvironment();
+    static CloudBounds BoundsFromEnvironment();
+    void Render(RayMarchingQuad& quad, DeferredRenderer& renderer);
+
+private:
+    Shader cloudShader, reprojectionShader, compositeShader, backgroundShader;
+    Cube proxy;
+
+    uint32_t cloudFramebuffer, cloudColor, cloudDistance;
+    uint32_t historyFramebuffers[2], history[2];
+    int currentHistory;
+
+    int width = 0, height = 0;
+    int frame;
+    bool historyValid;
+    glm::mat4 previousViewProjection;
+
+    void Allocate(int width, int height);
+    void March(RayMarchingQuad& quad, DeferredRenderer& renderer, int width, int height);
+    static void AssignParameters(GLenum filter);
+};
+
+// Pixel rectangle (x, y, width, height) of a width x height target that the box can
+// cover, or false when it is entirely off screen. A box reaching behind the camera is
+// given the whole target rather than clipped.
+bool projectBounds(glm::vec3 centre, glm::vec3 halfSize, int width, int height, int rectangle[4]) {
+
+    glm::mat4 viewProjection = camera.projection * camera.lookAt;
+    glm::vec2 lower = glm::vec2(1.0f), upper = glm::vec2(-1.0f);
+
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 sign = glm::vec3(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : -1.0f);
+        glm::vec4 clip = viewProjection * glm::vec4(centre + sign * halfSize, 1.0f);
+
+        if (clip.w <= 0.0001f) {
+            rectangle[0] = rectangle[1] = 0;
+            rectangle[2] = width;
+            rectangle[3] = height;
+            return true;
+        }
+        glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+        lower = glm::min(lower, ndc);
+        upper = glm::max(upper, ndc);
+    }
+
+    lower = glm::clamp(lower, -1.0f, 1.0f);
+    upper = glm::clamp(upper, -1.0f, 1.0f);
+    if (lower.x >= upper.x || lower.y >= upper.y) return false;
+
+    // A pixel of margin for the rasteriser's rounding
+    int x0 = std::max((int)std::floor((lower.x * 0.5f + 0.5f) * width) - 1, 0),
+        y0 = std::max((int)std::floor((lower.y * 0.5f + 0.5f) * height) - 1, 0),
+        x1 = std::min((int)std::ceil((upper.x * 0.5f + 0.5f) * width) + 1, width),
+        y1 = std::min((int)std::ceil((upper.y * 0.5f + 0.5f) * height) + 1, height);
+
+    rectangle[0] = x0;
+    rectangle[1] = y0;
+    rectangle[2] = x1 - x0;
+    rectangle[3] = y1 - y0;
+    return true;
+}
+
+CloudReprojection CloudReprojection::Create(CloudResolution resolution, CloudBounds bounds, const std::string& defines) {
+    CloudReprojection clouds = CloudReprojection();
+
+    clouds.resolution = resolution;
+    clouds.bounds = bounds;
+    clouds.scale = resolution == CloudQuarter ? 4 : resolution == CloudFull ? 1 : 2;
+    clouds.currentHistory = 0;
+    clouds.frame = 0;
+    clouds.historyValid = false;
+
+    // Marching every pixel at full resolution, the cloud shader composites straight onto the surface
+    if (resolution == CloudFull && bounds == CloudBoundsScreen) {
+        clouds.cloudShader = Shader::Create(shaderPath("atmospheric_clouds").c_str(), defines);
+        return clouds;
+    }
+
+    std::string cloudDefines = defines + "#define CLOUD_TARGET\n";
+    if (bounds == CloudBoundsProxy) {
+        cloudDefines += "#define CLOUD_PROXY\n";
+        clouds.proxy = Cube::Create();
+    }
+    clouds.cloudShader = Shader::Create(shaderPath("atmospheric_clouds").c_str(), cloudDefines);
+
+    if (resolution == CloudFull) {
+        clouds.backgroundShader = Shader::Create(shaderPath("cloud_composite").c_str(), defines + "#define BACKGROUND_PASS\n");
+        return clouds;
+    }
+
+    clouds.reprojectionShader = Shader::Create(shaderPath("cloud_reprojection").c_str(), defines);
+    clouds.compositeShader = Shader::Create(shaderPath("cloud_composite").c_str(), defines);
+
+    glGenFramebuffers(1, &clouds.cloudFramebuffer);
+    glGenTextures(1, &clouds.cloudColor);
+    glGenTextures(1, &clouds.cloudDistance);
+    glGenFramebuffers(2, clouds.historyFramebuffers);
+    glGenTextures(2, clouds.history);
+
+    return clouds;
+}
+
+// VOLUMETRIC_CLOUDS=half, quarter or checkerboard; anything else marches every pixel
+CloudResolution CloudReprojection::ResolutionFromEnvironment() {
+    const char* resolution = std::getenv("VOLUMETRIC_CLOUDS");
+    if (!resolution) return CloudFull;
+
+    std::string name = resolution;
+    if (name == "half") return CloudHalf;
+    if (name == "quarter") return CloudQuarter;
+    if (name == "checkerboard") return CloudCheckerboard;
+    return CloudFull;
+}
+
+// VOLUMETRIC_CLOUD_BOUNDS=proxy rasterises the box, screen marches every pixel; the default scissors
+CloudBounds CloudReprojection::BoundsFromEnvironment() {
+    const char* bounds = std::getenv("VOLUMETRIC_CLOUD_BOUNDS");
+    if (!bounds) return CloudBoundsScissor;
+
+    std::string name = bounds;
+    if (name == "screen") return CloudBoundsScreen;
+    if (name == "proxy") return CloudBoundsProxy;
+    return CloudBoundsScissor;
+}
+
+void CloudReprojection::Allocate(int width, int height) {
+
+    this->width = width;
+    this->height = height;
+    historyValid = false;
+
+    int lowWidth = (width + scale - 1) / scale,
+        lowHeight = (height + scale - 1) / scale;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, cloudFramebuffer);
+
+    glBindTexture(GL_TEXTURE_2D, cloudColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, lowWidth, lowHeight, 0, GL_RGBA, GL_FLOAT, 0);
+    AssignParameters(GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cloudColor, 0);
+
+    glBindTexture(GL_TEXTURE_2D, cloudDistance);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, lowWidth, lowHeight, 0, GL_RG, GL_FLOAT, 0);
+    AssignParameters(GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, cloudDistance, 0);
+
+    uint32_t attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+
+    for (int i = 0; i < 2; i++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, historyFramebuffers[i]);
+        glBindTexture(GL_TEXTURE_2D, history[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, 0);
+        AssignParameters(GL_LINEAR);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, history[i], 0);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void CloudReprojection::AssignParameters(GLenum filter) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+// Runs the cloud shader (CLOUD_TARGET) over the pixels of a width x height target that
+// can see the box
+void CloudReprojection::March(RayMarchingQuad& quad, DeferredRenderer& renderer, int width, int height) {
+
+    glm::vec3 centre, halfSize;
+    quad.Bounds(centre, halfSize);
+    quad.Bind(cloudShader, renderer);
+
+    glDisable(GL_DEPTH_TEST);
+
+    if (bounds == CloudBoundsProxy) {
+        // Back faces cover the silhouette from outside the box and from inside it alike;
+        // depth clamping keeps the near and far planes from cutting holes in them
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+        glEnable(GL_DEPTH_CLAMP);
+
+        proxy.position = centre;
+        proxy.scale = halfSize * 2.0f;
+        proxy.Render(cloudShader);
+
+        glDisable(GL_DEPTH_CLAMP);
+        glCullFace(GL_BACK);
+        glDisable(GL_CULL_FACE);
+    }
+    else if (bounds == CloudBoundsScissor) {
+        int rectangle[4];
+        if (projectBounds(centre, halfSize, width, height, rectangle)) {
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(rectangle[0], rectangle[1], rectangle[2], rectangle[3]);
+            quad.Draw();
+            glDisable(GL_SCISSOR_TEST);
+        }
+    }
+    else {
+        quad.Draw();
+    }
+
+    glEnable(GL_DEPTH_TEST);
+}
+
+void CloudReprojection::Render(RayMarchingQuad& quad, DeferredRenderer& renderer) {
+
+    if (resolution == CloudFull && bounds == CloudBoundsScreen) {
+        quad.Render(cloudShader, renderer);
+        return;
+    }
+
+    int width, height;
+    surface.GetFramebufferSize(&width, &height);
+
+    if (resolution == CloudFull) {
+        // The background everywhere, then the premultiplied clouds over it where the box is
+        backgroundShader.Use();
+
+        glActiveTexture(GL_TEXTURE0);
+        backgroundShader.SetInt("distanceToCamera", 0);
+        glBindTexture(GL_TEXTURE_2D, renderer.distanceToCamera);
+
+        glActiveTexture(GL_TEXTURE1);
+        backgroundShader.SetInt("normal", 1);
+        glBindTexture(GL_TEXTURE_2D, renderer.normal);
+        
+        sky.Bind(backgroundShader, 2);
+
+        quad.Draw();
+
+        cloudShader.Use();
+        cloudShader.SetInt("cloudScale", 1);
+        cloudShader.SetVector2("cloudJitter", glm::vec2(0.0f));
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        March(quad, renderer, width, height);
+        glDisable(GL_BLEND);
+        return;
+    }
+
+    if (width != this->width || height != this->height) Allocate(width, height);
+
+    // Which pixel of each block is marched this frame
+    const glm::vec2 checkerboard[4] = {
+        glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 1.0f), glm::vec2(1.0f, 0.0f), glm::vec2(0.0f, 1.0f)
+    };
+    glm::vec2 jitter = resolution == CloudCheckerboard ? checkerboard[frame % 4] : glm::vec2(0.0f);
+    float historyWeight = resolution == CloudCheckerboard && historyValid ? 0.75f : 0.0f;
+    frame++;
+
+    // 1. March at reduced resolution. Texels the march skips read as no cloud.
+    int lowWidth = (width + scale - 1) / scale,
+        lowHeight = (height + scale - 1) / scale;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, cloudFramebuffer);
+    glViewport(0, 0, lowWidth, lowHeight);
+    if (bounds != CloudBoundsScreen) {
+        glClearColor(0.0, 0.0, 0.0, 0.0);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    cloudShader.Use();
+    cloudShader.SetInt("cloudScale", scale);
+    cloudShader.SetVector2("cloudJitter", jitter);
+    March(quad, renderer, lowWidth, lowHeight);
+
+    // 2. Upsample and blend with the reprojected history
+    int previousHistory = currentHistory;
+    currentHistory = 1 - currentHistory;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, historyFramebuffers[currentHistory]);
+    glViewport(0, 0, width, height);
+
+    reprojectionShader.Use();
+    reprojectionShader.SetInt("cloudScale", scale);
+    reprojectionShader.SetVector2("cloudJitter", jitter);
+    reprojectionShader.SetFloat("historyWeight", historyWeight);
+    reprojectionShader.SetMatrix4("previousViewProjection", previousViewProjection);
+
+    glActiveTexture(GL_TEXTURE0);
+    reprojectionShader.SetInt("distanceToCamera", 0);
+    glBindTexture(GL_TEXTURE_2D, renderer.distanceToCamera);
+
+    glActiveTexture(GL_TEXTURE1);
+    reprojectionShader.SetInt("cloudColor", 1);
+    glBindTexture(GL_TEXTURE_2D, cloudColor);
+
+    glActiveTexture(GL_TEXTURE2);
+    reprojectionShader.SetInt("cloudDistance", 2);
+    glBindTexture(GL_TEXTURE_2D, cloudDistance);
+
+    glActiveTexture(GL_TEXTURE3);
+    reprojectionShader.SetInt("history", 3);
+    glBindTexture(GL_TEXTURE_2D, history[previousHistory]);
+
+    quad.Draw();
+
+    // 3. Composite onto the surface
+    glBindFramebuffer(GL_FRAMEBUFFER, surface.framebuffer);
+
+    compositeShader.Use();
+
+    glActiveTexture(GL_TEXTURE0);
+    compositeShader.SetInt("distanceToCamera", 0);
+    glBindTexture(GL_TEXTURE_2D, renderer.distanceToCamera);
+
+    glActiveTexture(GL_TEXTURE1);
+    compositeShader.SetInt("normal", 1);
+    glBindTexture(GL_TEXTURE_2D, renderer.normal);
+
+    glActiveTexture(GL_TEXTURE2);
+    compositeShader.SetInt("clouds", 2);
+    glBindTexture(GL_TEXTURE_2D, history[currentHistory]);
+    
+    sky.Bind(compositeShader, 3);
+
+    quad.Draw();
+
+    previousViewProjection = camera.projection * camera.lookAt;
+    historyValid = true;
+}
+
+#endif /* cloud_reprojection_h */
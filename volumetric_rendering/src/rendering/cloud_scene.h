@@ -0,0 +1,193 @@
+//
+//  cloud_scene.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef cloud_scene_h
+#define cloud_scene_h
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Many cloud volumes in one scene. Each is a box with its own position, half size and
+// rotation about the vertical axis, a density scale, and the sub-box of the shared noise
+// texture it reads (noiseOrigin + uv * noiseExtent, in normalized texture coordinates).
+//
+// A BVH over their world bounds is built here and uploaded as a texture buffer; the
+// cloud shader walks it once per ray to gather the entry/exit intervals of the volumes
+// the ray actually crosses, sorts them and marches only inside them.
+struct CloudVolume {
+    float position[3] = { 0.0f, 0.0f, -10.0f };
+    float halfSize[3] = { 4.5f, 4.5f, 4.5f };
+    float yaw = 0.0f;
+    float densityScale = 1.0f;
+    float noiseOrigin[3] = { 0.0f, 0.0f, 0.0f };
+    float noiseExtent = 1.0f;
+};
+
+// Two RGBA32F texels: (min, first) and (max, count). Leaves hold `count` volumes from
+// `first` on; interior nodes have count 0 and their children at first and first + 1.
+struct CloudBVHNode {
+    float min[3];
+    float first;
+    float max[3];
+    float count;
+};
+static_assert(sizeof(CloudBVHNode) == 32, "BVH nodes are uploaded as two vec4 texels");
+
+const int cloudBVHLeafSize = 2;
+const int cloudSceneVolumeTexels = 5;
+
+class CloudScene {
+public:
+    std::vector<CloudVolume> volumes;       // reordered by Build() so every leaf is a contiguous range
+    std::vector<CloudBVHNode> nodes;
+
+    static CloudScene Load(const std::string& path);
+    void Build();
+    void Bounds(const CloudVolume& volume, float min[3], float max[3]);
+    std::vector<float> VolumeTexels(int noiseSize);
+
+private:
+    void Split(int node, int first, int count);
+};
+
+// One volume per line: "x y z halfX halfY halfZ yaw density", optionally followed by
+// "noiseX noiseY noiseZ noiseExtent". '#' starts a comment.
+CloudScene CloudScene::Load(const std::string& path) {
+    CloudScene scene = CloudScene();
+
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+
+        std::stringstream stream(line);
+        CloudVolume volume = CloudVolume();
+        if (!(stream >> volume.position[0] >> volume.position[1] >> volume.position[2]
+                     >> volume.halfSize[0] >> volume.halfSize[1] >> volume.halfSize[2]
+                     >> volume.yaw >> volume.densityScale)) continue;
+
+        float origin[3], extent;
+        if (stream >> origin[0] >> origin[1] >> origin[2] >> extent) {
+            std::copy(origin, origin + 3, volume.noiseOrigin);
+            volume.noiseExtent = extent;
+        }
+        scene.volumes.push_back(volume);
+    }
+
+    // Without a scene file, the single box the renderer has always drawn
+    if (scene.volumes.empty()) scene.volumes.push_back(CloudVolume());
+
+    scene.Build();
+    return scene;
+}
+
+// World-space bounds of the rotated box
+void CloudScene::Bounds(const CloudVolume& volume, float min[3], float max[3]) {
+    float c = std::fabs(std::cos(volume.yaw)), s = std::fabs(std::sin(volume.yaw));
+    float extent[3] = {
+        c * volume.halfSize[0] + s * volume.halfSize[2],
+        volume.halfSize[1],
+        s * volume.halfSize[0] + c * volume.halfSize[2],
+    };
+    for (int axis = 0; axis < 3; axis++) {
+        min[axis] = volume.position[axis] - extent[axis];
+        max[axis] = volume.position[axis] + extent[axis];
+    }
+}
+
+// Median split on the longest axis of the centroids, down to cloudBVHLeafSize volumes
+void CloudScene::Build() {
+    nodes.clear();
+    nodes.push_back(CloudBVHNode());
+    Split(0, 0, (int)volumes.size());
+}
+
+void CloudScene::Split(int node, int first, int count) {
+
+    float lower[3] = { INFINITY, INFINITY, INFINITY }, upper[3] = { -INFINITY, -INFINITY, -INFINITY };
+    float centreLower[3] = { INFINITY, INFINITY, INFINITY }, centreUpper[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+    for (int i = first; i < first + count; i++) {
+        float min[3], max[3];
+        Bounds(volumes[i], min, max);
+        for (int axis = 0; axis < 3; axis++) {
+            lower[axis] = std::min(lower[axis], min[axis]);
+            upper[axis] = std::max(upper[axis], max[axis]);
+            centreLower[axis] = std::min(centreLower[axis], volumes[i].position[axis]);
+            centreUpper[axis] = std::max(centreUpper[axis], volumes[i].position[axis]);
+        }
+    }
+
+    std::copy(lower, lower + 3, nodes[node].min);
+    std::copy(upper, upper + 3, nodes[node].max);
+
+    if (count <= cloudBVHLeafSize) {
+        nodes[node].first = (float)first;
+        nodes[node].count = (float)count;
+        return;
+    }
+
+    int axis = 0;
+    for (int i = 1; i < 3; i++) {
+        if (centreUpper[i] - centreLower[i] > centreUpper[axis] - centreLower[axis]) axis = i;
+    }
+
+    int half = count / 2;
+    std::nth_element(volumes.begin() + first, volumes.begin() + first + half, volumes.begin() + first + count,
+                     [axis](const CloudVolume& a, const CloudVolume& b) { return a.position[axis] < b.position[axis]; });
+
+    // Children go in as a pair, so the shader finds the second one next to the first
+    int children = (int)nodes.size();
+    nodes.push_back(CloudBVHNode());
+    nodes.push_back(CloudBVHNode());
+    nodes[node].first = (float)children;
+    nodes[node].count = 0.0f;
+
+    Split(children, first, half);
+    Split(children + 1, first + half, count - half);
+}
+
+// cloudSceneVolumeTexels RGBA32F texels per volume: the three rows of the world-to-box
+// transform (the box spans [-1, 1]), (noiseOrigin, noiseExtent) and
+// (densityScale, step size, voxel size, 0)
+std::vector<float> CloudScene::VolumeTexels(int noiseSize) {
+
+    std::vector<float> texels;
+    texels.reserve(volumes.size() * cloudSceneVolumeTexels * 4);
+
+    for (const CloudVolume& volume : volumes) {
+        float c = std::cos(volume.yaw), s = std::sin(volume.yaw);
+
+        // Local axes x = (c, 0, -s), y = (0, 1, 0), z = (s, 0, c), scaled into [-1, 1]
+        float axes[3][3] = { { c, 0.0f, -s }, { 0.0f, 1.0f, 0.0f }, { s, 0.0f, c } };
+        for (int row = 0; row < 3; row++) {
+            float inverse = 1.0f / volume.halfSize[row];
+            float offset = 0.0f;
+            for (int axis = 0; axis < 3; axis++) {
+                texels.push_back(axes[row][axis] * inverse);
+                offset -= axes[row][axis] * volume.position[axis];
+            }
+            texels.push_back(offset * inverse);
+        }
+
+        texels.insert(texels.end(), { volume.noiseOrigin[0], volume.noiseOrigin[1], volume.noiseOrigin[2], volume.noiseExtent });
+
+        // The 9-unit box took 0.05-unit steps; larger volumes keep the same number of steps
+        float largest = std::max(std::max(volume.halfSize[0], volume.halfSize[1]), volume.halfSize[2]);
+        float stepSize = 0.05f * largest / 4.5f;
+        float voxelSize = 2.0f * largest / (noiseSize * volume.noiseExtent);
+        texels.insert(texels.end(), { volume.densityScale, stepSize, voxelSize, 0.0f });
+    }
+
+    return texels;
+}
+
+#endif /* cloud_scene_h */
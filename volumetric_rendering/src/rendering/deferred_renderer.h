@@ -8,64 +8,79 @@
 #ifndef deferred_renderer_h
 #define deferred_renderer_h
 
+// Wide keeps a world-space position target. Compact drops it (the shaders rebuild the
+// position from the camera ray and the linear distance), packs the normal
+// octahedrally into two half floats and keeps a single-channel distance.
+//
+//   wide:     position RGBA16F, distance R32F, normal RGBA16F, albedo RGBA8   (24 B/pixel)
+//   compact:                    distance R32F, normal RG16F,   albedo RGBA8   (12 B/pixel)
+enum GBufferLayout {
+    GBufferWide,
+    GBufferCompact,
+};
+
 class DeferredRenderer {
 public:
     uint32_t position, distanceToCamera, normal, albedo;
+    GBufferLayout layout;
     
-    static DeferredRenderer Create();
+    static DeferredRenderer Create(GBufferLayout layout = GBufferWide);
+    static GBufferLayout LayoutFromEnvironment();
+    std::string Defines();
     void Update();
     void Bind();
     void Unbind();
     
 private:
     uint32_t framebufferObject, renderbufferObject;
+    int width = 0, height = 0;
+    void Allocate();
     void AssignParameters();
 };
 
-DeferredRenderer DeferredRenderer::Create() {
-    
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
+DeferredRenderer DeferredRenderer::Create(GBufferLayout layout) {
     
     DeferredRenderer renderer = DeferredRenderer();
+    renderer.layout = layout;
+    renderer.position = 0;
 
     glGenFramebuffers(1, &renderer.framebufferObject);
     glBindFramebuffer(GL_FRAMEBUFFER, renderer.framebufferObject);
     
     glGenRenderbuffers(1, &renderer.renderbufferObject);
     
-    glGenTextures(1, &renderer.position);
-    glBindTexture(GL_TEXTURE_2D, renderer.position);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGB, GL_FLOAT, 0);
-    renderer.AssignParameters();
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, renderer.position, 0);
+    if (layout == GBufferWide) {
+        glGenTextures(1, &renderer.position);
+        glBindTexture(GL_TEXTURE_2D, renderer.position);
+        renderer.AssignParameters();
+    }
     
     glGenTextures(1, &renderer.distanceToCamera);
     glBindTexture(GL_TEXTURE_2D, renderer.distanceToCamera);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_FLOAT, 0);
     renderer.AssignParameters();
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + 1, GL_TEXTURE_2D, renderer.distanceToCamera, 0);
     
     glGenTextures(1, &renderer.normal);
     glBindTexture(GL_TEXTURE_2D, renderer.normal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGB, GL_FLOAT, 0);
     renderer.AssignParameters();
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + 2, GL_TEXTURE_2D, renderer.normal, 0);
     
     glGenTextures(1, &renderer.albedo);
     glBindTexture(GL_TEXTURE_2D, renderer.albedo);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
     renderer.AssignParameters();
+    
+    renderer.Update();
+    
+    if (layout == GBufferWide) glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, renderer.position, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + 1, GL_TEXTURE_2D, renderer.distanceToCamera, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + 2, GL_TEXTURE_2D, renderer.normal, 0);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + 3, GL_TEXTURE_2D, renderer.albedo, 0);
     
+    // The fragment outputs keep their locations in both layouts; compact just has nothing at 0
     uint32_t attachments[4] = {
-        GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3
+        layout == GBufferWide ? (uint32_t)GL_COLOR_ATTACHMENT0 : (uint32_t)GL_NONE, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3
     };
     
     glDrawBuffers(4, attachments);
     
-    glBindRenderbuffer(GL_RENDERBUFFER, renderer.renderbufferObject);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderer.renderbufferObject);
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -73,37 +88,60 @@ DeferredRenderer DeferredRenderer::Create() {
     return renderer;
 }
 
+// VOLUMETRIC_GBUFFER=compact selects the compact layout
+GBufferLayout DeferredRenderer::LayoutFromEnvironment() {
+    const char* layout = std::getenv("VOLUMETRIC_GBUFFER");
+    return layout && std::string(layout) == "compact" ? GBufferCompact : GBufferWide;
+}
+
+// Preprocessor lines for every shader that writes or reads the G-buffer
+std::string DeferredRenderer::Defines() {
+    return layout == GBufferCompact ? "#define GBUFFER_COMPACT\n" : "";
+}
+
+// Reallocates the attachments only when the framebuffer has actually been resized
 void DeferredRenderer::Update() {
     
-    glBindFramebuffer(GL_FRAMEBUFFER, framebufferObject);
-    glBindRenderbuffer(GL_RENDERBUFFER, renderbufferObject);
-    
     int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
+    surface.GetFramebufferSize(&width, &height);
+    
+    if (width == this->width && height == this->height) return;
+    this->width = width;
+    this->height = height;
     
-    glBindTexture(GL_TEXTURE_2D, position);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, 0);
+    Allocate();
+}
+
+void DeferredRenderer::Allocate() {
+    
+    if (layout == GBufferWide) {
+        glBindTexture(GL_TEXTURE_2D, position);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, 0);
+    }
     
     glBindTexture(GL_TEXTURE_2D, distanceToCamera);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, 0);
     
     glBindTexture(GL_TEXTURE_2D, normal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, 0);
+    if (layout == GBufferWide) glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, 0);
+    else                       glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, width, height, 0, GL_RG, GL_FLOAT, 0);
     
     glBindTexture(GL_TEXTURE_2D, albedo);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
     
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbufferObject);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-    
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
 }
 
 void DeferredRenderer::Bind() {
     Update();
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebufferObject);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebufferObject);
 }
 
 void DeferredRenderer::Unbind() {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, surface.framebuffer);
 }
 
 void DeferredRenderer::AssignParameters() {
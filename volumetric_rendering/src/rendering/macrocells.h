@@ -0,0 +1,129 @@
+//
+//  macrocells.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef macrocells_h
+#define macrocells_h
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Coarse occupancy for empty-space skipping: a min/max pyramid of the noise volume, one
+// level per mip level the cloud shader samples. A cell of level k spans
+// macrocellSize << k voxels, and its (min, max) covers every base voxel that trilinear
+// filtering of mip k or k - 1 can read while sampling inside it. The march blends those
+// two levels for a lod in (k - 1, k], so it reads level ceil(lod); near the camera
+// (lod 0) that is 8³ cells grown by one voxel. A cell whose maximum maps to no density
+// in the cloud shader can be stepped over whole.
+//
+// Level k holds max(1, cells >> k) cells per axis, the sizes GL gives the mip levels of
+// a cells³ texture, so the pyramid uploads as one mipmapped texture. Where that does not
+// divide the volume evenly, the last cell on each axis runs to the far side. `margin`
+// widens every range, for volumes the GPU samples in a lossy format (see
+// QuantizedVolume::MaximumError).
+const int macrocellSize = 8;
+const int macrocellLevels = 4;      // levels 0 to 3, as deep as the cloud shader's maxLod
+
+struct MacrocellLevel {
+    int cells = 0;
+    std::vector<float> minMax;      // interleaved (min, max), x fastest
+};
+
+class MacrocellGrid {
+public:
+    int size = 0;
+    std::vector<MacrocellLevel> levels;
+
+    static MacrocellGrid Build(const float* voxels, int size, float margin = 0.0f, ThreadPool& pool = ThreadPool::Shared());
+
+    static int Level(float lod);
+    void CellBounds(int level, int cell, int& begin, int& end) const;
+};
+
+// Base voxels [begin, end) that trilinear filtering of mip `mip` can read for positions in
+// the voxel range [low, high) of a size-voxel volume. Texel i of mip k averages base
+// voxels [i << k, (i + 1) << k); see BuildVolumeMips.
+void macrocellFootprint(int size, int mip, int low, int high, int& begin, int& end) {
+    int texels = std::max(size >> mip, 1);
+    float scale = (float)texels / size;
+
+    int first = std::clamp((int)std::floor(low * scale - 0.5f), 0, texels - 1),
+        last = std::clamp((int)std::floor(high * scale - 0.5f) + 1, 0, texels - 1);
+
+    begin = first << mip;
+    end = std::min((last + 1) << mip, size);
+}
+
+MacrocellGrid MacrocellGrid::Build(const float* voxels, int size, float margin, ThreadPool& pool) {
+    MacrocellGrid grid = MacrocellGrid();
+    grid.size = size;
+    grid.levels.resize(macrocellLevels);
+
+    int baseCells = (size + macrocellSize - 1) / macrocellSize;
+
+    for (int level = 0; level < macrocellLevels; level++) {
+        MacrocellLevel& pyramid = grid.levels[level];
+        int cells = std::max(baseCells >> level, 1);
+        pyramid.cells = cells;
+        pyramid.minMax.resize((size_t)cells * cells * cells * 2);
+
+        // The footprint of every cell along one axis; the same for all three
+        std::vector<int> begin(cells), end(cells);
+        for (int cell = 0; cell < cells; cell++) {
+            int low, high;
+            grid.CellBounds(level, cell, low, high);
+            macrocellFootprint(size, level, low, high, begin[cell], end[cell]);
+
+            if (level > 0) {
+                int coarserBegin, coarserEnd;
+                macrocellFootprint(size, level - 1, low, high, coarserBegin, coarserEnd);
+                begin[cell] = std::min(begin[cell], coarserBegin);
+                end[cell] = std::max(end[cell], coarserEnd);
+            }
+        }
+
+        pool.ParallelFor(0, cells, 1, [&](int zBegin, int zEnd) {
+            for (int cz = zBegin; cz < zEnd; cz++) {
+                for (int cy = 0; cy < cells; cy++) {
+                    for (int cx = 0; cx < cells; cx++) {
+
+                        float minimum = voxels[begin[cx] + (size_t)begin[cy] * size + (size_t)begin[cz] * size * size], maximum = minimum;
+                        for (int z = begin[cz]; z < end[cz]; z++) {
+                            for (int y = begin[cy]; y < end[cy]; y++) {
+                                const float* row = &voxels[(size_t)y * size + (size_t)z * size * size];
+                                for (int x = begin[cx]; x < end[cx]; x++) {
+                                    minimum = std::min(minimum, row[x]);
+                                    maximum = std::max(maximum, row[x]);
+                                }
+                            }
+                        }
+
+                        size_t cell = (size_t)cx + (size_t)cy * cells + (size_t)cz * cells * cells;
+                        pyramid.minMax[cell * 2 + 0] = minimum - margin;
+                        pyramid.minMax[cell * 2 + 1] = maximum + margin;
+                    }
+                }
+            }
+        });
+    }
+
+    return grid;
+}
+
+// The level the march reads at `lod`: the coarser of the two mips it blends
+int MacrocellGrid::Level(float lod) {
+    return std::clamp((int)std::ceil(lod), 0, macrocellLevels - 1);
+}
+
+// Voxels [begin, end) that cell `cell` of `level` spans along one axis
+void MacrocellGrid::CellBounds(int level, int cell, int& begin, int& end) const {
+    int span = macrocellSize << level;
+    begin = std::min(cell * span, size);
+    end = cell == levels[level].cells - 1 ? size : std::min((cell + 1) * span, size);
+}
+
+#endif /* macrocells_h */
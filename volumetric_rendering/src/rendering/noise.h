@@ -11,6 +11,8 @@
 #include <cmath>
 #include <cstdlib>
 #include <algorithm>
+#include <cstdint>
+#include <vector>
 
 
 int p[512] = {
@@ -42,6 +44,19 @@ int p[512] = {
     178,166,215,161,156,180
 };
 
+// Counter-based random numbers: the value only depends on (seed, counter), so any
+// thread can draw the n-th number of a stream without touching shared state
+uint32_t counterHash(uint64_t seed, uint64_t counter) {
+    uint64_t z = seed * 0x9E3779B97F4A7C15ull + counter + 0x632BE59BD9B4E019ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return (uint32_t)((z ^ (z >> 31)) >> 32);
+}
+
+float counterRandom(uint64_t seed, uint64_t counter) {
+    return (counterHash(seed, counter) >> 8) * (1.0f / 16777216.0f);
+}
+
 double fade(double t) {
     return t * t * t * (t * (t * 6 - 15) + 10);
 }
@@ -102,15 +117,7 @@ double noiseLayer(double x, double y, double lacunarity, double persistance, int
     return n;
 }
 
-float*** voronoi(float* samplePointsX, float* samplePointsY, float* samplePointsZ, int samplePointsLength, int scale) {
-
-    float*** voronoiMap = (float***)malloc(scale * sizeof(float**));
-    for (int i = 0; i < scale; ++i) {
-        voronoiMap[i] = (float**)malloc(scale * sizeof(float*));
-        for (int j = 0; j < scale; ++j) {
-            voronoiMap[i][j] = (float*)malloc(scale * sizeof(float));
-        }
-    }
+float voronoiMaxDistance(float* samplePointsX, float* samplePointsY, float* samplePointsZ, int samplePointsLength, int scale) {
 
     float globalMaxDist = 0.0f;
     for (int i = 0; i < samplePointsLength; i++) {
@@ -126,28 +133,166 @@ float*** voronoi(float* samplePointsX, float* samplePointsY, float* samplePoints
         if (dist > globalMaxDist) globalMaxDist = dist;
     }
 
+    return globalMaxDist;
+}
+
+float voronoiDistance(int x, int y, int z, float* samplePointsX, float* samplePointsY, float* samplePointsZ, int samplePointsLength, int scale) {
+
+    float minDist = 1e9;
+
+    for (int i = 0; i < samplePointsLength; i++) {
+        float sx = samplePointsX[i] * scale;
+        float sy = samplePointsY[i] * scale;
+        float sz = samplePointsZ[i] * scale;
+
+        float dx = x - sx, dy = y - sy, dz = z - sz;
+        float dist = sqrt(dx * dx + dy * dy + dz * dz);
+        if (dist < minDist) minDist = dist;
+    }
+
+    return minDist;
+}
+
+float*** voronoi(float* samplePointsX, float* samplePointsY, float* samplePointsZ, int samplePointsLength, int scale) {
+
+    float*** voronoiMap = (float***)malloc(scale * sizeof(float**));
+    for (int i = 0; i < scale; ++i) {
+        voronoiMap[i] = (float**)malloc(scale * sizeof(float*));
+        for (int j = 0; j < scale; ++j) {
+            voronoiMap[i][j] = (float*)malloc(scale * sizeof(float));
+        }
+    }
+
+    float globalMaxDist = voronoiMaxDistance(samplePointsX, samplePointsY, samplePointsZ, samplePointsLength, scale);
+
     for (int x = 0; x < scale; x++) {
         for (int y = 0; y < scale; y++) {
             for (int z = 0; z < scale; z++) {
+                voronoiMap[x][y][z] = voronoiDistance(x, y, z, samplePointsX, samplePointsY, samplePointsZ, samplePointsLength, scale) / globalMaxDist;
+            }
+        }
+    }
+
+    return voronoiMap;
+}
+
+// Cell-bucketed Worley noise. The volume is cut into cells³ cells holding pointsPerCell
+// feature points each, so a lookup visits the cells around the sample, nearest first,
+// instead of every feature point. The grid has to be whole, so Create rounds the
+// requested featurePoints to cells = round(cbrt(featurePoints / pointsPerCell)): 100
+// becomes 5³ = 125 points, 800 becomes 9³ = 729. With `periodic` the neighbours wrap
+// around and the result tiles; otherwise points outside the volume simply do not exist,
+// like voronoi().
+class WorleyGrid {
+public:
+    int cells, pointsPerCell, scale;
+    float cellSize, globalMaxDist;
+    bool periodic;
+
+    std::vector<float> pointsX, pointsY, pointsZ;
+
+    static WorleyGrid Create(int featurePoints, int pointsPerCell, int scale, uint64_t seed, bool periodic);
+    float Distance(float x, float y, float z);
+};
+
+WorleyGrid WorleyGrid::Create(int featurePoints, int pointsPerCell, int scale, uint64_t seed, bool periodic) {
+
+    WorleyGrid grid = WorleyGrid();
+
+    grid.pointsPerCell = std::max(pointsPerCell, 1);
+    grid.cells = std::max(1, (int)std::round(std::cbrt((float)featurePoints / grid.pointsPerCell)));
+    grid.scale = scale;
+    grid.cellSize = (float)scale / grid.cells;
+    grid.periodic = periodic;
+
+    int pointCount = grid.cells * grid.cells * grid.cells * grid.pointsPerCell;
+    grid.pointsX.resize(pointCount);
+    grid.pointsY.resize(pointCount);
+    grid.pointsZ.resize(pointCount);
 
-                float minDist = 1e9;
+    // Normalised [0, 1) coordinates, same convention as the voronoi() sample points
+    std::vector<float> normalisedX(pointCount), normalisedY(pointCount), normalisedZ(pointCount);
 
-                for (int i = 0; i < samplePointsLength; i++) {
-                    float sx = samplePointsX[i] * scale;
-                    float sy = samplePointsY[i] * scale;
-                    float sz = samplePointsZ[i] * scale;
+    for (int z = 0; z < grid.cells; z++) {
+        for (int y = 0; y < grid.cells; y++) {
+            for (int x = 0; x < grid.cells; x++) {
+                for (int k = 0; k < grid.pointsPerCell; k++) {
 
-                    float dx = x - sx, dy = y - sy, dz = z - sz;
-                    float dist = sqrt(dx * dx + dy * dy + dz * dz);
-                    if (dist < minDist) minDist = dist;
+                    int i = ((x + y * grid.cells + z * grid.cells * grid.cells) * grid.pointsPerCell) + k;
+
+                    normalisedX[i] = (x + counterRandom(seed, (uint64_t)i * 3 + 0)) / grid.cells;
+                    normalisedY[i] = (y + counterRandom(seed, (uint64_t)i * 3 + 1)) / grid.cells;
+                    normalisedZ[i] = (z + counterRandom(seed, (uint64_t)i * 3 + 2)) / grid.cells;
+
+                    grid.pointsX[i] = normalisedX[i] * scale;
+                    grid.pointsY[i] = normalisedY[i] * scale;
+                    grid.pointsZ[i] = normalisedZ[i] * scale;
                 }
+            }
+        }
+    }
+
+    // Normalise exactly like the brute-force version so the cloud density range is unchanged
+    grid.globalMaxDist = voronoiMaxDistance(normalisedX.data(), normalisedY.data(), normalisedZ.data(), pointCount, scale);
+
+    return grid;
+}
+
+// Distance in voxels from (x, y, z) to the closest feature point. Cells are searched
+// in rings around the query's own until every point of the next ring is provably
+// further than the closest one found. Usually that stops after the 27 neighbours, but
+// with a jittered grid the closest point can sit two or more cells away.
+float WorleyGrid::Distance(float x, float y, float z) {
 
-                voronoiMap[x][y][z] = minDist / globalMaxDist;
+    int cx = std::clamp((int)std::floor(x / cellSize), 0, cells - 1),
+        cy = std::clamp((int)std::floor(y / cellSize), 0, cells - 1),
+        cz = std::clamp((int)std::floor(z / cellSize), 0, cells - 1);
+
+    float minDist = 1e18f;
+
+    for (int ring = 0; ring <= cells; ring++) {
+
+        // Ring r lies outside the block of cells within r - 1 of the query's, so no closer
+        // than the query's distance to that block's nearest face
+        if (ring > 0) {
+            float reach = std::min({ x - (cx - ring + 1) * cellSize, (cx + ring) * cellSize - x,
+                                     y - (cy - ring + 1) * cellSize, (cy + ring) * cellSize - y,
+                                     z - (cz - ring + 1) * cellSize, (cz + ring) * cellSize - z });
+            if (reach > 0.0f && reach * reach >= minDist) break;
+        }
+
+        for (int dz = -ring; dz <= ring; dz++) {
+            for (int dy = -ring; dy <= ring; dy++) {
+                for (int dx = -ring; dx <= ring; dx++) {
+
+                    if (std::max({ std::abs(dx), std::abs(dy), std::abs(dz) }) != ring) continue;
+
+                    int nx = cx + dx, ny = cy + dy, nz = cz + dz;
+                    float ox = 0, oy = 0, oz = 0;
+
+                    if (periodic) {
+                        if (nx < 0) { nx += cells; ox = -(float)scale; } else if (nx >= cells) { nx -= cells; ox = (float)scale; }
+                        if (ny < 0) { ny += cells; oy = -(float)scale; } else if (ny >= cells) { ny -= cells; oy = (float)scale; }
+                        if (nz < 0) { nz += cells; oz = -(float)scale; } else if (nz >= cells) { nz -= cells; oz = (float)scale; }
+                    }
+                    else if (nx < 0 || ny < 0 || nz < 0 || nx >= cells || ny >= cells || nz >= cells) {
+                        continue;
+                    }
+
+                    int first = (nx + ny * cells + nz * cells * cells) * pointsPerCell;
+                    for (int k = first; k < first + pointsPerCell; k++) {
+                        float ddx = x - (pointsX[k] + ox),
+                              ddy = y - (pointsY[k] + oy),
+                              ddz = z - (pointsZ[k] + oz);
+
+                        minDist = std::min(minDist, ddx * ddx + ddy * ddy + ddz * ddz);
+                    }
+                }
             }
         }
     }
 
-    return voronoiMap;
+    return sqrt(minDist);
 }
 
 #endif /* noise_h */
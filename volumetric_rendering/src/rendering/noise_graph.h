@@ -0,0 +1,250 @@
+//
+//  noise_graph.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef noise_graph_h
+#define noise_graph_h
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Noise recipes as small expression trees. Every node is a value type with
+//
+//     void Evaluate(const NoiseBlock& block, float* out) const;
+//
+// which fills out[0, block.count) for a block of voxel coordinates, and composite nodes
+// hold their children by value. The whole graph is therefore one type, and evaluating
+// it on a block inlines into a single pass: intermediate results only ever live in
+// stack buffers of noiseBlockSize floats, never in a volume-sized array.
+//
+//     auto clouds = multiply(remap(fbm(frequency, 1.5f, 0.7f, offset, 20), -1.0f, 1.0f, 0.0f, 1.0f),
+//                            remap(worley(grid), 0.0f, 1.0f, 1.0f, 0.0f));
+//     std::vector<float> voxels = GenerateGraphVolume(clouds, 128);
+//
+// Fbm<Octaves> carries its octave count in the type and Fbm<dynamicOctaves> in the node.
+// That only makes the octave loop below a constant: the row and batch kernels of
+// noise_simd.h take the count at runtime, so neither form is faster than the other.
+const int noiseBlockSize = 256;
+const int dynamicOctaves = 0;
+
+// A run of voxels. When `row` is set they share y and z and step by one in x, which
+// lets fBm use the row kernels of noise_simd.h; a domain warp clears it.
+struct NoiseBlock {
+    const float* x;
+    const float* y;
+    const float* z;
+    int count;
+    bool row;
+};
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+// Perlin fBm as in noiseLayer: octave i samples at 2 * lacunarity^i times the voxel
+// position (offset, then scaled by frequency) with weight 2 * persistence^i
+template <int Octaves>
+struct Fbm {
+    float frequency, lacunarity, persistence, offset;
+    int octaves;
+
+    int OctaveCount() const { return Octaves != dynamicOctaves ? Octaves : octaves; }
+
+    void Evaluate(const NoiseBlock& block, float* out) const {
+        float x[noiseBlockSize];
+        for (int i = 0; i < block.count; i++) x[i] = (block.x[i] + offset) * frequency;
+
+        if (block.row) {
+            noiseLayerRow(x, (block.y[0] + offset) * frequency, (block.z[0] + offset) * frequency, lacunarity, persistence, OctaveCount(), out, block.count);
+            return;
+        }
+
+        float y[noiseBlockSize], z[noiseBlockSize], octave[noiseBlockSize];
+        for (int i = 0; i < block.count; i++) {
+            y[i] = (block.y[i] + offset) * frequency;
+            z[i] = (block.z[i] + offset) * frequency;
+            out[i] = 0.0f;
+        }
+
+        double freq = 2.0,
+               ampl = 2.0;
+
+        // Scaled in double inside the kernel: rounding x * freq to float would leave
+        // the high octaves of a large seed offset almost no fraction
+        for (int o = 0; o < OctaveCount(); o++) {
+            noiseBatchScaled(x, y, z, freq, octave, block.count);
+            for (int i = 0; i < block.count; i++) out[i] += octave[i] * (float)ampl;
+
+            freq *= lacunarity;
+            ampl *= persistence;
+        }
+    }
+};
+
+// Distance to the nearest feature point over WorleyGrid::globalMaxDist, so mostly [0, 1]
+struct Worley {
+    WorleyGrid* grid;
+
+    void Evaluate(const NoiseBlock& block, float* out) const {
+        for (int i = 0; i < block.count; i++) out[i] = grid->Distance(block.x[i], block.y[i], block.z[i]) / grid->globalMaxDist;
+    }
+};
+
+// Linear map of [inMinimum, inMaximum] onto [outMinimum, outMaximum], not clamped
+template <typename Source>
+struct Remap {
+    Source source;
+    float scale, bias;
+
+    void Evaluate(const NoiseBlock& block, float* out) const {
+        source.Evaluate(block, out);
+        for (int i = 0; i < block.count; i++) out[i] = out[i] * scale + bias;
+    }
+};
+
+template <typename A, typename B>
+struct Multiply {
+    A a;
+    B b;
+
+    void Evaluate(const NoiseBlock& block, float* out) const {
+        float other[noiseBlockSize];
+        a.Evaluate(block, out);
+        b.Evaluate(block, other);
+        for (int i = 0; i < block.count; i++) out[i] *= other[i];
+    }
+};
+
+// Evaluates `source` at the voxel position pushed `amplitude` voxels along a vector
+// field made of three decorrelated copies of `warp`
+template <typename Warp, typename Source>
+struct DomainWarp {
+    Warp warp;
+    float amplitude;
+    Source source;
+
+    void Evaluate(const NoiseBlock& block, float* out) const {
+        const float shifts[3] = { 0.0f, 131.7f, 271.3f };
+        float warped[3][noiseBlockSize], shifted[3][noiseBlockSize], displacement[noiseBlockSize];
+        const float* coordinates[3] = { block.x, block.y, block.z };
+
+        for (int axis = 0; axis < 3; axis++) {
+            for (int c = 0; c < 3; c++) {
+                for (int i = 0; i < block.count; i++) shifted[c][i] = coordinates[c][i] + shifts[axis];
+            }
+            warp.Evaluate({ shifted[0], shifted[1], shifted[2], block.count, block.row }, displacement);
+            for (int i = 0; i < block.count; i++) warped[axis][i] = coordinates[axis][i] + displacement[i] * amplitude;
+        }
+
+        source.Evaluate({ warped[0], warped[1], warped[2], block.count, false }, out);
+    }
+};
+
+// Evaluates `source` with every coordinate wrapped into [0, period), so a bounded node
+// such as a periodic Worley grid tiles the whole unbounded field
+template <typename Source>
+struct Tile {
+    Source source;
+    float period;
+
+    void Evaluate(const NoiseBlock& block, float* out) const {
+        float wrapped[3][noiseBlockSize];
+        const float* coordinates[3] = { block.x, block.y, block.z };
+
+        for (int c = 0; c < 3; c++) {
+            for (int i = 0; i < block.count; i++) wrapped[c][i] = coordinates[c][i] - std::floor(coordinates[c][i] / period) * period;
+        }
+        source.Evaluate({ wrapped[0], wrapped[1], wrapped[2], block.count, block.row }, out);
+    }
+};
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+template <int Octaves = dynamicOctaves>
+Fbm<Octaves> fbm(float frequency, float lacunarity, float persistence, float offset, int octaves = Octaves) {
+    return Fbm<Octaves> { frequency, lacunarity, persistence, offset, octaves };
+}
+
+inline Worley worley(WorleyGrid& grid) {
+    return Worley { &grid };
+}
+
+template <typename Source>
+Remap<Source> remap(Source source, float inMinimum, float inMaximum, float outMinimum, float outMaximum) {
+    float scale = (outMaximum - outMinimum) / (inMaximum - inMinimum);
+    return Remap<Source> { source, scale, outMinimum - inMinimum * scale };
+}
+
+template <typename A, typename B>
+Multiply<A, B> multiply(A a, B b) {
+    return Multiply<A, B> { a, b };
+}
+
+template <typename Warp, typename Source>
+DomainWarp<Warp, Source> domainWarp(Warp warp, float amplitude, Source source) {
+    return DomainWarp<Warp, Source> { warp, amplitude, source };
+}
+
+template <typename Source>
+Tile<Source> tile(Source source, float period) {
+    return Tile<Source> { source, period };
+}
+
+// Voxel of the unbounded field held by texel `texel` of a toroidal window of `size`
+// voxels starting at voxel `origin`: the one in [origin, origin + size) congruent to
+// the texel modulo size
+inline int windowVoxel(int texel, int origin, int size) {
+    return origin + ((texel - origin) % size + size) % size;
+}
+
+// Evaluates `graph` over the box of texels [begin, begin + extent) of a toroidal size³
+// window whose first voxel is `origin`, into `out` laid out x fastest over the box. Rows
+// along x keep a shared y and z even where the x coordinates wrap, so fBm still takes
+// the row kernels. Rows are spread over the pool; like GenerateNoiseVolume the result
+// does not depend on the number of threads.
+template <typename Graph>
+void GenerateGraphWindow(const Graph& graph, int size, const int origin[3], const int begin[3], const int extent[3], float* out, ThreadPool& pool = ThreadPool::Shared()) {
+
+    int rows = extent[1] * extent[2];
+
+    pool.ParallelFor(0, rows, std::max(1, rows / (pool.ThreadCount() * 4)), [&](int rowBegin, int rowEnd) {
+
+        float x[noiseBlockSize], y[noiseBlockSize], z[noiseBlockSize];
+
+        for (int row = rowBegin; row < rowEnd; row++) {
+            float voxelY = (float)windowVoxel(begin[1] + row % extent[1], origin[1], size),
+                  voxelZ = (float)windowVoxel(begin[2] + row / extent[1], origin[2], size);
+
+            for (int first = 0; first < extent[0]; first += noiseBlockSize) {
+
+                int count = std::min(noiseBlockSize, extent[0] - first);
+                for (int i = 0; i < count; i++) {
+                    x[i] = (float)windowVoxel(begin[0] + first + i, origin[0], size);
+                    y[i] = voxelY;
+                    z[i] = voxelZ;
+                }
+
+                graph.Evaluate({ x, y, z, count, true }, &out[(size_t)first + (size_t)row * extent[0]]);
+            }
+        }
+    });
+}
+
+// Evaluates `graph` over a size³ volume laid out as x + y * size + z * size * size, the
+// window at the origin of the field
+template <typename Graph>
+std::vector<float> GenerateGraphVolume(const Graph& graph, int size, ThreadPool& pool = ThreadPool::Shared()) {
+
+    std::vector<float> voxels((size_t)size * size * size);
+
+    const int origin[3] = { 0, 0, 0 }, extent[3] = { size, size, size };
+    GenerateGraphWindow(graph, size, origin, origin, extent, voxels.data(), pool);
+
+    return voxels;
+}
+
+#endif /* noise_graph_h */
@@ -0,0 +1,567 @@
+//
+//  noise_simd.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef noise_simd_h
+#define noise_simd_h
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NOISE_SIMD_X86 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NOISE_SIMD_NEON 1
+#endif
+
+// Float batch versions of noise() and noiseLayer(). They use the same permutation
+// table and gradient set, and match the double reference to within float rounding.
+//
+//   noiseBatch        - n arbitrary points
+//   noiseBatchScaled  - noiseBatch at the points times a common scale, for the octaves
+//                       of an fBm over arbitrary points
+//   noiseLayerRow     - noiseLayer() over a row of x coordinates sharing y and z, all
+//                       octaves at once
+//
+// Scaled and lattice coordinates are split in double before going to float, so large
+// seeds keep their precision.
+//
+// The widest kernel the CPU supports is picked on first use (AVX2, SSE2, NEON on arm64,
+// or the portable loop).
+
+// ----- Scalar float reference, also used for the tails ----- //
+
+float gradientFloat(int hash, float x, float y, float z) {
+    int h = hash & 15;
+    float u = h < 8 ? x : y;
+    float v = h < 4 ? y : (h & 13) == 12 ? x : z;
+
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+float noiseFloat(int X, int Y, int Z, float x, float y, float z) {
+
+    float u = x * x * x * (x * (x * 6 - 15) + 10),
+          v = y * y * y * (y * (y * 6 - 15) + 10),
+          w = z * z * z * (z * (z * 6 - 15) + 10);
+
+    int A = p[X] + Y, AA = p[A] + Z, AB = p[A + 1] + Z,
+        B = p[X + 1] + Y, BA = p[B] + Z, BB = p[B + 1] + Z;
+
+    float g000 = gradientFloat(p[AA],     x,     y,     z),
+          g100 = gradientFloat(p[BA],     x - 1, y,     z),
+          g010 = gradientFloat(p[AB],     x,     y - 1, z),
+          g110 = gradientFloat(p[BB],     x - 1, y - 1, z),
+          g001 = gradientFloat(p[AA + 1], x,     y,     z - 1),
+          g101 = gradientFloat(p[BA + 1], x - 1, y,     z - 1),
+          g011 = gradientFloat(p[AB + 1], x,     y - 1, z - 1),
+          g111 = gradientFloat(p[BB + 1], x - 1, y - 1, z - 1);
+
+    float x00 = g000 + u * (g100 - g000),
+          x10 = g010 + u * (g110 - g010),
+          x01 = g001 + u * (g101 - g001),
+          x11 = g011 + u * (g111 - g011);
+
+    float y0 = x00 + v * (x10 - x00),
+          y1 = x01 + v * (x11 - x01);
+
+    return y0 + w * (y1 - y0);
+}
+
+// Splits a coordinate into its lattice cell and fraction, like noise() does
+void noiseSplit(double coordinate, int& cell, float& fraction) {
+    double f = floor(coordinate);
+    cell = (int)f & 255;
+    fraction = (float)(coordinate - f);
+}
+
+// ----- Portable fallback, for CPUs without one of the SIMD paths ----- //
+
+void noiseBatchScaledGeneric(const float* x, const float* y, const float* z, double scale, float* out, int count) {
+    for (int i = 0; i < count; i++) {
+        int X, Y, Z;
+        float fx, fy, fz;
+        noiseSplit(x[i] * scale, X, fx);
+        noiseSplit(y[i] * scale, Y, fy);
+        noiseSplit(z[i] * scale, Z, fz);
+        out[i] = noiseFloat(X, Y, Z, fx, fy, fz);
+    }
+}
+
+void noiseBatchGeneric(const float* x, const float* y, const float* z, float* out, int count) {
+    noiseBatchScaledGeneric(x, y, z, 1.0, out, count);
+}
+
+void noiseLayerRowGeneric(const float* x, double y, double z, double lacunarity, double persistance, int octaves, float* out, int count) {
+
+    for (int i = 0; i < count; i++) out[i] = 0.0f;
+
+    double freq = 2.0,
+           ampl = 2.0;
+
+    for (int o = 0; o < octaves; o++) {
+        int Y, Z;
+        float fy, fz;
+        noiseSplit(y * freq, Y, fy);
+        noiseSplit(z * freq, Z, fz);
+
+        for (int i = 0; i < count; i++) {
+            int X;
+            float fx;
+            noiseSplit(x[i] * freq, X, fx);
+            out[i] += noiseFloat(X, Y, Z, fx, fy, fz) * (float)ampl;
+        }
+        freq *= lacunarity;
+        ampl *= persistance;
+    }
+}
+
+#if NOISE_SIMD_X86
+
+// ----- SSE2, 4 lanes ----- //
+
+__m128 selectSSE2(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+__m128i gatherSSE2(__m128i index) {
+    alignas(16) int lanes[4];
+    _mm_store_si128((__m128i*)lanes, index);
+    return _mm_set_epi32(p[lanes[3]], p[lanes[2]], p[lanes[1]], p[lanes[0]]);
+}
+
+__m128 gradientSSE2(__m128i hash, __m128 x, __m128 y, __m128 z) {
+    __m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+
+    __m128 below8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8))),
+           below4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4))),
+           is12or14 = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(13)), _mm_set1_epi32(12)));
+
+    __m128 u = selectSSE2(below8, x, y),
+           v = selectSSE2(below4, y, selectSSE2(is12or14, x, z));
+
+    u = _mm_xor_ps(u, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), 31)));
+    v = _mm_xor_ps(v, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30)));
+
+    return _mm_add_ps(u, v);
+}
+
+__m128 lerpSSE2(__m128 t, __m128 a, __m128 b) {
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+__m128 fadeSSE2(__m128 t) {
+    __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+__m128 noiseSSE2(__m128i X, __m128i Y, __m128i Z, __m128 x, __m128 y, __m128 z) {
+
+    __m128i one = _mm_set1_epi32(1);
+
+    __m128i A = _mm_add_epi32(gatherSSE2(X), Y),
+            AA = _mm_add_epi32(gatherSSE2(A), Z),
+            AB = _mm_add_epi32(gatherSSE2(_mm_add_epi32(A, one)), Z),
+            B = _mm_add_epi32(gatherSSE2(_mm_add_epi32(X, one)), Y),
+            BA = _mm_add_epi32(gatherSSE2(B), Z),
+            BB = _mm_add_epi32(gatherSSE2(_mm_add_epi32(B, one)), Z);
+
+    __m128 u = fadeSSE2(x), v = fadeSSE2(y), w = fadeSSE2(z);
+    __m128 x1 = _mm_sub_ps(x, _mm_set1_ps(1.0f)),
+           y1 = _mm_sub_ps(y, _mm_set1_ps(1.0f)),
+           z1 = _mm_sub_ps(z, _mm_set1_ps(1.0f));
+
+    __m128 y0 = lerpSSE2(v, lerpSSE2(u, gradientSSE2(gatherSSE2(AA), x, y, z),  gradientSSE2(gatherSSE2(BA), x1, y, z)),
+                            lerpSSE2(u, gradientSSE2(gatherSSE2(AB), x, y1, z), gradientSSE2(gatherSSE2(BB), x1, y1, z)));
+    __m128 y1v = lerpSSE2(v, lerpSSE2(u, gradientSSE2(gatherSSE2(_mm_add_epi32(AA, one)), x, y, z1),  gradientSSE2(gatherSSE2(_mm_add_epi32(BA, one)), x1, y, z1)),
+                             lerpSSE2(u, gradientSSE2(gatherSSE2(_mm_add_epi32(AB, one)), x, y1, z1), gradientSSE2(gatherSSE2(_mm_add_epi32(BB, one)), x1, y1, z1)));
+
+    return lerpSSE2(w, y0, y1v);
+}
+
+void noiseBatchScaledSSE2(const float* x, const float* y, const float* z, double scale, float* out, int count) {
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        alignas(16) int X[4], Y[4], Z[4];
+        alignas(16) float fx[4], fy[4], fz[4];
+        for (int l = 0; l < 4; l++) {
+            noiseSplit(x[i + l] * scale, X[l], fx[l]);
+            noiseSplit(y[i + l] * scale, Y[l], fy[l]);
+            noiseSplit(z[i + l] * scale, Z[l], fz[l]);
+        }
+        _mm_storeu_ps(out + i, noiseSSE2(_mm_load_si128((__m128i*)X), _mm_load_si128((__m128i*)Y), _mm_load_si128((__m128i*)Z),
+                                         _mm_load_ps(fx), _mm_load_ps(fy), _mm_load_ps(fz)));
+    }
+    noiseBatchScaledGeneric(x + i, y + i, z + i, scale, out + i, count - i);
+}
+
+void noiseBatchSSE2(const float* x, const float* y, const float* z, float* out, int count) {
+    noiseBatchScaledSSE2(x, y, z, 1.0, out, count);
+}
+
+void noiseLayerRowSSE2(const float* x, double y, double z, double lacunarity, double persistance, int octaves, float* out, int count) {
+
+    int vectorCount = count & ~3;
+    for (int i = 0; i < count; i++) out[i] = 0.0f;
+
+    double freq = 2.0,
+           ampl = 2.0;
+
+    for (int o = 0; o < octaves; o++) {
+        int Y, Z;
+        float fy, fz;
+        noiseSplit(y * freq, Y, fy);
+        noiseSplit(z * freq, Z, fz);
+
+        __m128i cellY = _mm_set1_epi32(Y), cellZ = _mm_set1_epi32(Z);
+        __m128 fractionY = _mm_set1_ps(fy), fractionZ = _mm_set1_ps(fz), amplitude = _mm_set1_ps((float)ampl);
+
+        for (int i = 0; i < vectorCount; i += 4) {
+            alignas(16) int X[4];
+            alignas(16) float fx[4];
+            for (int l = 0; l < 4; l++) noiseSplit(x[i + l] * freq, X[l], fx[l]);
+
+            __m128 n = noiseSSE2(_mm_load_si128((__m128i*)X), cellY, cellZ, _mm_load_ps(fx), fractionY, fractionZ);
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(n, amplitude)));
+        }
+        for (int i = vectorCount; i < count; i++) {
+            int X;
+            float fx;
+            noiseSplit(x[i] * freq, X, fx);
+            out[i] += noiseFloat(X, Y, Z, fx, fy, fz) * (float)ampl;
+        }
+        freq *= lacunarity;
+        ampl *= persistance;
+    }
+}
+
+// ----- AVX2 + FMA, 8 lanes ----- //
+
+#define NOISE_AVX2 __attribute__((target("avx2,fma")))
+
+NOISE_AVX2 __m256i gatherAVX2(__m256i index) {
+    return _mm256_i32gather_epi32(p, index, 4);
+}
+
+NOISE_AVX2 __m256 gradientAVX2(__m256i hash, __m256 x, __m256 y, __m256 z) {
+    __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+
+    __m256 below8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h)),
+           below4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h)),
+           is12or14 = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(h, _mm256_set1_epi32(13)), _mm256_set1_epi32(12)));
+
+    __m256 u = _mm256_blendv_ps(y, x, below8),
+           v = _mm256_blendv_ps(_mm256_blendv_ps(z, x, is12or14), y, below4);
+
+    u = _mm256_xor_ps(u, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1)), 31)));
+    v = _mm256_xor_ps(v, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30)));
+
+    return _mm256_add_ps(u, v);
+}
+
+NOISE_AVX2 __m256 lerpAVX2(__m256 t, __m256 a, __m256 b) {
+    return _mm256_fmadd_ps(t, _mm256_sub_ps(b, a), a);
+}
+
+NOISE_AVX2 __m256 fadeAVX2(__m256 t) {
+    __m256 inner = _mm256_fmadd_ps(t, _mm256_fmsub_ps(t, _mm256_set1_ps(6.0f), _mm256_set1_ps(15.0f)), _mm256_set1_ps(10.0f));
+    return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+}
+
+NOISE_AVX2 __m256 noiseAVX2(__m256i X, __m256i Y, __m256i Z, __m256 x, __m256 y, __m256 z) {
+
+    __m256i one = _mm256_set1_epi32(1);
+
+    __m256i A = _mm256_add_epi32(gatherAVX2(X), Y),
+            AA = _mm256_add_epi32(gatherAVX2(A), Z),
+            AB = _mm256_add_epi32(gatherAVX2(_mm256_add_epi32(A, one)), Z),
+            B = _mm256_add_epi32(gatherAVX2(_mm256_add_epi32(X, one)), Y),
+            BA = _mm256_add_epi32(gatherAVX2(B), Z),
+            BB = _mm256_add_epi32(gatherAVX2(_mm256_add_epi32(B, one)), Z);
+
+    __m256 u = fadeAVX2(x), v = fadeAVX2(y), w = fadeAVX2(z);
+    __m256 x1 = _mm256_sub_ps(x, _mm256_set1_ps(1.0f)),
+           y1 = _mm256_sub_ps(y, _mm256_set1_ps(1.0f)),
+           z1 = _mm256_sub_ps(z, _mm256_set1_ps(1.0f));
+
+    __m256 y0 = lerpAVX2(v, lerpAVX2(u, gradientAVX2(gatherAVX2(AA), x, y, z),  gradientAVX2(gatherAVX2(BA), x1, y, z)),
+                            lerpAVX2(u, gradientAVX2(gatherAVX2(AB), x, y1, z), gradientAVX2(gatherAVX2(BB), x1, y1, z)));
+    __m256 y1v = lerpAVX2(v, lerpAVX2(u, gradientAVX2(gatherAVX2(_mm256_add_epi32(AA, one)), x, y, z1),  gradientAVX2(gatherAVX2(_mm256_add_epi32(BA, one)), x1, y, z1)),
+                             lerpAVX2(u, gradientAVX2(gatherAVX2(_mm256_add_epi32(AB, one)), x, y1, z1), gradientAVX2(gatherAVX2(_mm256_add_epi32(BB, one)), x1, y1, z1)));
+
+    return lerpAVX2(w, y0, y1v);
+}
+
+// Lattice split of 8 lanes, done in double so large coordinates keep their fraction
+NOISE_AVX2 void splitAVX2(__m256d low, __m256d high, __m256i& cell, __m256& fraction) {
+    __m256d lowFloor = _mm256_floor_pd(low),
+            highFloor = _mm256_floor_pd(high);
+
+    __m128i lowCell = _mm256_cvttpd_epi32(lowFloor),
+            highCell = _mm256_cvttpd_epi32(highFloor);
+    cell = _mm256_and_si256(_mm256_set_m128i(highCell, lowCell), _mm256_set1_epi32(255));
+
+    __m128 lowFraction = _mm256_cvtpd_ps(_mm256_sub_pd(low, lowFloor)),
+           highFraction = _mm256_cvtpd_ps(_mm256_sub_pd(high, highFloor));
+    fraction = _mm256_set_m128(highFraction, lowFraction);
+}
+
+// Widens 8 floats to double and scales them there, for splitAVX2
+NOISE_AVX2 void scaleAVX2(const float* values, __m256d scale, __m256d& low, __m256d& high) {
+    low = _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(values)), scale);
+    high = _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(values + 4)), scale);
+}
+
+NOISE_AVX2 void noiseBatchScaledAVX2(const float* x, const float* y, const float* z, double scale, float* out, int count) {
+
+    __m256d factor = _mm256_set1_pd(scale);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i X, Y, Z;
+        __m256 fx, fy, fz;
+        __m256d low, high;
+        scaleAVX2(x + i, factor, low, high);
+        splitAVX2(low, high, X, fx);
+        scaleAVX2(y + i, factor, low, high);
+        splitAVX2(low, high, Y, fy);
+        scaleAVX2(z + i, factor, low, high);
+        splitAVX2(low, high, Z, fz);
+
+        _mm256_storeu_ps(out + i, noiseAVX2(X, Y, Z, fx, fy, fz));
+    }
+    noiseBatchScaledGeneric(x + i, y + i, z + i, scale, out + i, count - i);
+}
+
+NOISE_AVX2 void noiseBatchAVX2(const float* x, const float* y, const float* z, float* out, int count) {
+    noiseBatchScaledAVX2(x, y, z, 1.0, out, count);
+}
+
+NOISE_AVX2 void noiseLayerRowAVX2(const float* x, double y, double z, double lacunarity, double persistance, int octaves, float* out, int count) {
+
+    int vectorCount = count & ~7;
+    for (int i = 0; i < count; i++) out[i] = 0.0f;
+
+    double freq = 2.0,
+           ampl = 2.0;
+
+    for (int o = 0; o < octaves; o++) {
+        int Y, Z;
+        float fy, fz;
+        noiseSplit(y * freq, Y, fy);
+        noiseSplit(z * freq, Z, fz);
+
+        __m256i cellY = _mm256_set1_epi32(Y), cellZ = _mm256_set1_epi32(Z);
+        __m256 fractionY = _mm256_set1_ps(fy), fractionZ = _mm256_set1_ps(fz), amplitude = _mm256_set1_ps((float)ampl);
+        __m256d frequency = _mm256_set1_pd(freq);
+
+        for (int i = 0; i < vectorCount; i += 8) {
+            __m256i X;
+            __m256 fx;
+            splitAVX2(_mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(x + i)), frequency),
+                      _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(x + i + 4)), frequency), X, fx);
+
+            __m256 n = noiseAVX2(X, cellY, cellZ, fx, fractionY, fractionZ);
+            _mm256_storeu_ps(out + i, _mm256_fmadd_ps(n, amplitude, _mm256_loadu_ps(out + i)));
+        }
+        for (int i = vectorCount; i < count; i++) {
+            int X;
+            float fx;
+            noiseSplit(x[i] * freq, X, fx);
+            out[i] += noiseFloat(X, Y, Z, fx, fy, fz) * (float)ampl;
+        }
+        freq *= lacunarity;
+        ampl *= persistance;
+    }
+}
+
+#endif /* NOISE_SIMD_X86 */
+
+#if NOISE_SIMD_NEON
+
+// ----- NEON, 4 lanes (AArch64, where it is always present) ----- //
+
+int32x4_t gatherNEON(int32x4_t index) {
+    alignas(16) int lanes[4];
+    vst1q_s32(lanes, index);
+    for (int l = 0; l < 4; l++) lanes[l] = p[lanes[l]];
+    return vld1q_s32(lanes);
+}
+
+float32x4_t gradientNEON(int32x4_t hash, float32x4_t x, float32x4_t y, float32x4_t z) {
+    int32x4_t h = vandq_s32(hash, vdupq_n_s32(15));
+
+    uint32x4_t below8 = vcltq_s32(h, vdupq_n_s32(8)),
+               below4 = vcltq_s32(h, vdupq_n_s32(4)),
+               is12or14 = vceqq_s32(vandq_s32(h, vdupq_n_s32(13)), vdupq_n_s32(12));
+
+    float32x4_t u = vbslq_f32(below8, x, y),
+                v = vbslq_f32(below4, y, vbslq_f32(is12or14, x, z));
+
+    uint32x4_t signU = vshlq_n_u32(vreinterpretq_u32_s32(vandq_s32(h, vdupq_n_s32(1))), 31),
+               signV = vshlq_n_u32(vreinterpretq_u32_s32(vandq_s32(h, vdupq_n_s32(2))), 30);
+    u = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(u), signU));
+    v = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(v), signV));
+
+    return vaddq_f32(u, v);
+}
+
+float32x4_t lerpNEON(float32x4_t t, float32x4_t a, float32x4_t b) {
+    return vfmaq_f32(a, t, vsubq_f32(b, a));
+}
+
+float32x4_t fadeNEON(float32x4_t t) {
+    float32x4_t inner = vfmaq_f32(vdupq_n_f32(10.0f), t, vfmaq_f32(vdupq_n_f32(-15.0f), t, vdupq_n_f32(6.0f)));
+    return vmulq_f32(vmulq_f32(vmulq_f32(t, t), t), inner);
+}
+
+float32x4_t noiseNEON(int32x4_t X, int32x4_t Y, int32x4_t Z, float32x4_t x, float32x4_t y, float32x4_t z) {
+
+    int32x4_t one = vdupq_n_s32(1);
+
+    int32x4_t A = vaddq_s32(gatherNEON(X), Y),
+              AA = vaddq_s32(gatherNEON(A), Z),
+              AB = vaddq_s32(gatherNEON(vaddq_s32(A, one)), Z),
+              B = vaddq_s32(gatherNEON(vaddq_s32(X, one)), Y),
+              BA = vaddq_s32(gatherNEON(B), Z),
+              BB = vaddq_s32(gatherNEON(vaddq_s32(B, one)), Z);
+
+    float32x4_t u = fadeNEON(x), v = fadeNEON(y), w = fadeNEON(z);
+    float32x4_t x1 = vsubq_f32(x, vdupq_n_f32(1.0f)),
+                y1 = vsubq_f32(y, vdupq_n_f32(1.0f)),
+                z1 = vsubq_f32(z, vdupq_n_f32(1.0f));
+
+    float32x4_t y0 = lerpNEON(v, lerpNEON(u, gradientNEON(gatherNEON(AA), x, y, z),  gradientNEON(gatherNEON(BA), x1, y, z)),
+                                 lerpNEON(u, gradientNEON(gatherNEON(AB), x, y1, z), gradientNEON(gatherNEON(BB), x1, y1, z)));
+    float32x4_t y1v = lerpNEON(v, lerpNEON(u, gradientNEON(gatherNEON(vaddq_s32(AA, one)), x, y, z1),  gradientNEON(gatherNEON(vaddq_s32(BA, one)), x1, y, z1)),
+                                  lerpNEON(u, gradientNEON(gatherNEON(vaddq_s32(AB, one)), x, y1, z1), gradientNEON(gatherNEON(vaddq_s32(BB, one)), x1, y1, z1)));
+
+    return lerpNEON(w, y0, y1v);
+}
+
+// Lattice split of 4 lanes, scaled and floored in double so large coordinates keep their fraction
+void splitNEON(const float* values, float64x2_t scale, int32x4_t& cell, float32x4_t& fraction) {
+    float32x4_t lanes = vld1q_f32(values);
+    float64x2_t low = vmulq_f64(vcvt_f64_f32(vget_low_f32(lanes)), scale),
+                high = vmulq_f64(vcvt_high_f64_f32(lanes), scale);
+    float64x2_t lowFloor = vrndmq_f64(low),
+                highFloor = vrndmq_f64(high);
+
+    int32x4_t cells = vcombine_s32(vmovn_s64(vcvtq_s64_f64(lowFloor)), vmovn_s64(vcvtq_s64_f64(highFloor)));
+    cell = vandq_s32(cells, vdupq_n_s32(255));
+    fraction = vcvt_high_f32_f64(vcvt_f32_f64(vsubq_f64(low, lowFloor)), vsubq_f64(high, highFloor));
+}
+
+void noiseBatchScaledNEON(const float* x, const float* y, const float* z, double scale, float* out, int count) {
+
+    float64x2_t factor = vdupq_n_f64(scale);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int32x4_t X, Y, Z;
+        float32x4_t fx, fy, fz;
+        splitNEON(x + i, factor, X, fx);
+        splitNEON(y + i, factor, Y, fy);
+        splitNEON(z + i, factor, Z, fz);
+
+        vst1q_f32(out + i, noiseNEON(X, Y, Z, fx, fy, fz));
+    }
+    noiseBatchScaledGeneric(x + i, y + i, z + i, scale, out + i, count - i);
+}
+
+void noiseBatchNEON(const float* x, const float* y, const float* z, float* out, int count) {
+    noiseBatchScaledNEON(x, y, z, 1.0, out, count);
+}
+
+void noiseLayerRowNEON(const float* x, double y, double z, double lacunarity, double persistance, int octaves, float* out, int count) {
+
+    int vectorCount = count & ~3;
+    for (int i = 0; i < count; i++) out[i] = 0.0f;
+
+    double freq = 2.0,
+           ampl = 2.0;
+
+    for (int o = 0; o < octaves; o++) {
+        int Y, Z;
+        float fy, fz;
+        noiseSplit(y * freq, Y, fy);
+        noiseSplit(z * freq, Z, fz);
+
+        int32x4_t cellY = vdupq_n_s32(Y), cellZ = vdupq_n_s32(Z);
+        float32x4_t fractionY = vdupq_n_f32(fy), fractionZ = vdupq_n_f32(fz), amplitude = vdupq_n_f32((float)ampl);
+        float64x2_t frequency = vdupq_n_f64(freq);
+
+        for (int i = 0; i < vectorCount; i += 4) {
+            int32x4_t X;
+            float32x4_t fx;
+            splitNEON(x + i, frequency, X, fx);
+
+            float32x4_t n = noiseNEON(X, cellY, cellZ, fx, fractionY, fractionZ);
+            vst1q_f32(out + i, vfmaq_f32(vld1q_f32(out + i), n, amplitude));
+        }
+        for (int i = vectorCount; i < count; i++) {
+            int X;
+            float fx;
+            noiseSplit(x[i] * freq, X, fx);
+            out[i] += noiseFloat(X, Y, Z, fx, fy, fz) * (float)ampl;
+        }
+        freq *= lacunarity;
+        ampl *= persistance;
+    }
+}
+
+#endif /* NOISE_SIMD_NEON */
+
+// ----- Runtime dispatch ----- //
+
+struct NoiseKernels {
+    const char* name;
+    int width;
+    void (*batch)(const float*, const float*, const float*, float*, int);
+    void (*batchScaled)(const float*, const float*, const float*, double, float*, int);
+    void (*layerRow)(const float*, double, double, double, double, int, float*, int);
+};
+
+// Every kernel set this CPU can run, widest first
+std::vector<NoiseKernels> availableNoiseKernels() {
+    std::vector<NoiseKernels> kernels;
+#if NOISE_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        kernels.push_back(NoiseKernels { "avx2", 8, noiseBatchAVX2, noiseBatchScaledAVX2, noiseLayerRowAVX2 });
+    kernels.push_back(NoiseKernels { "sse2", 4, noiseBatchSSE2, noiseBatchScaledSSE2, noiseLayerRowSSE2 });
+#endif
+#if NOISE_SIMD_NEON
+    kernels.push_back(NoiseKernels { "neon", 4, noiseBatchNEON, noiseBatchScaledNEON, noiseLayerRowNEON });
+#endif
+    kernels.push_back(NoiseKernels { "generic", 1, noiseBatchGeneric, noiseBatchScaledGeneric, noiseLayerRowGeneric });
+    return kernels;
+}
+
+NoiseKernels& noiseKernels() {
+    static NoiseKernels kernels = availableNoiseKernels().front();
+    return kernels;
+}
+
+void noiseBatch(const float* x, const float* y, const float* z, float* out, int count) {
+    noiseKernels().batch(x, y, z, out, count);
+}
+
+// out[i] = noise(x[i] * scale, y[i] * scale, z[i] * scale), the product taken in double
+void noiseBatchScaled(const float* x, const float* y, const float* z, double scale, float* out, int count) {
+    noiseKernels().batchScaled(x, y, z, scale, out, count);
+}
+
+// out[i] = noiseLayer(x[i], y, lacunarity, persistance, octaves, z)
+void noiseLayerRow(const float* x, double y, double z, double lacunarity, double persistance, int octaves, float* out, int count) {
+    noiseKernels().layerRow(x, y, z, lacunarity, persistance, octaves, out, count);
+}
+
+#endif /* noise_simd_h */
@@ -0,0 +1,232 @@
+//
+//  noise_volume.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef noise_volume_h
+#define noise_volume_h
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+struct NoiseParameters {
+    int size = 128;
+    uint32_t seed = 0;
+
+    float frequency = 0.00421f;
+    float lacunarity = 1.5f;
+    float persistence = 0.7f;
+    int octaves = 20;
+
+    int featurePoints = 100;    // rounded to a whole Worley grid, 5³ = 125 points (WorleyGrid)
+    int worleyPointsPerCell = 1;
+    bool worleyPeriodic = false;
+
+    float warp = 0.0f;          // domain warp of the whole recipe, in voxels; 0 for none
+};
+
+// Bump whenever GenerateNoiseVolume changes its output, so cached volumes are regenerated
+const uint32_t noiseGeneratorVersion = 3;
+
+// Fixed-layout copy of the parameters for cache keys and headers (no padding bytes)
+struct NoiseCacheParameters {
+    uint32_t generatorVersion, size, seed;
+    float frequency, lacunarity, persistence;
+    int32_t octaves, featurePoints, worleyPointsPerCell, worleyPeriodic;
+    float warp;
+};
+
+NoiseCacheParameters noiseCacheParameters(const NoiseParameters& parameters) {
+    NoiseCacheParameters cacheParameters = {
+        noiseGeneratorVersion, (uint32_t)parameters.size, parameters.seed,
+        parameters.frequency, parameters.lacunarity, parameters.persistence,
+        parameters.octaves, parameters.featurePoints, parameters.worleyPointsPerCell, parameters.worleyPeriodic ? 1 : 0,
+        parameters.warp
+    };
+    return cacheParameters;
+}
+
+// Fills a size³ density volume laid out as x + y * size + z * size * size: fBm brought
+// into [0, 1] times inverted Worley distance, optionally domain-warped. Every voxel only
+// depends on the parameters, so the result is bit-identical no matter how many threads
+// generate it.
+std::vector<float> GenerateNoiseVolume(const NoiseParameters& parameters, ThreadPool& pool = ThreadPool::Shared()) {
+
+    int size = parameters.size;
+    float seed = counterHash(parameters.seed, 0) % 10000000;
+
+    // Counter 0 of the base stream is the offset above, the feature points get a stream of their own
+    uint64_t worleySeed = ((uint64_t)1 << 32) | parameters.seed;
+    WorleyGrid grid = WorleyGrid::Create(parameters.featurePoints, parameters.worleyPointsPerCell, size, worleySeed, parameters.worleyPeriodic);
+
+    auto clouds = multiply(remap(fbm(parameters.frequency, parameters.lacunarity, parameters.persistence, seed, parameters.octaves), -1.0f, 1.0f, 0.0f, 1.0f),
+                           remap(worley(grid), 0.0f, 1.0f, 1.0f, 0.0f));
+
+    if (parameters.warp == 0.0f) return GenerateGraphVolume(clouds, size, pool);
+
+    auto warp = fbm<4>(parameters.frequency * 4.0f, 2.0f, 0.5f, seed + 57.0f);
+    return GenerateGraphVolume(domainWarp(warp, parameters.warp, clouds), size, pool);
+}
+
+// The clouds of GenerateNoiseVolume as an unbounded field, for WindVolume: fBm simply
+// continues past the volume and the Worley grid is periodic and tiles every size voxels.
+// Fills the texels [begin, begin + extent) of the toroidal window that starts at voxel
+// `origin`, see GenerateGraphWindow.
+void GenerateNoiseWindow(const NoiseParameters& parameters, const int origin[3], const int begin[3], const int extent[3], float* out, ThreadPool& pool = ThreadPool::Shared()) {
+
+    int size = parameters.size;
+    float seed = counterHash(parameters.seed, 0) % 10000000;
+
+    uint64_t worleySeed = ((uint64_t)1 << 32) | parameters.seed;
+    WorleyGrid grid = WorleyGrid::Create(parameters.featurePoints, parameters.worleyPointsPerCell, size, worleySeed, true);
+
+    auto clouds = multiply(remap(fbm(parameters.frequency, parameters.lacunarity, parameters.persistence, seed, parameters.octaves), -1.0f, 1.0f, 0.0f, 1.0f),
+                           remap(tile(worley(grid), (float)size), 0.0f, 1.0f, 1.0f, 0.0f));
+
+    if (parameters.warp == 0.0f) {
+        GenerateGraphWindow(clouds, size, origin, begin, extent, out, pool);
+        return;
+    }
+
+    auto warp = fbm<4>(parameters.frequency * 4.0f, 2.0f, 0.5f, seed + 57.0f);
+    GenerateGraphWindow(domainWarp(warp, parameters.warp, clouds), size, origin, begin, extent, out, pool);
+}
+
+// Fixed-layout key for cached transmittance: the volume it belongs to and the light
+struct TransmittanceCacheParameters {
+    NoiseCacheParameters noise;
+    TransmittanceParameters light;
+};
+
+// Reads a size³ volume from the cache in whichever element type cache.compressed selects.
+// Float volumes are not copied: `voxels` points into the mapping and keeps it open.
+bool openCachedVolume(VolumeCache& cache, const char* prefix, int size, const void* parameters, uint32_t parametersSize, uint32_t seed, SharedVoxels& voxels) {
+
+    VolumeElementType type = cache.compressed ? VolumeBC4 : VolumeFloat32;
+
+    std::shared_ptr<MappedVolume> cached = std::make_shared<MappedVolume>();
+    if (!cache.Open(prefix, size, size, size, type, parameters, parametersSize, seed, *cached)) return false;
+
+    if (type == VolumeBC4) {
+        VolumeRange range;
+        if (cached->header->payloadSize != sizeof(range) + bc4CompressedSize(size)) return false;
+        memcpy(&range, cached->data, sizeof(range));
+        voxels = sharedVoxels(DecompressVolumeBC4((const uint8_t*)cached->data + sizeof(range), size, range));
+        return true;
+    }
+
+    if (cached->header->payloadSize != (uint64_t)size * size * size * sizeof(float)) return false;
+    voxels = SharedVoxels(cached, (const float*)cached->data);
+    return true;
+}
+
+// Writes a volume to the cache. When compressing, voxels is replaced by what a later
+// openCachedVolume will return, so a fresh volume and a cached one render the same.
+void writeCachedVolume(VolumeCache& cache, const char* prefix, int size, const void* parameters, uint32_t parametersSize, uint32_t seed, std::vector<float>& voxels) {
+
+    if (!cache.compressed) {
+        cache.Write(prefix, size, size, size, VolumeFloat32, parameters, parametersSize, seed, voxels.data(), voxels.size() * sizeof(float));
+        return;
+    }
+
+    VolumeRange range = MeasureVolumeRange(voxels.data(), voxels.size());
+    std::vector<uint8_t> blocks = CompressVolumeBC4(voxels.data(), size, range);
+
+    std::vector<uint8_t> payload(sizeof(range) + blocks.size());
+    memcpy(payload.data(), &range, sizeof(range));
+    memcpy(payload.data() + sizeof(range), blocks.data(), blocks.size());
+
+    cache.Write(prefix, size, size, size, VolumeBC4, parameters, parametersSize, seed, payload.data(), payload.size());
+    voxels = DecompressVolumeBC4(blocks.data(), size, range);
+}
+
+// The volume for these parameters from the cache, or generated and written back
+SharedVoxels LoadNoiseVolume(const NoiseParameters& parameters, VolumeCache& cache) {
+
+    int size = parameters.size;
+    NoiseCacheParameters cacheParameters = noiseCacheParameters(parameters);
+
+    SharedVoxels cached;
+    if (openCachedVolume(cache, "noise", size, &cacheParameters, sizeof(cacheParameters), parameters.seed, cached)) return cached;
+
+    std::vector<float> noiseValues = GenerateNoiseVolume(parameters);
+    writeCachedVolume(cache, "noise", size, &cacheParameters, sizeof(cacheParameters), parameters.seed, noiseValues);
+    return sharedVoxels(std::move(noiseValues));
+}
+
+// Transmittance of the volume LoadNoiseVolume returns for the same parameters, cached the same way
+SharedVoxels LoadTransmittanceVolume(const NoiseParameters& parameters, const float* voxels, const TransmittanceParameters& light, VolumeCache& cache) {
+
+    int size = parameters.size;
+    TransmittanceCacheParameters cacheParameters = { noiseCacheParameters(parameters), light };
+
+    SharedVoxels cached;
+    if (openCachedVolume(cache, "transmittance", size, &cacheParameters, sizeof(cacheParameters), parameters.seed, cached)) return cached;
+
+    std::vector<float> transmittance = ComputeTransmittanceVolume(voxels, size, light);
+    writeCachedVolume(cache, "transmittance", size, &cacheParameters, sizeof(cacheParameters), parameters.seed, transmittance);
+    return sharedVoxels(std::move(transmittance));
+}
+
+// Runs GenerateNoiseVolume on a background thread, along with everything derived from
+// the voxels (mip chain, macrocells, light transmittance, and the texture encoding when
+// `format` is not R32F). The results may only be touched once Finished() has returned true.
+class NoiseJob {
+public:
+    NoiseParameters parameters;
+    TransmittanceParameters transmittanceParameters;
+    VolumeFormat format;
+    std::vector<float> voxels;
+    VolumeMipChain mips;
+    QuantizedVolume quantized;
+    MacrocellGrid macrocells;
+    std::vector<float> transmittance;
+    double milliseconds = 0.0;
+
+    static std::shared_ptr<NoiseJob> Start(const NoiseParameters& parameters, const TransmittanceParameters& transmittanceParameters, VolumeFormat format);
+    bool Finished();
+    ~NoiseJob();
+
+private:
+    std::thread worker;
+    std::atomic<bool> finished{false};
+};
+
+std::shared_ptr<NoiseJob> NoiseJob::Start(const NoiseParameters& parameters, const TransmittanceParameters& transmittanceParameters, VolumeFormat format) {
+    std::shared_ptr<NoiseJob> job = std::make_shared<NoiseJob>();
+    job->parameters = parameters;
+    job->transmittanceParameters = transmittanceParameters;
+    job->format = format;
+
+    NoiseJob* state = job.get();
+    job->worker = std::thread([state]() {
+        auto start = std::chrono::steady_clock::now();
+        state->voxels = GenerateNoiseVolume(state->parameters);
+        state->mips = BuildVolumeMips(state->voxels.data(), state->parameters.size);
+        if (state->format != VolumeFormatFloat32) {
+            state->quantized = QuantizedVolume::Encode(state->voxels.data(), state->parameters.size, &state->mips, state->format);
+        }
+        state->macrocells = MacrocellGrid::Build(state->voxels.data(), state->parameters.size, state->quantized.MaximumError());
+        state->transmittance = ComputeTransmittanceVolume(state->voxels.data(), state->parameters.size, state->transmittanceParameters);
+        state->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        state->finished.store(true, std::memory_order_release);
+    });
+
+    return job;
+}
+
+bool NoiseJob::Finished() {
+    return finished.load(std::memory_order_acquire);
+}
+
+NoiseJob::~NoiseJob() {
+    if (worker.joinable()) worker.join();
+}
+
+#endif /* noise_volume_h */
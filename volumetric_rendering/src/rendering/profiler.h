@@ -0,0 +1,198 @@
+//
+//  profiler.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef profiler_h
+#define profiler_h
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Per-pass timings. GPU passes are measured with GL_TIME_ELAPSED queries kept in a
+// ring of `profilerLatency` frames: a query is only read back once that many frames
+// have gone by, so the result is always available and reading it never stalls.
+// CPU work (generation, upload) is timed directly. Each pass keeps a rolling window
+// of samples that can be written to a CSV file or shown in the window title.
+const int profilerLatency = 4;
+const int profilerWindow = 120;
+
+class Profiler {
+public:
+    struct Pass {
+        std::string name;
+        bool gpu;
+        uint32_t queries[profilerLatency];
+        bool pending[profilerLatency];
+        std::vector<double> samples;
+        int nextSample;
+    };
+    std::vector<Pass> passes;
+
+    bool overlay = false;
+
+    static Profiler Create();
+
+    void BeginFrame();
+    void BeginGpu(const char* name);
+    void EndGpu();
+    void AddCpu(const char* name, double milliseconds);
+
+    void Statistics(int pass, double& mean, double& minimum, double& maximum);
+    void WriteCsv(const char* path);
+    std::string Summary();
+
+private:
+    int frame = 0;
+    int activePass = -1;
+    int FindPass(const char* name, bool gpu);
+    void AddSample(Pass& pass, double milliseconds);
+};
+
+Profiler profiler;
+
+// Times a GPU pass for the lifetime of the scope
+class ScopedGpuTimer {
+public:
+    ScopedGpuTimer(const char* name) { profiler.BeginGpu(name); }
+    ~ScopedGpuTimer() { profiler.EndGpu(); }
+};
+
+// Times CPU work for the lifetime of the scope
+class ScopedCpuTimer {
+public:
+    ScopedCpuTimer(const char* name) : name(name), start(std::chrono::steady_clock::now()) {}
+    ~ScopedCpuTimer() {
+        profiler.AddCpu(name, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+private:
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+};
+
+Profiler Profiler::Create() {
+    Profiler profiler = Profiler();
+    profiler.frame = 0;
+    profiler.activePass = -1;
+    return profiler;
+}
+
+int Profiler::FindPass(const char* name, bool gpu) {
+
+    for (int i = 0; i < (int)passes.size(); i++) {
+        if (passes[i].gpu == gpu && passes[i].name == name) return i;
+    }
+
+    Pass pass = Pass();
+    pass.name = name;
+    pass.gpu = gpu;
+    pass.nextSample = 0;
+    for (int i = 0; i < profilerLatency; i++) pass.pending[i] = false;
+    if (gpu) glGenQueries(profilerLatency, pass.queries);
+
+    passes.push_back(pass);
+    return (int)passes.size() - 1;
+}
+
+// Collects the queries issued profilerLatency frames ago, whose slot is about to be reused
+void Profiler::BeginFrame() {
+
+    frame++;
+    int slot = frame % profilerLatency;
+
+    for (Pass& pass : passes) {
+        if (!pass.gpu || !pass.pending[slot]) continue;
+
+        int available = 0;
+        glGetQueryObjectiv(pass.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(pass.queries[slot], GL_QUERY_RESULT, &nanoseconds);
+        pass.pending[slot] = false;
+        AddSample(pass, nanoseconds / 1.0e6);
+    }
+}
+
+void Profiler::BeginGpu(const char* name) {
+
+    activePass = FindPass(name, true);
+    Pass& pass = passes[activePass];
+    int slot = frame % profilerLatency;
+
+    // Still unread after a full ring: drop it rather than wait on it
+    pass.pending[slot] = true;
+    glBeginQuery(GL_TIME_ELAPSED, pass.queries[slot]);
+}
+
+void Profiler::EndGpu() {
+    if (activePass < 0) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    activePass = -1;
+}
+
+void Profiler::AddCpu(const char* name, double milliseconds) {
+    int index = FindPass(name, false);
+    AddSample(passes[index], milliseconds);
+}
+
+// GPU samples are read back profilerLatency frames late, so telemetry sees them late too
+void Profiler::AddSample(Pass& pass, double milliseconds) {
+    telemetry.Pass(pass.name.c_str(), pass.gpu, milliseconds);
+    
+    if ((int)pass.samples.size() < profilerWindow) {
+        pass.samples.push_back(milliseconds);
+        return;
+    }
+    pass.samples[pass.nextSample] = milliseconds;
+    pass.nextSample = (pass.nextSample + 1) % profilerWindow;
+}
+
+void Profiler::Statistics(int index, double& mean, double& minimum, double& maximum) {
+
+    Pass& pass = passes[index];
+    mean = minimum = maximum = 0.0;
+    if (pass.samples.empty()) return;
+
+    minimum = maximum = pass.samples[0];
+    for (double sample : pass.samples) {
+        mean += sample;
+        minimum = std::min(minimum, sample);
+        maximum = std::max(maximum, sample);
+    }
+    mean /= pass.samples.size();
+}
+
+// Appends one row per pass: frame, pass, kind, mean, min, max, sample count
+void Profiler::WriteCsv(const char* path) {
+
+    FILE* file = fopen(path, "a");
+    if (!file) return;
+
+    for (int i = 0; i < (int)passes.size(); i++) {
+        double mean, minimum, maximum;
+        Statistics(i, mean, minimum, maximum);
+        fprintf(file, "%d,%s,%s,%.4f,%.4f,%.4f,%d\n", frame, passes[i].name.c_str(), passes[i].gpu ? "gpu" : "cpu",
+                mean, minimum, maximum, (int)passes[i].samples.size());
+    }
+    fclose(file);
+}
+
+std::string Profiler::Summary() {
+
+    std::string summary;
+    char entry[96];
+    for (int i = 0; i < (int)passes.size(); i++) {
+        double mean, minimum, maximum;
+        Statistics(i, mean, minimum, maximum);
+        snprintf(entry, sizeof(entry), "%s%s %.2fms", summary.empty() ? "" : " | ", passes[i].name.c_str(), mean);
+        summary += entry;
+    }
+    return summary;
+}
+
+#endif /* profiler_h */
@@ -14,13 +14,57 @@ public:
     
     static RayMarchingQuad Create();
     void Render(Shader shader, DeferredRenderer renderer);
+    void Bind(Shader shader, DeferredRenderer renderer);
+    void Draw();
+    void Bounds(glm::vec3& centre, glm::vec3& halfSize);
     void GenerateNoiseTexture();
+    void LoadNoiseTexture();
+    void Update();
+    TransmittanceParameters LightParameters();
+    std::string Defines();
+    
+    NoiseParameters noiseParameters;
+    VolumeFormat volumeFormat = VolumeFormatFloat32;
+    size_t uploadBudget = 2 * 1024 * 1024;
+    
+    // Cloud box and sun; changing the light or box recomputes the transmittance volume
+    glm::vec3 boxPosition = glm::vec3(0.0f, 0.0f, -10.0f);
+    glm::vec3 boxHalfSize = glm::vec3(4.5f);
+    glm::vec3 lightDirection = glm::normalize(glm::vec3(1.0f, 1.0f, 0.5f));
+    
+    // Set when VOLUMETRIC_SPARSE replaces the box with a streamed brick volume
+    std::shared_ptr<SparseVolume> sparse;
+    
+    // Set when VOLUMETRIC_CLOUD_SCENE names a file of cloud volumes to draw instead of the box
+    std::shared_ptr<CloudScene> scene;
+    void UploadCloudScene();
+    
+    // Set when VOLUMETRIC_WIND makes the box's clouds drift
+    std::shared_ptr<WindVolume> wind;
 private:
-    uint32_t vertexArrayObject, vertexBufferObject, noiseBoxTexture;
+    uint32_t vertexArrayObject, vertexBufferObject, noiseBoxTexture, noiseBackTexture, macrocellTexture;
+    uint32_t transmittanceTexture, transmittanceBackTexture;
+    uint32_t sceneNodeBuffer, sceneNodeTexture, sceneVolumeBuffer, sceneVolumeTexture;
+    void UploadVolumeTexture(uint32_t texture, int size, VolumeFormat format, const std::vector<const uint8_t*>& levels);
+    void UploadMacrocells(const MacrocellGrid& macrocells);
+    
+    SharedVoxels noiseVoxels;
+    VolumeRange noiseRange;
+    TransmittanceParameters transmittanceParameters;
+    
+    std::shared_ptr<NoiseJob> noiseJob;
+    std::shared_ptr<TransmittanceJob> transmittanceJob;
+    std::shared_ptr<VolumeUpload> noiseUpload, transmittanceUpload;
+    NoiseParameters uploadParameters;
+    MacrocellGrid uploadMacrocells;
+    SharedVoxels uploadVoxels;
+    VolumeRange uploadRange;
+    TransmittanceParameters uploadTransmittanceParameters;
 };
 
 RayMarchingQuad RayMarchingQuad::Create() {
     RayMarchingQuad quad = RayMarchingQuad();
+    quad.volumeFormat = VolumeFormatFromEnvironment();
     
     quad.vertices = {
         {{-1.0f,  1.0f,  0.0f}, { 0,  0,  1}, {0, 1}},
@@ -33,7 +77,29 @@ RayMarchingQuad RayMarchingQuad::Create() {
     };
     
     glGenTextures(1, &quad.noiseBoxTexture);
-    quad.GenerateNoiseTexture();
+    glGenTextures(1, &quad.noiseBackTexture);
+    glGenTextures(1, &quad.macrocellTexture);
+    glGenTextures(1, &quad.transmittanceTexture);
+    glGenTextures(1, &quad.transmittanceBackTexture);
+    quad.noiseUpload = std::make_shared<VolumeUpload>(VolumeUpload::Create());
+    quad.transmittanceUpload = std::make_shared<VolumeUpload>(VolumeUpload::Create());
+    
+    size_t sparseBudget = SparseVolume::BudgetFromEnvironment();
+    const char* scenePath = std::getenv("VOLUMETRIC_CLOUD_SCENE");
+    glm::vec3 windSpeed = WindVolume::WindFromEnvironment();
+    
+    if (sparseBudget > 0) quad.sparse = std::make_shared<SparseVolume>(SparseVolume::Create(SparseVolumeParameters(), sparseBudget, 12));
+    else if (!scenePath && windSpeed != glm::vec3(0.0f)) quad.wind = std::make_shared<WindVolume>(WindVolume::Create(quad.noiseParameters, windSpeed));
+    else quad.LoadNoiseTexture();
+    
+    if (scenePath && !quad.sparse) {
+        quad.scene = std::make_shared<CloudScene>(CloudScene::Load(scenePath));
+        glGenBuffers(1, &quad.sceneNodeBuffer);
+        glGenBuffers(1, &quad.sceneVolumeBuffer);
+        glGenTextures(1, &quad.sceneNodeTexture);
+        glGenTextures(1, &quad.sceneVolumeTexture);
+        quad.UploadCloudScene();
+    }
     
     glGenVertexArrays(1, &quad.vertexArrayObject);
     glBindVertexArray(quad.vertexArrayObject);
@@ -53,23 +119,15 @@ RayMarchingQuad RayMarchingQuad::Create() {
 }
 
 void RayMarchingQuad::Render(Shader shader, DeferredRenderer renderer) {
+    Bind(shader, renderer);
+    Draw();
+}
+
+// Uses the program and sets up every texture and uniform the cloud shader reads, so
+// something else can be drawn with it instead of the full-screen quad
+void RayMarchingQuad::Bind(Shader shader, DeferredRenderer renderer) {
     shader.Use();
     
-    
-    glm::mat4 inverseProjection = glm::inverse(camera.projection);
-    glm::mat4 inverseLookAt = glm::inverse(camera.lookAt);
-    glm::vec3 cameraPosition = camera.position;
-    
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
-    
-    glm::vec2 screenSize = glm::vec2(width, height);
-    
-    shader.SetMatrix4("inverseProjection", inverseProjection);
-    shader.SetMatrix4("inverseLookAt", inverseLookAt);
-    shader.SetVector3("cameraPosition", cameraPosition);
-    shader.SetVector2("screenSize", screenSize);
-    
     glActiveTexture(GL_TEXTURE0);
     shader.SetInt("position", 0);
     glBindTexture(GL_TEXTURE_2D, renderer.position);
@@ -88,57 +146,277 @@ void RayMarchingQuad::Render(Shader shader, DeferredRenderer renderer) {
     
     glActiveTexture(GL_TEXTURE4);
     shader.SetInt("noiseTexture", 4);
-    glBindTexture(GL_TEXTURE_3D, noiseBoxTexture);
+    glBindTexture(GL_TEXTURE_3D, wind ? wind->texture : noiseBoxTexture);
+    
+    glActiveTexture(GL_TEXTURE5);
+    shader.SetInt("macrocellTexture", 5);
+    glBindTexture(GL_TEXTURE_3D, macrocellTexture);
+    
+    glActiveTexture(GL_TEXTURE6);
+    shader.SetInt("transmittanceTexture", 6);
+    glBindTexture(GL_TEXTURE_3D, transmittanceTexture);
+    
+    shader.SetVector3("lightDirection", glm::normalize(lightDirection));
+    shader.SetVector2("noiseRange", glm::vec2(noiseRange.minimum, noiseRange.scale));
+    
+    glm::vec3 centre, halfSize;
+    Bounds(centre, halfSize);
+    shader.SetVector3("boxPosition", centre);
+    shader.SetVector3("halfSize", halfSize);
     
+    if (sparse) {
+        glActiveTexture(GL_TEXTURE7);
+        shader.SetInt("pageTable", 7);
+        glBindTexture(GL_TEXTURE_3D, sparse->pageTable);
+        
+        glActiveTexture(GL_TEXTURE8);
+        shader.SetInt("brickAtlas", 8);
+        glBindTexture(GL_TEXTURE_3D, sparse->atlas);
+        
+        // A voxel is as optically thick as one of the dense volume
+        shader.SetFloat("voxelWorldSize", sparse->parameters.voxelSize);
+        shader.SetFloat("densityScale", boxHalfSize.x * 2.0f / noiseParameters.size / sparse->parameters.voxelSize);
+    }
+    else if (scene) {
+        glActiveTexture(GL_TEXTURE7);
+        shader.SetInt("sceneNodes", 7);
+        glBindTexture(GL_TEXTURE_BUFFER, sceneNodeTexture);
+        
+        glActiveTexture(GL_TEXTURE8);
+        shader.SetInt("sceneVolumes", 8);
+        glBindTexture(GL_TEXTURE_BUFFER, sceneVolumeTexture);
+    }
+    else if (wind) {
+        shader.SetVector3("wrapOffset", wind->WrapOffset());
+    }
+    
+    // Units 9 and 10, past the sparse and scene textures
+    sky.Bind(shader, 9);
+}
+
+// The box the cloud shader marches: the whole virtual volume when sparse, the root of
+// the BVH for a scene (so rays that miss every volume stop early), else the cloud box
+void RayMarchingQuad::Bounds(glm::vec3& centre, glm::vec3& halfSize) {
+    
+    if (sparse) {
+        centre = sparse->Centre();
+        halfSize = sparse->HalfSize();
+    }
+    else if (scene) {
+        const CloudBVHNode& root = scene->nodes[0];
+        glm::vec3 lower = glm::vec3(root.min[0], root.min[1], root.min[2]), upper = glm::vec3(root.max[0], root.max[1], root.max[2]);
+        centre = (lower + upper) * 0.5f;
+        halfSize = (upper - lower) * 0.5f;
+    }
+    else {
+        centre = boxPosition;
+        halfSize = boxHalfSize;
+    }
+}
+
+// Draws the full-screen quad with whatever program and textures are bound
+void RayMarchingQuad::Draw() {
     glBindVertexArray(vertexArrayObject);
     glDrawArrays(GL_TRIANGLES, 0, 6);
     
     glBindVertexArray(0);
 }
 
+// Starts generating a new volume in the background; the current one keeps rendering
+// until Update() has streamed the new one in. Ignored while a generation is running,
+// and for wind-driven clouds, which never stop changing anyway.
 void RayMarchingQuad::GenerateNoiseTexture() {
     
-    int size = 128;
-    
-    std::vector<float> noiseValues(size * size * size);
+    if (noiseJob || sparse || wind) return;
     
-    srand(static_cast<unsigned int>(std::time(nullptr)));
-    float seed = rand()%10000000;
+    NoiseParameters parameters = noiseParameters;
+    parameters.seed = static_cast<uint32_t>(std::time(nullptr));
+    noiseJob = NoiseJob::Start(parameters, LightParameters(), volumeFormat);
+}
+
+// The transmittance model for the current light and box
+TransmittanceParameters RayMarchingQuad::LightParameters() {
     
-    int sampleSize = 100;
-    float xsample[sampleSize], ysample[sampleSize], zsample[sampleSize];
+    TransmittanceParameters parameters = TransmittanceParameters();
+    glm::vec3 direction = glm::normalize(lightDirection);
+    for (int axis = 0; axis < 3; axis++) {
+        parameters.lightDirection[axis] = direction[axis];
+        parameters.boxSize[axis] = boxHalfSize[axis] * 2.0f;
+    }
+    return parameters;
+}
 
-    for (int i = 0; i < sampleSize; i++) {
-        float x = (float)rand() / RAND_MAX,
-              y = (float)rand() / RAND_MAX,
-              z = (float)rand() / RAND_MAX;
+// Shader switches for the cloud programs
+std::string RayMarchingQuad::Defines() {
+    if (sparse) return "#define SPARSE_VOLUME\n";
+    if (scene) return "#define CLOUD_SCENE\n";
+    if (wind) return "#define WIND_VOLUME\n";
+    return "";
+}
 
-        xsample[i] = x;
-        ysample[i] = y;
-        zsample[i] = z;
-    }
+// Rebuilds the BVH and uploads it and the volumes as RGBA32F texture buffers. Call it
+// after changing scene->volumes.
+void RayMarchingQuad::UploadCloudScene() {
+    
+    scene->Build();
+    std::vector<float> volumes = scene->VolumeTexels(noiseParameters.size);
+    
+    glBindBuffer(GL_TEXTURE_BUFFER, sceneNodeBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, scene->nodes.size() * sizeof(CloudBVHNode), scene->nodes.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, sceneVolumeBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, volumes.size() * sizeof(float), volumes.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    
+    glBindTexture(GL_TEXTURE_BUFFER, sceneNodeTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, sceneNodeBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, sceneVolumeTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, sceneVolumeBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
 
-    float ***voronoiMap = voronoi(xsample, ysample, zsample, sampleSize, size);
-    float frequency = 0.00421f;
+// Called once per frame. Picks up a finished generation or transmittance job, uploads
+// at most uploadBudget bytes of it into the back textures, and swaps the textures when
+// everything has arrived. A new volume brings its own transmittance; a light change on
+// its own recomputes the transmittance of the volume already on screen.
+void RayMarchingQuad::Update() {
     
-    for (int x = 0; x < size; x++) {
-        for (int y = 0; y < size; y++) {
-            for (int z = 0; z < size; z++) {
-                
-                float voronoiValue = 1 - voronoiMap[x][y][z];
-                
-                noiseValues[x + y * size + z * size * size] = (noiseLayer((x + seed) * frequency, (y + seed) * frequency, 1.5f, 0.7f, 20, (z + seed) * frequency) * 0.5f + 0.5f) * voronoiValue;
-            }
+    if (sparse) {
+        sparse->Update(camera.position);
+        return;
+    }
+    if (wind) {
+        wind->Update();
+        return;
+    }
+    
+    bool uploading = noiseUpload->Active() || transmittanceUpload->Active();
+    
+    if (noiseJob && noiseJob->Finished() && !uploading) {
+        profiler.AddCpu("generation", noiseJob->milliseconds);
+        telemetry.Generation("noise", noiseJob->parameters.size, noiseJob->milliseconds);
+        uploadParameters = noiseJob->parameters;
+        uploadMacrocells = std::move(noiseJob->macrocells);
+        uploadVoxels = sharedVoxels(std::move(noiseJob->voxels));
+        uploadRange = noiseJob->quantized.range;
+        uploadTransmittanceParameters = noiseJob->transmittanceParameters;
+        
+        if (noiseJob->format == VolumeFormatFloat32) {
+            noiseUpload->Begin(noiseBackTexture, uploadParameters.size, uploadVoxels, std::make_shared<const VolumeMipChain>(std::move(noiseJob->mips)));
+        }
+        else {
+            noiseUpload->Begin(noiseBackTexture, std::make_shared<const QuantizedVolume>(std::move(noiseJob->quantized)));
         }
+        transmittanceUpload->Begin(transmittanceBackTexture, uploadParameters.size, sharedVoxels(std::move(noiseJob->transmittance)));
+        noiseJob.reset();
+    }
+    else if (transmittanceJob && transmittanceJob->Finished() && !uploading) {
+        profiler.AddCpu("transmittance", transmittanceJob->milliseconds);
+        telemetry.Generation("transmittance", noiseParameters.size, transmittanceJob->milliseconds);
+        
+        // Only if the volume it was computed for is still the one on screen
+        if (transmittanceJob->voxels == noiseVoxels) {
+            uploadTransmittanceParameters = transmittanceJob->parameters;
+            transmittanceUpload->Begin(transmittanceBackTexture, noiseParameters.size, sharedVoxels(std::move(transmittanceJob->transmittance)));
+        }
+        transmittanceJob.reset();
+    }
+    else if (!noiseJob && !transmittanceJob && !uploading && LightParameters() != transmittanceParameters) {
+        transmittanceJob = TransmittanceJob::Start(noiseVoxels, noiseParameters.size, LightParameters());
+    }
+    
+    if (!noiseUpload->Active() && !transmittanceUpload->Active()) return;
+    
+    ScopedCpuTimer timer("upload");
+    
+    // The volume goes first; the swap waits for its transmittance to be complete as well
+    if (noiseUpload->Active()) {
+        noiseUpload->Step(uploadBudget);
+        return;
+    }
+    if (!transmittanceUpload->Step(uploadBudget)) return;
+    
+    std::swap(transmittanceTexture, transmittanceBackTexture);
+    transmittanceParameters = uploadTransmittanceParameters;
+    
+    telemetry.Generation("swap", noiseParameters.size, 0.0);
+    if (uploadVoxels) {
+        std::swap(noiseBoxTexture, noiseBackTexture);
+        noiseParameters = uploadParameters;
+        noiseVoxels = std::move(uploadVoxels);
+        noiseRange = uploadRange;
+        UploadMacrocells(uploadMacrocells);
     }
+}
+
+// Maps a cached volume for the current parameters, or generates it and writes it back.
+// The transmittance for the current light is cached the same way.
+void RayMarchingQuad::LoadNoiseTexture() {
+    
+    ScopedCpuTimer timer("startup volume");
+    
+    int size = noiseParameters.size;
+    VolumeCache cache = VolumeCache::Create();
+    
+    noiseVoxels = LoadNoiseVolume(noiseParameters, cache);
+    VolumeMipChain mips = BuildVolumeMips(noiseVoxels.get(), size);
     
-    glBindTexture(GL_TEXTURE_3D, noiseBoxTexture);
-    glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, size, size, size, 0, GL_RED, GL_FLOAT, noiseValues.data());
-    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    // R32F goes to GL straight from the voxels, which on a cache hit are the mapping itself
+    QuantizedVolume noise = QuantizedVolume();
+    std::vector<const uint8_t*> levels = { (const uint8_t*)noiseVoxels.get() };
+    for (const std::vector<float>& mip : mips) levels.push_back((const uint8_t*)mip.data());
+    
+    if (volumeFormat != VolumeFormatFloat32) {
+        noise = QuantizedVolume::Encode(noiseVoxels.get(), size, &mips, volumeFormat);
+        levels.clear();
+        for (const std::vector<uint8_t>& level : noise.levels) levels.push_back(level.data());
+    }
+    noiseRange = noise.range;
+    UploadVolumeTexture(noiseBoxTexture, size, volumeFormat, levels);
+    UploadMacrocells(MacrocellGrid::Build(noiseVoxels.get(), size, noise.MaximumError()));
+    
+    transmittanceParameters = LightParameters();
+    SharedVoxels transmittance = LoadTransmittanceVolume(noiseParameters, noiseVoxels.get(), transmittanceParameters, cache);
+    UploadVolumeTexture(transmittanceTexture, size, VolumeFormatFloat32, { (const uint8_t*)transmittance.get() });
+}
+
+// Level i of `levels` is (size >> i)³ texels of `format`
+void RayMarchingQuad::UploadVolumeTexture(uint32_t texture, int size, VolumeFormat format, const std::vector<const uint8_t*>& levels) {
+    
+    int maxLevel = (int)levels.size() - 1;
+    GLint internalFormat;
+    GLenum type;
+    volumeTextureFormat(format, internalFormat, type);
+    
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_3D, texture);
+    for (int i = 0; i <= maxLevel; i++) {
+        int levelSize = std::max(size >> i, 1);
+        glTexImage3D(GL_TEXTURE_3D, i, internalFormat, levelSize, levelSize, levelSize, 0, GL_RED, type, levels[i]);
+    }
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, maxLevel > 0 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 }
 
+// The macrocell pyramid as a small mipmapped RG32F volume, one mip level per pyramid
+// level, read with texelFetch in the marcher
+void RayMarchingQuad::UploadMacrocells(const MacrocellGrid& macrocells) {
+    
+    glBindTexture(GL_TEXTURE_3D, macrocellTexture);
+    for (int level = 0; level < (int)macrocells.levels.size(); level++) {
+        int cells = macrocells.levels[level].cells;
+        glTexImage3D(GL_TEXTURE_3D, level, GL_RG32F, cells, cells, cells, 0, GL_RG, GL_FLOAT, macrocells.levels[level].minMax.data());
+    }
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, (int)macrocells.levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
+
 #endif /* ray_marching_h */
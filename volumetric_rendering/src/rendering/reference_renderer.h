@@ -0,0 +1,424 @@
+//
+//  reference_renderer.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef reference_renderer_h
+#define reference_renderer_h
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// CPU port of the full-resolution cloud pass in atmospheric_clouds/fMain.glsl, for hosts
+// without a GPU: golden images and throughput numbers in CI. It reads the same volumes
+// the GPU samples (noise with its mip chain, macrocells, transmittance) and follows the
+// shader step for step. Texture filtering is emulated with sampleVolume, so results
+// match to within filtering precision, not bit for bit. There is no G-buffer, so
+// every pixel has the sky behind it: the atmosphere tables when the scene carries them,
+// as SkyAtmosphere binds them by default, otherwise the gradient of VOLUMETRIC_SKY=gradient.
+//
+// The image is cut into tiles that the thread pool picks up. Within a tile, rays go in
+// packets of referencePacketSize: ray generation and the box test fill plain per-lane
+// arrays, and only the lanes that hit the box march. There are no SIMD intrinsics here;
+// the march stays scalar per lane because it branches on every sample.
+
+const int referenceTileSize = 16;
+const int referencePacketSize = 8;
+
+struct ReferenceScene {
+    const float* voxels;
+    int size;
+    const VolumeMipChain* mips;
+    const MacrocellGrid* macrocells;
+    const float* transmittance;
+
+    float boxPosition[3], halfSize[3], lightDirection[3];
+
+    // The tables SkyAtmosphere uploads, for the sky and the light on the clouds; null for
+    // the gradient sky and the fixed sun and ambient colours
+    const AtmosphereParameters* atmosphere = nullptr;
+    const AtmosphereLut* atmosphereTransmittance = nullptr;
+    const AtmosphereLut* skyView = nullptr;
+};
+
+struct ReferenceView {
+    float position[3];
+    float yaw, pitch;
+    float fieldOfView = 3.14159265358f / 2.0f;
+    int width, height;
+};
+
+class ReferenceImage {
+public:
+    int width, height;
+    std::vector<float> pixels;      // RGB, bottom row first like glReadPixels
+    double seconds;
+
+    double RaysPerSecond();
+    bool Write(const std::string& path);
+};
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+struct Float3 {
+    float x, y, z;
+};
+
+inline Float3 operator+(Float3 a, Float3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Float3 operator-(Float3 a, Float3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Float3 operator*(Float3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+inline float dot(Float3 a, Float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Float3 cross(Float3 a, Float3 b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+inline Float3 normalize(Float3 a) { return a * (1.0f / std::sqrt(dot(a, a))); }
+
+inline float referenceSmoothstep(float edge0, float edge1, float x) {
+    float t = std::clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+// textureLod with GL_LINEAR_MIPMAP_LINEAR
+float sampleVolumeLod(const ReferenceScene& scene, float u, float v, float w, float lod) {
+
+    int levels = scene.mips ? (int)scene.mips->size() : 0;
+    lod = std::clamp(lod, 0.0f, (float)levels);
+
+    int level = (int)lod;
+    float blend = lod - level;
+
+    auto sampleLevel = [&](int level) {
+        if (level == 0) return sampleVolume(scene.voxels, scene.size, u, v, w);
+        return sampleVolume((*scene.mips)[level - 1].data(), std::max(scene.size >> level, 1), u, v, w);
+    };
+
+    float sample = sampleLevel(level);
+    if (blend <= 0.0f || level >= levels) return sample;
+    return sample + (sampleLevel(level + 1) - sample) * blend;
+}
+
+float referencePhaseSchlick(float cosTheta, float k) {
+    cosTheta = std::clamp(cosTheta, -1.0f, 1.0f);
+    k = std::clamp(k, 0.0f, 0.999f);
+
+    float denom = std::max(1.0f + k * (k - 2.0f * cosTheta), 0.001f);
+    float result = (1.0f - k * k) / (4.0f * 3.141592f * std::pow(denom, 1.5f));
+
+    return std::max(result, 1.0f);
+}
+
+// Distance to the far side of an empty macrocell around uv at this lod, or 0 (see
+// macrocellSkip)
+float referenceMacrocellSkip(const ReferenceScene& scene, Float3 boxMin, Float3 boxMax, Float3 origin, Float3 direction, Float3 uv, float lod) {
+
+    if (!scene.macrocells) return 0.0f;
+
+    const MacrocellGrid& grid = *scene.macrocells;
+    int level = MacrocellGrid::Level(lod);
+    int cells = grid.levels[level].cells;
+    float span = (float)(macrocellSize << level) / grid.size;
+
+    int cx = std::clamp((int)(uv.x / span), 0, cells - 1),
+        cy = std::clamp((int)(uv.y / span), 0, cells - 1),
+        cz = std::clamp((int)(uv.z / span), 0, cells - 1);
+
+    float maximum = grid.levels[level].minMax[((size_t)cx + (size_t)cy * cells + (size_t)cz * cells * cells) * 2 + 1];
+    float density = std::clamp(maximum * maximum * 3.0f - 0.2f, 0.0f, 1.0f) * 2.5f;
+    if (density >= 0.01f) return 0.0f;
+
+    Float3 extent = boxMax - boxMin;
+    int cell[3] = { cx, cy, cz };
+    float o[3] = { origin.x, origin.y, origin.z }, d[3] = { direction.x, direction.y, direction.z };
+    float lower[3] = { boxMin.x, boxMin.y, boxMin.z }, size[3] = { extent.x, extent.y, extent.z };
+
+    float exit = 1e30f;
+    for (int axis = 0; axis < 3; axis++) {
+        int begin, end;
+        grid.CellBounds(level, cell[axis], begin, end);
+        float side = lower[axis] + size[axis] * ((float)(d[axis] >= 0.0f ? end : begin) / grid.size);
+        exit = std::min(exit, (side - o[axis]) / d[axis]);
+    }
+    return exit;
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+// Sun and sky light on the clouds; skyLighting() in the shader when there are tables
+struct ReferenceLighting {
+    Float3 sunColor = { 1.0f, 1.0f, 1.0f };
+    Float3 cloudAmbient = { 0.2f, 0.3f, 0.6f };
+};
+
+// skyViewUV() from the shader: the sky-view table seen along `direction`
+Float3 referenceSkyLuminance(const ReferenceScene& scene, Float3 direction, Float3 sunDirection) {
+
+    float r = scene.atmosphere->ObserverRadius(), bottom = scene.atmosphere->bottomRadius;
+    float beta = std::acos(std::sqrt(r * r - bottom * bottom) / r);
+    float horizonZenith = 3.14159265f - beta;
+
+    float zenithAngle = std::acos(std::clamp(direction.y, -1.0f, 1.0f));
+    float v = zenithAngle < horizonZenith ? 0.5f - 0.5f * std::sqrt(1.0f - zenithAngle / horizonZenith)
+                                          : 0.5f + 0.5f * std::sqrt((zenithAngle - horizonZenith) / beta);
+
+    float azimuth = 1.0f;
+    float viewLength = std::sqrt(direction.x * direction.x + direction.z * direction.z),
+          sunLength = std::sqrt(sunDirection.x * sunDirection.x + sunDirection.z * sunDirection.z);
+    if (viewLength > 1e-5f && sunLength > 1e-5f) {
+        azimuth = (direction.x * sunDirection.x + direction.z * sunDirection.z) / (viewLength * sunLength);
+    }
+
+    float rgb[3];
+    scene.skyView->Sample(std::sqrt(std::clamp(0.5f - 0.5f * azimuth, 0.0f, 1.0f)), v, rgb);
+    return { rgb[0], rgb[1], rgb[2] };
+}
+
+inline Float3 referenceSkyExposure(Float3 luminance) {
+    return { 1.0f - std::exp(-luminance.x * atmosphereSkyExposure),
+             1.0f - std::exp(-luminance.y * atmosphereSkyExposure),
+             1.0f - std::exp(-luminance.z * atmosphereSkyExposure) };
+}
+
+ReferenceLighting referenceLighting(const ReferenceScene& scene, Float3 sunDirection) {
+
+    ReferenceLighting lighting = ReferenceLighting();
+    if (!scene.skyView) return lighting;
+
+    float rgb[3];
+    sunTransmittance(*scene.atmosphere, *scene.atmosphereTransmittance, scene.atmosphere->ObserverRadius(), sunDirection.y, rgb);
+    lighting.sunColor = { rgb[0], rgb[1], rgb[2] };
+    lighting.cloudAmbient = referenceSkyExposure(referenceSkyLuminance(scene, { 0.0f, 1.0f, 0.0f }, sunDirection));
+    return lighting;
+}
+
+// atmosphereSky() from the shader, sun disk included
+Float3 referenceAtmosphereSky(const ReferenceScene& scene, const ReferenceLighting& lighting, Float3 direction, Float3 sunDirection) {
+    Float3 luminance = referenceSkyLuminance(scene, direction, sunDirection);
+    if (dot(direction, sunDirection) > 0.99996f) luminance = luminance + lighting.sunColor * 20.0f;
+    return referenceSkyExposure(luminance);
+}
+
+// The gradient the shader draws where the G-buffer is empty and there are no tables
+Float3 referenceSky(float y) {
+    const Float3 zenithColor = { 0.05f, 0.15f, 0.4f }, horizonColor = { 0.6f, 0.7f, 0.9f }, groundColor = { 0.4f, 0.35f, 0.3f };
+    if (y > 0.0f) return horizonColor + (zenithColor - horizonColor) * std::pow(y, 0.65f);
+    return horizonColor + (groundColor - horizonColor) * std::pow(-y, 0.7f);
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+// rayMarch() from the shader; returns the opacity, or -1 when nothing was hit
+float referenceRayMarch(const ReferenceScene& scene, const ReferenceLighting& lighting, Float3 origin, Float3 direction,
+                        float tNear, float tFar, float pixelAngle, Float3& cloudColor) {
+
+    const float stepSize = 0.05f;
+    const float k = 0.5f;
+    const float maxLod = 3.0f;
+    const Float3 sunColor = lighting.sunColor, cloudAmbient = lighting.cloudAmbient;
+
+    Float3 boxPosition = { scene.boxPosition[0], scene.boxPosition[1], scene.boxPosition[2] };
+    Float3 halfSize = { scene.halfSize[0], scene.halfSize[1], scene.halfSize[2] };
+    Float3 lightDirection = { scene.lightDirection[0], scene.lightDirection[1], scene.lightDirection[2] };
+    Float3 boxMin = boxPosition - halfSize, boxMax = boxPosition + halfSize;
+
+    float voxelSize = 2.0f * halfSize.x / scene.size;
+    float phase = referencePhaseSchlick(dot(direction, lightDirection), k);
+
+    int maxSteps = (int)std::min(128.0f, (tFar - tNear) / stepSize);
+    float t = std::max(tNear, 0.0f);
+    float opacity = 0.0f;
+    Float3 color = { 0.0f, 0.0f, 0.0f };
+
+    for (int i = 0; i < maxSteps && t < tFar; ++i) {
+
+        Float3 rayPosition = origin + direction * t;
+        Float3 uv = { (rayPosition.x - boxPosition.x) / halfSize.x * 0.5f + 0.5f,
+                      (rayPosition.y - boxPosition.y) / halfSize.y * 0.5f + 0.5f,
+                      (rayPosition.z - boxPosition.z) / halfSize.z * 0.5f + 0.5f };
+
+        if (uv.x < 0.0f || uv.y < 0.0f || uv.z < 0.0f || uv.x > 1.0f || uv.y > 1.0f || uv.z > 1.0f) {
+            t += stepSize;
+            continue;
+        }
+
+        float lod = std::clamp(std::log2(std::max(t * pixelAngle / voxelSize, 1.0f)), 0.0f, maxLod);
+        float stride = stepSize * std::exp2(lod);
+
+        float cellExit = referenceMacrocellSkip(scene, boxMin, boxMax, origin, direction, uv, lod);
+        if (cellExit > t) {
+            t += std::ceil((cellExit - t) / stride) * stride;
+            continue;
+        }
+
+        float sampledNoise = std::max(sampleVolumeLod(scene, uv.x, uv.y, uv.z, lod), 0.0f);
+
+        const float margin = 0.1f;
+        float fadeX = referenceSmoothstep(0.0f, margin, uv.x) * (1.0f - referenceSmoothstep(1.0f - margin, 1.0f, uv.x));
+        float fadeY = referenceSmoothstep(0.0f, margin, uv.y) * (1.0f - referenceSmoothstep(1.0f - margin, 1.0f, uv.y));
+        float fadeZ = referenceSmoothstep(0.0f, margin, uv.z) * (1.0f - referenceSmoothstep(1.0f - margin, 1.0f, uv.z));
+
+        float density = std::clamp(sampledNoise * sampledNoise * 3.0f - 0.2f, 0.0f, 1.0f);
+        density *= fadeX * fadeY * fadeZ * 2.5f;
+
+        if (density < 0.01f) {
+            t += stride * 2.0f;
+            continue;
+        }
+
+        float transmittance = sampleVolume(scene.transmittance, scene.size, uv.x, uv.y, uv.z);
+        float light = transmittance * phase * density;
+        Float3 scatter = { sunColor.x * light + cloudAmbient.x * density,
+                           sunColor.y * light + cloudAmbient.y * density,
+                           sunColor.z * light + cloudAmbient.z * density };
+
+        color = color + scatter * ((1.0f - opacity) * stride);
+        opacity += (1.0f - opacity) * density * stride;
+
+        if (opacity >= 0.99f) break;
+        t += stride;
+    }
+
+    if (opacity > 0.0f) {
+        cloudColor = color * 1.75f;
+        return opacity;
+    }
+    cloudColor = { 0.0f, 0.0f, 0.0f };
+    return -1.0f;
+}
+
+ReferenceImage RenderReference(const ReferenceScene& scene, const ReferenceView& view, ThreadPool& pool = ThreadPool::Shared()) {
+
+    ReferenceImage image = ReferenceImage();
+    image.width = view.width;
+    image.height = view.height;
+    image.pixels.resize((size_t)view.width * view.height * 3);
+
+    // Camera basis exactly as Camera::Update and glm::lookAt build it
+    Float3 origin = { view.position[0], view.position[1], view.position[2] };
+    Float3 forward = normalize({ std::cos(view.yaw) * std::cos(view.pitch), std::sin(view.pitch), std::sin(view.yaw) * std::cos(view.pitch) });
+    Float3 side = normalize(cross(forward, { 0.0f, 1.0f, 0.0f }));
+    Float3 up = cross(side, forward);
+
+    float tanHalf = std::tan(view.fieldOfView * 0.5f);
+    float aspect = (float)view.width / view.height;
+    float pixelAngle = 2.0f * tanHalf / view.height;
+
+    Float3 boxMin = { scene.boxPosition[0] - scene.halfSize[0], scene.boxPosition[1] - scene.halfSize[1], scene.boxPosition[2] - scene.halfSize[2] };
+    Float3 boxMax = { scene.boxPosition[0] + scene.halfSize[0], scene.boxPosition[1] + scene.halfSize[1], scene.boxPosition[2] + scene.halfSize[2] };
+
+    Float3 sunDirection = { scene.lightDirection[0], scene.lightDirection[1], scene.lightDirection[2] };
+    ReferenceLighting lighting = referenceLighting(scene, sunDirection);
+
+    int tilesX = (view.width + referenceTileSize - 1) / referenceTileSize,
+        tilesY = (view.height + referenceTileSize - 1) / referenceTileSize;
+
+    auto start = std::chrono::steady_clock::now();
+
+    pool.ParallelFor(0, tilesX * tilesY, 1, [&](int tileBegin, int tileEnd) {
+        for (int tile = tileBegin; tile < tileEnd; tile++) {
+
+            int x0 = (tile % tilesX) * referenceTileSize, x1 = std::min(x0 + referenceTileSize, view.width),
+                y0 = (tile / tilesX) * referenceTileSize, y1 = std::min(y0 + referenceTileSize, view.height);
+
+            for (int y = y0; y < y1; y++) {
+                for (int packet = x0; packet < x1; packet += referencePacketSize) {
+
+                    int lanes = std::min(referencePacketSize, x1 - packet);
+                    float dx[referencePacketSize], dy[referencePacketSize], dz[referencePacketSize];
+                    float tNear[referencePacketSize], tFar[referencePacketSize];
+
+                    // computeRayDirection() for every lane
+                    float v = ((y + 0.5f) / view.height * 2.0f - 1.0f) * tanHalf;
+                    for (int lane = 0; lane < referencePacketSize; lane++) {
+                        float u = ((packet + lane + 0.5f) / view.width * 2.0f - 1.0f) * tanHalf * aspect;
+                        float x = side.x * u + up.x * v + forward.x,
+                              yy = side.y * u + up.y * v + forward.y,
+                              z = side.z * u + up.z * v + forward.z;
+                        float inverseLength = 1.0f / std::sqrt(x * x + yy * yy + z * z);
+                        dx[lane] = x * inverseLength;
+                        dy[lane] = yy * inverseLength;
+                        dz[lane] = z * inverseLength;
+                    }
+
+                    // intersectBox() for every lane
+                    for (int lane = 0; lane < referencePacketSize; lane++) {
+                        float ix = 1.0f / dx[lane], iy = 1.0f / dy[lane], iz = 1.0f / dz[lane];
+                        float ax = (boxMin.x - origin.x) * ix, bx = (boxMax.x - origin.x) * ix,
+                              ay = (boxMin.y - origin.y) * iy, by = (boxMax.y - origin.y) * iy,
+                              az = (boxMin.z - origin.z) * iz, bz = (boxMax.z - origin.z) * iz;
+                        tNear[lane] = std::max(std::max(std::min(ax, bx), std::min(ay, by)), std::min(az, bz));
+                        tFar[lane] = std::min(std::min(std::max(ax, bx), std::max(ay, by)), std::max(az, bz));
+                    }
+
+                    for (int lane = 0; lane < lanes; lane++) {
+                        Float3 direction = { dx[lane], dy[lane], dz[lane] };
+                        Float3 background = scene.skyView ? referenceAtmosphereSky(scene, lighting, direction, sunDirection)
+                                                          : referenceSky(direction.y);
+                        Float3 result = background;
+
+                        if (tFar[lane] >= std::max(tNear[lane], 0.0f)) {
+                            Float3 cloudColor;
+                            float opacity = referenceRayMarch(scene, lighting, origin, direction, tNear[lane], tFar[lane], pixelAngle, cloudColor);
+
+                            if (opacity > 0.0f) {
+                                Float3 toneMapped = { std::pow(cloudColor.x / (cloudColor.x + 1.0f), 1.0f / 2.2f),
+                                                      std::pow(cloudColor.y / (cloudColor.y + 1.0f), 1.0f / 2.2f),
+                                                      std::pow(cloudColor.z / (cloudColor.z + 1.0f), 1.0f / 2.2f) };
+                                result = background + (toneMapped - background) * opacity;
+                            }
+                        }
+
+                        float* out = &image.pixels[((size_t)y * view.width + packet + lane) * 3];
+                        out[0] = result.x;
+                        out[1] = result.y;
+                        out[2] = result.z;
+                    }
+                }
+            }
+        }
+    });
+
+    image.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return image;
+}
+
+double ReferenceImage::RaysPerSecond() {
+    return seconds > 0.0 ? (double)width * height / seconds : 0.0;
+}
+
+// .pfm keeps the floats; anything else is written as an 8-bit binary .ppm
+bool ReferenceImage::Write(const std::string& path) {
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    bool floating = path.size() >= 4 && path.compare(path.size() - 4, 4, ".pfm") == 0;
+
+    if (floating) {
+        // PFM rows run bottom to top already; a negative scale means little-endian
+        fprintf(file, "PF\n%d %d\n-1.0\n", width, height);
+        fwrite(pixels.data(), sizeof(float), pixels.size(), file);
+    }
+    else {
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        std::vector<unsigned char> row((size_t)width * 3);
+        for (int y = height - 1; y >= 0; y--) {
+            for (int i = 0; i < width * 3; i++) {
+                row[i] = (unsigned char)std::lround(std::clamp(pixels[(size_t)y * width * 3 + i], 0.0f, 1.0f) * 255.0f);
+            }
+            fwrite(row.data(), 1, row.size(), file);
+        }
+    }
+
+    bool written = !ferror(file);
+    fclose(file);
+    return written;
+}
+
+#endif /* reference_renderer_h */
@@ -0,0 +1,128 @@
+//
+//  sky_atmosphere.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef sky_atmosphere_h
+#define sky_atmosphere_h
+
+#include <cmath>
+#include <memory>
+#include <string>
+
+// The tables of atmosphere.h as textures, for the sky behind the clouds and the light on
+// them. The transmittance table is made once; the sky-view table only depends on the
+// sun's elevation, so it is recomputed in the background whenever that moves by more
+// than `threshold`, snapped to multiples of it so earlier suns come from the cache.
+// VOLUMETRIC_SKY=gradient keeps the old zenith/horizon gradient (atmosphereSkyEnabled).
+// renderReference builds the same tables on the CPU.
+class SkyAtmosphere {
+public:
+    AtmosphereParameters parameters;
+    bool enabled;
+    float threshold;            // radians of sun elevation before the sky view is recomputed
+    float exposure = atmosphereSkyExposure;
+    glm::vec3 sunDirection;
+
+    uint32_t transmittanceTexture, skyViewTexture;
+
+    static SkyAtmosphere Create(glm::vec3 sunDirection);
+
+    std::string Defines();
+    void Update(glm::vec3 sunDirection);
+    void Bind(Shader& shader, int unit);
+
+private:
+    std::shared_ptr<const AtmosphereLut> transmittance;
+    std::shared_ptr<SkyViewJob> skyViewJob;
+    float skyViewZenith;        // snapped sun zenith angle of the sky view on screen
+
+    void Upload(uint32_t texture, const AtmosphereLut& lut);
+};
+
+SkyAtmosphere sky;
+
+SkyAtmosphere SkyAtmosphere::Create(glm::vec3 sunDirection) {
+    SkyAtmosphere atmosphere = SkyAtmosphere();
+
+    atmosphere.enabled = atmosphereSkyEnabled();
+    atmosphere.threshold = atmosphereSkyThreshold();
+    atmosphere.sunDirection = glm::normalize(sunDirection);
+
+    if (!atmosphere.enabled) return atmosphere;
+
+    ScopedCpuTimer timer("startup sky");
+    VolumeCache cache = VolumeCache::Create();
+
+    atmosphere.skyViewZenith = snappedSunZenith(atmosphere.sunDirection.y, atmosphere.threshold);
+    atmosphere.parameters.sunZenith = std::cos(atmosphere.skyViewZenith);
+
+    atmosphere.transmittance = std::make_shared<const AtmosphereLut>(LoadTransmittanceLut(atmosphere.parameters, cache));
+    AtmosphereLut skyView = LoadSkyViewLut(atmosphere.parameters, *atmosphere.transmittance, cache);
+
+    glGenTextures(1, &atmosphere.transmittanceTexture);
+    glGenTextures(1, &atmosphere.skyViewTexture);
+    atmosphere.Upload(atmosphere.transmittanceTexture, *atmosphere.transmittance);
+    atmosphere.Upload(atmosphere.skyViewTexture, skyView);
+
+    return atmosphere;
+}
+
+std::string SkyAtmosphere::Defines() {
+    return enabled ? "#define ATMOSPHERE_LUT\n" : "";
+}
+
+// Called once per frame with the current sun. Swaps in a finished sky view, and starts
+// the next one when the sun has moved to another step.
+void SkyAtmosphere::Update(glm::vec3 sunDirection) {
+
+    if (!enabled) return;
+    this->sunDirection = glm::normalize(sunDirection);
+
+    if (skyViewJob) {
+        if (!skyViewJob->Finished()) return;
+
+        profiler.AddCpu("sky", skyViewJob->milliseconds);
+        telemetry.Generation("sky", skyViewJob->skyView.width * skyViewJob->skyView.height, skyViewJob->milliseconds);
+        Upload(skyViewTexture, skyViewJob->skyView);
+        skyViewJob.reset();
+    }
+
+    float zenith = snappedSunZenith(this->sunDirection.y, threshold);
+    if (zenith == skyViewZenith) return;
+
+    skyViewZenith = zenith;
+    parameters.sunZenith = std::cos(zenith);
+    skyViewJob = SkyViewJob::Start(parameters, transmittance);
+}
+
+void SkyAtmosphere::Bind(Shader& shader, int unit) {
+
+    if (!enabled) return;
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    shader.SetInt("transmittanceLUT", unit);
+    glBindTexture(GL_TEXTURE_2D, transmittanceTexture);
+
+    glActiveTexture(GL_TEXTURE0 + unit + 1);
+    shader.SetInt("skyViewLUT", unit + 1);
+    glBindTexture(GL_TEXTURE_2D, skyViewTexture);
+
+    shader.SetVector3("sunDirection", sunDirection);
+    shader.SetVector3("atmosphereRadii", glm::vec3(parameters.bottomRadius, parameters.topRadius, parameters.ObserverRadius()));
+    shader.SetFloat("skyExposure", exposure);
+}
+
+void SkyAtmosphere::Upload(uint32_t texture, const AtmosphereLut& lut) {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, lut.width, lut.height, 0, GL_RGB, GL_FLOAT, lut.texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+#endif /* sky_atmosphere_h */
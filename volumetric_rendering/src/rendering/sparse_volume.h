@@ -0,0 +1,229 @@
+//
+//  sparse_volume.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef sparse_volume_h
+#define sparse_volume_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Generates a batch of bricks on a background thread, spread over the thread pool, and
+// converts them to GL_R16. The results may only be touched once Finished() is true.
+class BrickJob {
+public:
+    std::vector<int> bricks;
+    std::vector<uint16_t> voxels;           // brickStoredSize³ per brick, in request order
+    std::vector<uint8_t> visible;
+    double milliseconds = 0.0;
+
+    static std::shared_ptr<BrickJob> Start(const SparseVolumeParameters& parameters, std::shared_ptr<WorleyGrid> worley, std::vector<int> bricks);
+    bool Finished();
+    ~BrickJob();
+
+private:
+    SparseVolumeParameters parameters;
+    std::shared_ptr<WorleyGrid> worley;
+    std::thread worker;
+    std::atomic<bool> finished{false};
+};
+
+std::shared_ptr<BrickJob> BrickJob::Start(const SparseVolumeParameters& parameters, std::shared_ptr<WorleyGrid> worley, std::vector<int> bricks) {
+    std::shared_ptr<BrickJob> job = std::make_shared<BrickJob>();
+    job->parameters = parameters;
+    job->worley = std::move(worley);
+    job->bricks = std::move(bricks);
+
+    BrickJob* state = job.get();
+    job->worker = std::thread([state]() {
+        auto start = std::chrono::steady_clock::now();
+
+        const size_t brickVoxels = (size_t)brickStoredSize * brickStoredSize * brickStoredSize;
+        int count = (int)state->bricks.size();
+        state->voxels.resize(brickVoxels * count);
+        state->visible.resize(count);
+
+        ThreadPool::Shared().ParallelFor(0, count, 1, [&](int begin, int end) {
+            std::vector<float> voxels(brickVoxels);
+            for (int i = begin; i < end; i++) {
+                state->visible[i] = GenerateBrick(state->parameters, *state->worley, state->bricks[i], voxels.data());
+                if (!state->visible[i]) continue;
+
+                uint16_t* out = &state->voxels[brickVoxels * i];
+                for (size_t v = 0; v < brickVoxels; v++) out[v] = (uint16_t)std::lround(voxels[v] * 65535.0f);
+            }
+        });
+
+        state->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        state->finished.store(true, std::memory_order_release);
+    });
+
+    return job;
+}
+
+bool BrickJob::Finished() {
+    return finished.load(std::memory_order_acquire);
+}
+
+BrickJob::~BrickJob() {
+    if (worker.joinable()) worker.join();
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+// GPU side of the sparse volume. Resident bricks live in slots of a GL_R16 atlas sized
+// by the memory budget; a GL_RGBA8UI page table with one texel per brick of the virtual
+// volume holds its atlas slot in xyz and its BrickState in w. Each frame Update() hands
+// finished bricks to the atlas, rewrites the page-table texels that changed and starts
+// generating the next batch around the camera.
+class SparseVolume {
+public:
+    SparseVolumeParameters parameters;
+    BrickResidency residency;
+    uint32_t pageTable, atlas;
+    int atlasBricks[3];
+    int bricksPerJob = 32;
+
+    static SparseVolume Create(const SparseVolumeParameters& parameters, size_t memoryBudget, int radius);
+    static size_t BudgetFromEnvironment();
+    void Update(glm::vec3 cameraPosition);
+
+    glm::vec3 Centre();
+    glm::vec3 HalfSize();
+
+private:
+    std::shared_ptr<WorleyGrid> worley;
+    std::shared_ptr<BrickJob> job;
+    void WritePageEntry(int brick);
+};
+
+// VOLUMETRIC_SPARSE=<megabytes> switches the clouds to the sparse volume with that much
+// brick atlas (64 MB if the value is not a number); 0 when unset
+size_t SparseVolume::BudgetFromEnvironment() {
+    const char* sparse = std::getenv("VOLUMETRIC_SPARSE");
+    if (!sparse) return 0;
+
+    long megabytes = std::atol(sparse);
+    return (size_t)(megabytes > 0 ? megabytes : 64) * 1024 * 1024;
+}
+
+SparseVolume SparseVolume::Create(const SparseVolumeParameters& parameters, size_t memoryBudget, int radius) {
+    SparseVolume volume = SparseVolume();
+    volume.parameters = parameters;
+    volume.worley = std::make_shared<WorleyGrid>(sparseWorleyGrid(parameters));
+
+    // As close to a cube of slots as the budget and the 3D texture limit allow
+    int maximumSize;
+    glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maximumSize);
+    int maximumBricks = maximumSize / brickStoredSize;
+
+    size_t brickBytes = (size_t)brickStoredSize * brickStoredSize * brickStoredSize * sizeof(uint16_t);
+    int slots = (int)std::max(memoryBudget / brickBytes, (size_t)1);
+    int side = std::clamp((int)std::cbrt((double)slots), 1, maximumBricks);
+
+    volume.atlasBricks[0] = side;
+    volume.atlasBricks[1] = side;
+    volume.atlasBricks[2] = std::clamp(slots / (side * side), 1, maximumBricks);
+    volume.residency = BrickResidency::Create(parameters, volume.atlasBricks[0] * volume.atlasBricks[1] * volume.atlasBricks[2], radius);
+
+    glGenTextures(1, &volume.atlas);
+    glBindTexture(GL_TEXTURE_3D, volume.atlas);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R16, volume.atlasBricks[0] * brickStoredSize, volume.atlasBricks[1] * brickStoredSize, volume.atlasBricks[2] * brickStoredSize,
+                 0, GL_RED, GL_UNSIGNED_SHORT, nullptr);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    // Everything starts out missing
+    std::vector<uint8_t> entries((size_t)parameters.BrickCount() * 4, 0);
+
+    glGenTextures(1, &volume.pageTable);
+    glBindTexture(GL_TEXTURE_3D, volume.pageTable);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8UI, parameters.bricks[0], parameters.bricks[1], parameters.bricks[2], 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entries.data());
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    return volume;
+}
+
+void SparseVolume::Update(glm::vec3 cameraPosition) {
+
+    float camera[3] = { cameraPosition.x, cameraPosition.y, cameraPosition.z };
+
+    if (job && job->Finished()) {
+        ScopedCpuTimer timer("bricks");
+        profiler.AddCpu("brick generation", job->milliseconds);
+        telemetry.Generation("bricks", (int)job->bricks.size(), job->milliseconds);
+
+        const size_t brickVoxels = (size_t)brickStoredSize * brickStoredSize * brickStoredSize;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        for (int i = 0; i < (int)job->bricks.size(); i++) {
+            int brick = job->bricks[i];
+
+            if (!job->visible[i]) {
+                residency.MarkEmpty(brick);
+                WritePageEntry(brick);
+                continue;
+            }
+
+            int evicted;
+            int slot = residency.Allocate(brick, camera, evicted);
+            if (evicted >= 0) WritePageEntry(evicted);
+            if (slot < 0) continue;
+
+            int sx = slot % atlasBricks[0], sy = (slot / atlasBricks[0]) % atlasBricks[1], sz = slot / (atlasBricks[0] * atlasBricks[1]);
+            glBindTexture(GL_TEXTURE_3D, atlas);
+            glTexSubImage3D(GL_TEXTURE_3D, 0, sx * brickStoredSize, sy * brickStoredSize, sz * brickStoredSize,
+                            brickStoredSize, brickStoredSize, brickStoredSize, GL_RED, GL_UNSIGNED_SHORT, &job->voxels[brickVoxels * i]);
+            WritePageEntry(brick);
+        }
+        job.reset();
+    }
+
+    if (job) return;
+
+    std::vector<int> requests = residency.Requests(camera, bricksPerJob);
+    if (!requests.empty()) job = BrickJob::Start(parameters, worley, std::move(requests));
+}
+
+void SparseVolume::WritePageEntry(int brick) {
+
+    int bx, by, bz;
+    parameters.BrickCoordinate(brick, bx, by, bz);
+
+    uint8_t entry[4] = { 0, 0, 0, residency.states[brick] };
+    int slot = residency.slots[brick];
+    if (slot >= 0) {
+        entry[0] = (uint8_t)(slot % atlasBricks[0]);
+        entry[1] = (uint8_t)((slot / atlasBricks[0]) % atlasBricks[1]);
+        entry[2] = (uint8_t)(slot / (atlasBricks[0] * atlasBricks[1]));
+    }
+
+    glBindTexture(GL_TEXTURE_3D, pageTable);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, bx, by, bz, 1, 1, 1, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entry);
+}
+
+glm::vec3 SparseVolume::HalfSize() {
+    float brickWorldSize = brickSize * parameters.voxelSize;
+    return glm::vec3(parameters.bricks[0], parameters.bricks[1], parameters.bricks[2]) * brickWorldSize * 0.5f;
+}
+
+glm::vec3 SparseVolume::Centre() {
+    return glm::vec3(parameters.origin[0], parameters.origin[1], parameters.origin[2]) + HalfSize();
+}
+
+#endif /* sparse_volume_h */
@@ -0,0 +1,70 @@
+//
+//  surface.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef surface_h
+#define surface_h
+
+// Where the final image goes: the GLFW window, or an offscreen framebuffer of a fixed
+// size when running headless. Everything that used to ask GLFW for the window size
+// asks the surface instead.
+class Surface {
+public:
+    bool headless = false;
+    int width, height;
+    uint32_t framebuffer = 0;
+
+    static void CreateOffscreen(int width, int height);
+    void GetFramebufferSize(int* width, int* height);
+    void GetWindowSize(int* width, int* height);
+private:
+    uint32_t colorbuffer, depthbuffer;
+};
+
+Surface surface;
+
+void Surface::CreateOffscreen(int width, int height) {
+
+    surface = Surface();
+    surface.headless = true;
+    surface.width = width;
+    surface.height = height;
+
+    glGenFramebuffers(1, &surface.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, surface.framebuffer);
+
+    glGenRenderbuffers(1, &surface.colorbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, surface.colorbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, surface.colorbuffer);
+
+    glGenRenderbuffers(1, &surface.depthbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, surface.depthbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, surface.depthbuffer);
+
+    glViewport(0, 0, width, height);
+}
+
+void Surface::GetFramebufferSize(int* width, int* height) {
+    if (headless) {
+        *width = this->width;
+        *height = this->height;
+        return;
+    }
+    glfwGetFramebufferSize(window, width, height);
+}
+
+void Surface::GetWindowSize(int* width, int* height) {
+    if (headless) {
+        *width = this->width;
+        *height = this->height;
+        return;
+    }
+    glfwGetWindowSize(window, width, height);
+}
+
+#endif /* surface_h */
@@ -0,0 +1,148 @@
+//
+//  transmittance.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef transmittance_h
+#define transmittance_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Light reaching each voxel centre of the noise volume, so the cloud shader does one
+// fetch per sample instead of a march toward the light. It is the same model the
+// shader used to evaluate: `steps` trilinear samples `stepSize` apart toward the
+// light, stopping at the box, remapped by pow(n, 1.4) * 1.2 - 0.2 and attenuated by
+// exp(-attenuation * extinction).
+//
+// The window is a fixed 16 steps rather than "everything up to the box", so a running
+// sum along light-aligned lines would not reproduce it; every voxel marches its own
+// window instead, over Z-slabs on the thread pool.
+struct TransmittanceParameters {
+    float lightDirection[3] = { 0.0f, 1.0f, 0.0f };
+    float boxSize[3] = { 9.0f, 9.0f, 9.0f };
+    float stepSize = 0.05f;
+    int steps = 16;
+    float extinction = 10.1f;
+
+    bool operator==(const TransmittanceParameters& other) const {
+        return std::equal(lightDirection, lightDirection + 3, other.lightDirection) &&
+               std::equal(boxSize, boxSize + 3, other.boxSize) &&
+               stepSize == other.stepSize && steps == other.steps && extinction == other.extinction;
+    }
+    bool operator!=(const TransmittanceParameters& other) const { return !(*this == other); }
+};
+
+// GL_LINEAR with CLAMP_TO_EDGE on a size³ volume, at normalized coordinates
+float sampleVolume(const float* voxels, int size, float u, float v, float w) {
+
+    float x = u * size - 0.5f, y = v * size - 0.5f, z = w * size - 0.5f;
+    int x0 = (int)std::floor(x), y0 = (int)std::floor(y), z0 = (int)std::floor(z);
+    float fx = x - x0, fy = y - y0, fz = z - z0;
+
+    int x1 = std::clamp(x0 + 1, 0, size - 1), y1 = std::clamp(y0 + 1, 0, size - 1), z1 = std::clamp(z0 + 1, 0, size - 1);
+    x0 = std::clamp(x0, 0, size - 1);
+    y0 = std::clamp(y0, 0, size - 1);
+    z0 = std::clamp(z0, 0, size - 1);
+
+    auto at = [&](int x, int y, int z) { return voxels[x + (size_t)y * size + (size_t)z * size * size]; };
+
+    float c00 = at(x0, y0, z0) + (at(x1, y0, z0) - at(x0, y0, z0)) * fx,
+          c10 = at(x0, y1, z0) + (at(x1, y1, z0) - at(x0, y1, z0)) * fx,
+          c01 = at(x0, y0, z1) + (at(x1, y0, z1) - at(x0, y0, z1)) * fx,
+          c11 = at(x0, y1, z1) + (at(x1, y1, z1) - at(x0, y1, z1)) * fx;
+
+    float c0 = c00 + (c10 - c00) * fy,
+          c1 = c01 + (c11 - c01) * fy;
+
+    return c0 + (c1 - c0) * fz;
+}
+
+std::vector<float> ComputeTransmittanceVolume(const float* voxels, int size, const TransmittanceParameters& parameters, ThreadPool& pool = ThreadPool::Shared()) {
+
+    std::vector<float> transmittance((size_t)size * size * size);
+
+    // One step toward the light, in normalized volume coordinates
+    float step[3];
+    for (int axis = 0; axis < 3; axis++) step[axis] = parameters.lightDirection[axis] * parameters.stepSize / parameters.boxSize[axis];
+
+    pool.ParallelFor(0, size, 1, [&](int zBegin, int zEnd) {
+        for (int z = zBegin; z < zEnd; z++) {
+            for (int y = 0; y < size; y++) {
+                float* out = &transmittance[(size_t)y * size + (size_t)z * size * size];
+                for (int x = 0; x < size; x++) {
+
+                    float u = (x + 0.5f) / size, v = (y + 0.5f) / size, w = (z + 0.5f) / size;
+                    float attenuation = 0.0f;
+
+                    for (int i = 0; i < parameters.steps; i++) {
+                        if (u < 0.0f || v < 0.0f || w < 0.0f || u > 1.0f || v > 1.0f || w > 1.0f) break;
+
+                        float sampledNoise = std::max(sampleVolume(voxels, size, u, v, w), 0.0f);
+                        float localDensity = std::clamp(std::pow(sampledNoise, 1.4f) * 1.2f - 0.2f, 0.0f, 1.0f);
+                        attenuation += localDensity * parameters.stepSize;
+
+                        u += step[0];
+                        v += step[1];
+                        w += step[2];
+                    }
+
+                    out[x] = std::exp(-attenuation * parameters.extinction);
+                }
+            }
+        }
+    });
+
+    return transmittance;
+}
+
+// Recomputes the transmittance of an existing volume on a background thread, for when
+// only the light has changed. The result may only be touched once Finished() is true.
+class TransmittanceJob {
+public:
+    TransmittanceParameters parameters;
+    SharedVoxels voxels;
+    std::vector<float> transmittance;
+    double milliseconds = 0.0;
+
+    static std::shared_ptr<TransmittanceJob> Start(SharedVoxels voxels, int size, const TransmittanceParameters& parameters);
+    bool Finished();
+    ~TransmittanceJob();
+
+private:
+    std::thread worker;
+    std::atomic<bool> finished{false};
+};
+
+std::shared_ptr<TransmittanceJob> TransmittanceJob::Start(SharedVoxels voxels, int size, const TransmittanceParameters& parameters) {
+    std::shared_ptr<TransmittanceJob> job = std::make_shared<TransmittanceJob>();
+    job->parameters = parameters;
+    job->voxels = voxels;
+
+    TransmittanceJob* state = job.get();
+    job->worker = std::thread([state, size]() {
+        auto start = std::chrono::steady_clock::now();
+        state->transmittance = ComputeTransmittanceVolume(state->voxels.get(), size, state->parameters);
+        state->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        state->finished.store(true, std::memory_order_release);
+    });
+
+    return job;
+}
+
+bool TransmittanceJob::Finished() {
+    return finished.load(std::memory_order_acquire);
+}
+
+TransmittanceJob::~TransmittanceJob() {
+    if (worker.joinable()) worker.join();
+}
+
+#endif /* transmittance_h */
@@ -0,0 +1,244 @@
+//
+//  volume_cache.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef volume_cache_h
+#define volume_cache_h
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// On-disk cache for generated volumes. A file is a fixed 160-byte header followed by
+// the raw voxels, so a hit is a single mmap and the payload can go straight to GL.
+// Compressed files trade that for an eighth of the disk space and a decode on load.
+//
+// The file name is a hash of everything that produced the data (the generator
+// parameters, dimensions and element type). The header repeats those inputs and
+// carries a checksum of the payload, so a stale or truncated file is a miss.
+
+enum VolumeElementType : uint32_t {
+    VolumeFloat32 = 0,
+    VolumeBC4 = 1,      // VolumeRange, then CompressVolumeBC4 blocks
+};
+
+struct VolumeCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width, height, depth;
+    uint32_t elementType;
+    uint64_t key;
+    uint32_t seed;
+    uint32_t parametersSize;
+    uint8_t parameters[96];
+    uint64_t payloadSize;
+    uint64_t checksum;
+    uint64_t reserved;
+};
+static_assert(sizeof(VolumeCacheHeader) == 160, "volume cache header layout changed");
+
+const uint32_t volumeCacheVersion = 1;
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 0xCBF29CE484222325ull) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// FNV-style mix over 64-bit words, fast enough to verify a whole volume on load
+uint64_t checksumBytes(const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t word;
+        memcpy(&word, bytes + i * 8, 8);
+        hash = (hash ^ word) * 0x100000001B3ull;
+        hash ^= hash >> 29;
+    }
+    return hashBytes(bytes + words * 8, size - words * 8, hash);
+}
+
+// Read-only mapping of a cache file, unmapped when it goes out of scope
+class MappedVolume {
+public:
+    const VolumeCacheHeader* header = nullptr;
+    const void* data = nullptr;
+
+    MappedVolume() = default;
+    ~MappedVolume();
+    MappedVolume(const MappedVolume&) = delete;
+    MappedVolume& operator=(const MappedVolume&) = delete;
+
+    void Release();
+private:
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    friend class VolumeCache;
+};
+
+// Read-only voxels shared between loaders, uploads and background jobs. The pointer
+// keeps its storage alive, whether that is a vector or the mapping of a cache file.
+typedef std::shared_ptr<const float> SharedVoxels;
+
+SharedVoxels sharedVoxels(std::vector<float> voxels) {
+    std::shared_ptr<const std::vector<float>> owner = std::make_shared<const std::vector<float>>(std::move(voxels));
+    return SharedVoxels(owner, owner->data());
+}
+
+MappedVolume::~MappedVolume() {
+    Release();
+}
+
+void MappedVolume::Release() {
+    if (mapping) munmap(mapping, mappingSize);
+    mapping = nullptr;
+    header = nullptr;
+    data = nullptr;
+}
+
+class VolumeCache {
+public:
+    std::string directory;
+    bool compressed;
+
+    static VolumeCache Create();
+
+    uint64_t Key(uint32_t width, uint32_t height, uint32_t depth, VolumeElementType type, const void* parameters, uint32_t parametersSize);
+    std::string PathForKey(const char* prefix, uint64_t key);
+
+    bool Open(const char* prefix, uint32_t width, uint32_t height, uint32_t depth, VolumeElementType type,
+              const void* parameters, uint32_t parametersSize, uint32_t seed, MappedVolume& volume);
+    bool Write(const char* prefix, uint32_t width, uint32_t height, uint32_t depth, VolumeElementType type,
+               const void* parameters, uint32_t parametersSize, uint32_t seed, const void* payload, uint64_t payloadSize);
+};
+
+VolumeCache VolumeCache::Create() {
+    VolumeCache cache = VolumeCache();
+
+    const char* directory = std::getenv("VOLUMETRIC_CACHE_DIR");
+    cache.directory = directory ? directory : "volume_cache";
+
+    // VOLUMETRIC_CACHE_COMPRESSION=bc4 stores volumes at 4 bits per voxel instead of 32
+    const char* compression = std::getenv("VOLUMETRIC_CACHE_COMPRESSION");
+    cache.compressed = compression && std::string(compression) == "bc4";
+
+    return cache;
+}
+
+uint64_t VolumeCache::Key(uint32_t width, uint32_t height, uint32_t depth, VolumeElementType type, const void* parameters, uint32_t parametersSize) {
+    uint32_t shape[5] = { volumeCacheVersion, width, height, depth, (uint32_t)type };
+    return hashBytes(parameters, parametersSize, hashBytes(shape, sizeof(shape)));
+}
+
+std::string VolumeCache::PathForKey(const char* prefix, uint64_t key) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s_%016llx.vol", prefix, (unsigned long long)key);
+    return directory + "/" + name;
+}
+
+bool VolumeCache::Open(const char* prefix, uint32_t width, uint32_t height, uint32_t depth, VolumeElementType type,
+                       const void* parameters, uint32_t parametersSize, uint32_t seed, MappedVolume& volume) {
+
+    volume.Release();
+    if (parametersSize > sizeof(VolumeCacheHeader::parameters)) return false;
+
+    uint64_t key = Key(width, height, depth, type, parameters, parametersSize);
+    std::string path = PathForKey(prefix, key);
+
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) return false;
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || (size_t)info.st_size < sizeof(VolumeCacheHeader)) {
+        close(file);
+        return false;
+    }
+
+    size_t size = (size_t)info.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED) return false;
+
+    volume.mapping = mapping;
+    volume.mappingSize = size;
+
+    const VolumeCacheHeader* header = (const VolumeCacheHeader*)mapping;
+    bool valid = memcmp(header->magic, "VRNV", 4) == 0 &&
+                 header->version == volumeCacheVersion &&
+                 header->width == width && header->height == height && header->depth == depth &&
+                 header->elementType == type &&
+                 header->key == key && header->seed == seed &&
+                 header->parametersSize == parametersSize &&
+                 memcmp(header->parameters, parameters, parametersSize) == 0 &&
+                 header->payloadSize == size - sizeof(VolumeCacheHeader);
+
+    if (!valid || checksumBytes((const uint8_t*)mapping + sizeof(VolumeCacheHeader), header->payloadSize) != header->checksum) {
+        volume.Release();
+        return false;
+    }
+
+    volume.header = header;
+    volume.data = (const uint8_t*)mapping + sizeof(VolumeCacheHeader);
+    return true;
+}
+
+bool VolumeCache::Write(const char* prefix, uint32_t width, uint32_t height, uint32_t depth, VolumeElementType type,
+                        const void* parameters, uint32_t parametersSize, uint32_t seed, const void* payload, uint64_t payloadSize) {
+
+    if (parametersSize > sizeof(VolumeCacheHeader::parameters)) return false;
+
+    VolumeCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "VRNV", 4);
+    header.version = volumeCacheVersion;
+    header.width = width;
+    header.height = height;
+    header.depth = depth;
+    header.elementType = type;
+    header.key = Key(width, height, depth, type, parameters, parametersSize);
+    header.seed = seed;
+    header.parametersSize = parametersSize;
+    memcpy(header.parameters, parameters, parametersSize);
+    header.payloadSize = payloadSize;
+    header.checksum = checksumBytes(payload, payloadSize);
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    // Write next to the final name and rename, so a crash never leaves a half-written hit
+    std::string path = PathForKey(prefix, header.key);
+    std::string temporaryPath = path + ".tmp";
+
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)payload, (std::streamsize)payloadSize);
+    file.close();
+
+    if (!file || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+#endif /* volume_cache_h */
@@ -0,0 +1,60 @@
+//
+//  volume_mips.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef volume_mips_h
+#define volume_mips_h
+
+#include <algorithm>
+#include <vector>
+
+// Levels 1 and up of a size³ volume, each a 2x2x2 box filter of the one before it,
+// down to 1³. Level i is (size >> i)³ laid out like the base level. Rows of every level
+// are filled in parallel; each level waits for the one above it.
+typedef std::vector<std::vector<float>> VolumeMipChain;
+
+VolumeMipChain BuildVolumeMips(const float* voxels, int size, ThreadPool& pool = ThreadPool::Shared()) {
+
+    VolumeMipChain mips;
+    const float* source = voxels;
+    int sourceSize = size;
+
+    while (sourceSize > 1) {
+        int levelSize = std::max(sourceSize / 2, 1);
+        std::vector<float> level((size_t)levelSize * levelSize * levelSize);
+
+        pool.ParallelFor(0, levelSize, 1, [&](int zBegin, int zEnd) {
+            for (int z = zBegin; z < zEnd; z++) {
+                for (int y = 0; y < levelSize; y++) {
+                    float* out = &level[(size_t)y * levelSize + (size_t)z * levelSize * levelSize];
+                    for (int x = 0; x < levelSize; x++) {
+
+                        float sum = 0.0f;
+                        for (int dz = 0; dz < 2; dz++) {
+                            for (int dy = 0; dy < 2; dy++) {
+                                for (int dx = 0; dx < 2; dx++) {
+                                    int sx = std::min(x * 2 + dx, sourceSize - 1),
+                                        sy = std::min(y * 2 + dy, sourceSize - 1),
+                                        sz = std::min(z * 2 + dz, sourceSize - 1);
+                                    sum += source[sx + (size_t)sy * sourceSize + (size_t)sz * sourceSize * sourceSize];
+                                }
+                            }
+                        }
+                        out[x] = sum * 0.125f;
+                    }
+                }
+            }
+        });
+
+        mips.push_back(std::move(level));
+        source = mips.back().data();
+        sourceSize = levelSize;
+    }
+
+    return mips;
+}
+
+#endif /* volume_mips_h */
@@ -0,0 +1,296 @@
+//
+//  volume_quantize.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef volume_quantize_h
+#define volume_quantize_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Smaller encodings of a float volume. The density only needs 8 to 12 bits in the
+// shader, so R32F spends most of its memory and bandwidth on noise:
+//
+//  - VolumeFormatUnorm16/Unorm8 store value = range.minimum + normalized * range.scale
+//    as GL_R16/GL_R8, where the range is the volume's own minimum and maximum. The
+//    remap is linear, so it commutes with trilinear and mip filtering and the shader
+//    applies it once per sample (the noiseRange uniform).
+//  - CompressVolumeBC4 packs every 4x4 row-block of a Z-slice into the 8-byte BC4
+//    layout: two 8-bit endpoints and 16 3-bit palette indices, 4 bits per voxel. It is
+//    only used for cache files and decoded to floats on load; GL 4.1 has no compressed
+//    3D formats.
+enum VolumeFormat {
+    VolumeFormatFloat32,
+    VolumeFormatUnorm16,
+    VolumeFormatUnorm8,
+};
+
+struct VolumeRange {
+    float minimum = 0.0f;
+    float scale = 1.0f;
+};
+
+// VOLUMETRIC_VOLUME_FORMAT=r16|r8 quantizes the noise texture, anything else keeps R32F
+VolumeFormat VolumeFormatFromEnvironment() {
+    const char* format = std::getenv("VOLUMETRIC_VOLUME_FORMAT");
+    if (!format) return VolumeFormatFloat32;
+
+    std::string name = format;
+    if (name == "r16") return VolumeFormatUnorm16;
+    if (name == "r8") return VolumeFormatUnorm8;
+    return VolumeFormatFloat32;
+}
+
+size_t volumeFormatBytes(VolumeFormat format) {
+    if (format == VolumeFormatUnorm16) return 2;
+    if (format == VolumeFormatUnorm8) return 1;
+    return 4;
+}
+
+// Largest value a normalized format can hold, 0 for floats
+float volumeFormatSteps(VolumeFormat format) {
+    if (format == VolumeFormatUnorm16) return 65535.0f;
+    if (format == VolumeFormatUnorm8) return 255.0f;
+    return 0.0f;
+}
+
+VolumeRange MeasureVolumeRange(const float* voxels, size_t count) {
+    VolumeRange range = VolumeRange();
+    if (count == 0) return range;
+
+    auto bounds = std::minmax_element(voxels, voxels + count);
+    range.minimum = *bounds.first;
+    range.scale = std::max(*bounds.second - *bounds.first, 1e-6f);
+    return range;
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+// A volume and its mip chain in one VolumeFormat, ready for glTexImage3D
+class QuantizedVolume {
+public:
+    VolumeFormat format = VolumeFormatFloat32;
+    VolumeRange range;
+    int size = 0;
+    std::vector<std::vector<uint8_t>> levels;
+
+    static QuantizedVolume Encode(const float* voxels, int size, const VolumeMipChain* mips, VolumeFormat format, ThreadPool& pool = ThreadPool::Shared());
+    std::vector<float> Decode(int level = 0) const;
+
+    // Bound on the difference between a decoded voxel and its source: a whole step, so
+    // float rounding in the decode is covered along with the half step of quantization
+    float MaximumError() const;
+};
+
+QuantizedVolume QuantizedVolume::Encode(const float* voxels, int size, const VolumeMipChain* mips, VolumeFormat format, ThreadPool& pool) {
+    QuantizedVolume volume = QuantizedVolume();
+    volume.format = format;
+    volume.size = size;
+
+    size_t count = (size_t)size * size * size;
+
+    // Box-filtered mips stay inside the base level's range
+    if (format != VolumeFormatFloat32) volume.range = MeasureVolumeRange(voxels, count);
+
+    int levelCount = 1 + (mips ? (int)mips->size() : 0);
+    volume.levels.resize(levelCount);
+
+    float steps = volumeFormatSteps(format);
+    float inverseScale = 1.0f / volume.range.scale;
+
+    for (int level = 0; level < levelCount; level++) {
+        const float* source = level == 0 ? voxels : (*mips)[level - 1].data();
+        int levelSize = std::max(size >> level, 1);
+        std::vector<uint8_t>& out = volume.levels[level];
+        out.resize((size_t)levelSize * levelSize * levelSize * volumeFormatBytes(format));
+
+        if (format == VolumeFormatFloat32) {
+            memcpy(out.data(), source, out.size());
+            continue;
+        }
+
+        pool.ParallelFor(0, levelSize, 1, [&](int zBegin, int zEnd) {
+            size_t begin = (size_t)zBegin * levelSize * levelSize, end = (size_t)zEnd * levelSize * levelSize;
+            for (size_t i = begin; i < end; i++) {
+                float normalized = std::clamp((source[i] - volume.range.minimum) * inverseScale, 0.0f, 1.0f);
+                uint32_t value = (uint32_t)std::lround(normalized * steps);
+
+                if (format == VolumeFormatUnorm16) {
+                    uint16_t packed = (uint16_t)value;
+                    memcpy(&out[i * 2], &packed, 2);
+                }
+                else {
+                    out[i] = (uint8_t)value;
+                }
+            }
+        });
+    }
+
+    return volume;
+}
+
+std::vector<float> QuantizedVolume::Decode(int level) const {
+
+    const std::vector<uint8_t>& data = levels[level];
+    size_t count = data.size() / volumeFormatBytes(format);
+    std::vector<float> voxels(count);
+
+    if (format == VolumeFormatFloat32) {
+        memcpy(voxels.data(), data.data(), data.size());
+        return voxels;
+    }
+
+    float step = range.scale / volumeFormatSteps(format);
+    for (size_t i = 0; i < count; i++) {
+        uint16_t value;
+        if (format == VolumeFormatUnorm16) memcpy(&value, &data[i * 2], 2);
+        else value = data[i];
+        voxels[i] = range.minimum + value * step;
+    }
+    return voxels;
+}
+
+float QuantizedVolume::MaximumError() const {
+    if (format == VolumeFormatFloat32) return 0.0f;
+    return range.scale / volumeFormatSteps(format);
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+const int bc4BlockBytes = 8;
+
+size_t bc4CompressedSize(int size) {
+    size_t blocks = (size_t)(size + 3) / 4;
+    return blocks * blocks * size * bc4BlockBytes;
+}
+
+// The eight-value BC4 palette (endpoint0 > endpoint1, or all equal)
+void bc4Palette(uint8_t endpoint0, uint8_t endpoint1, float palette[8]) {
+    palette[0] = endpoint0;
+    palette[1] = endpoint1;
+    for (int i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * endpoint0 + i * endpoint1) / 7.0f;
+}
+
+// Blocks are 4x4 texels of one Z-slice, stored slice by slice, row of blocks by row.
+// Texels past the edge of a volume whose size is not a multiple of 4 repeat the edge.
+std::vector<uint8_t> CompressVolumeBC4(const float* voxels, int size, VolumeRange range, ThreadPool& pool = ThreadPool::Shared()) {
+
+    int blocks = (size + 3) / 4;
+    std::vector<uint8_t> compressed(bc4CompressedSize(size));
+    float inverseScale = 255.0f / range.scale;
+
+    pool.ParallelFor(0, size, 1, [&](int zBegin, int zEnd) {
+        for (int z = zBegin; z < zEnd; z++) {
+            for (int by = 0; by < blocks; by++) {
+                for (int bx = 0; bx < blocks; bx++) {
+
+                    float texels[16];
+                    for (int i = 0; i < 16; i++) {
+                        int x = std::min(bx * 4 + i % 4, size - 1), y = std::min(by * 4 + i / 4, size - 1);
+                        float value = voxels[x + (size_t)y * size + (size_t)z * size * size];
+                        texels[i] = std::clamp((value - range.minimum) * inverseScale, 0.0f, 255.0f);
+                    }
+
+                    // Endpoints bracket the block so every texel lies between them
+                    float low = *std::min_element(texels, texels + 16), high = *std::max_element(texels, texels + 16);
+                    uint8_t endpoint0 = (uint8_t)std::ceil(high), endpoint1 = (uint8_t)std::floor(low);
+
+                    float palette[8];
+                    bc4Palette(endpoint0, endpoint1, palette);
+
+                    uint64_t indices = 0;
+                    if (endpoint0 != endpoint1) {
+                        for (int i = 0; i < 16; i++) {
+                            int best = 0;
+                            for (int entry = 1; entry < 8; entry++) {
+                                if (std::fabs(palette[entry] - texels[i]) < std::fabs(palette[best] - texels[i])) best = entry;
+                            }
+                            indices |= (uint64_t)best << (3 * i);
+                        }
+                    }
+
+                    uint8_t* block = &compressed[(((size_t)z * blocks + by) * blocks + bx) * bc4BlockBytes];
+                    block[0] = endpoint0;
+                    block[1] = endpoint1;
+                    for (int i = 0; i < 6; i++) block[2 + i] = (uint8_t)(indices >> (8 * i));
+                }
+            }
+        }
+    });
+
+    return compressed;
+}
+
+std::vector<float> DecompressVolumeBC4(const uint8_t* compressed, int size, VolumeRange range, ThreadPool& pool = ThreadPool::Shared()) {
+
+    int blocks = (size + 3) / 4;
+    std::vector<float> voxels((size_t)size * size * size);
+    float scale = range.scale / 255.0f;
+
+    pool.ParallelFor(0, size, 1, [&](int zBegin, int zEnd) {
+        for (int z = zBegin; z < zEnd; z++) {
+            for (int by = 0; by < blocks; by++) {
+                for (int bx = 0; bx < blocks; bx++) {
+
+                    const uint8_t* block = &compressed[(((size_t)z * blocks + by) * blocks + bx) * bc4BlockBytes];
+                    float palette[8];
+                    bc4Palette(block[0], block[1], palette);
+
+                    uint64_t indices = 0;
+                    for (int i = 0; i < 6; i++) indices |= (uint64_t)block[2 + i] << (8 * i);
+
+                    for (int i = 0; i < 16; i++) {
+                        int x = bx * 4 + i % 4, y = by * 4 + i / 4;
+                        if (x >= size || y >= size) continue;
+                        voxels[x + (size_t)y * size + (size_t)z * size * size] = range.minimum + palette[(indices >> (3 * i)) & 7] * scale;
+                    }
+                }
+            }
+        }
+    });
+
+    return voxels;
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+// How far a decoded volume is from its float source, both in raw noise and in the
+// density the cloud shader derives from it
+struct VolumeError {
+    double maximum = 0.0, rms = 0.0, psnr = 0.0;
+    double densityMaximum = 0.0;
+};
+
+VolumeError MeasureVolumeError(const float* source, const float* decoded, size_t count, VolumeRange range) {
+    VolumeError error = VolumeError();
+
+    auto density = [](float noise) {
+        noise = std::max(noise, 0.0f);
+        return std::clamp(noise * noise * 3.0f - 0.2f, 0.0f, 1.0f) * 2.5f;
+    };
+
+    double squared = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double difference = std::fabs((double)source[i] - decoded[i]);
+        error.maximum = std::max(error.maximum, difference);
+        error.densityMaximum = std::max(error.densityMaximum, (double)std::fabs(density(source[i]) - density(decoded[i])));
+        squared += difference * difference;
+    }
+
+    error.rms = count ? std::sqrt(squared / count) : 0.0;
+    error.psnr = error.rms > 0.0 ? 20.0 * std::log10(range.scale / error.rms) : INFINITY;
+    return error;
+}
+
+#endif /* volume_quantize_h */
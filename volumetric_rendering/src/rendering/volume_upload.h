@@ -0,0 +1,208 @@
+//
+//  volume_upload.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef volume_upload_h
+#define volume_upload_h
+
+// Texture format and pixel type for a VolumeFormat
+void volumeTextureFormat(VolumeFormat format, GLint& internalFormat, GLenum& type) {
+    internalFormat = GL_R32F;
+    type = GL_FLOAT;
+    if (format == VolumeFormatUnorm16) {
+        internalFormat = GL_R16;
+        type = GL_UNSIGNED_SHORT;
+    }
+    if (format == VolumeFormatUnorm8) {
+        internalFormat = GL_R8;
+        type = GL_UNSIGNED_BYTE;
+    }
+}
+
+// Streams a volume into a 3D texture over several frames. Each Step() copies at most
+// `byteBudget` bytes into one of two pixel buffer objects and issues a glTexSubImage3D
+// from it, so the copy to the GPU overlaps with the next frame instead of stalling
+// this one. Whole Z-slices go up together; a slice larger than the budget is split
+// into rows. Mip levels, if given, follow the base level.
+class VolumeUpload {
+public:
+    static VolumeUpload Create();
+
+    void Begin(uint32_t texture, int size, SharedVoxels voxels,
+               std::shared_ptr<const VolumeMipChain> mips = nullptr);
+    void Begin(uint32_t texture, std::shared_ptr<const QuantizedVolume> volume);
+    bool Step(size_t byteBudget);
+    bool Active();
+
+private:
+    uint32_t pixelBuffers[2];
+    size_t pixelBufferSize[2];
+    int nextPixelBuffer;
+
+    uint32_t texture;
+    int size;
+    VolumeFormat format;
+
+    // Start of every level, kept alive by whichever owner was passed to Begin()
+    std::vector<const uint8_t*> levels;
+    std::shared_ptr<const void> voxels, mips;
+
+    int level, slice, row;
+    bool active;
+
+    void Allocate();
+};
+
+VolumeUpload VolumeUpload::Create() {
+    VolumeUpload upload = VolumeUpload();
+
+    glGenBuffers(2, upload.pixelBuffers);
+    upload.pixelBufferSize[0] = upload.pixelBufferSize[1] = 0;
+    upload.nextPixelBuffer = 0;
+    upload.active = false;
+
+    return upload;
+}
+
+void VolumeUpload::Begin(uint32_t texture, int size, SharedVoxels voxels,
+                         std::shared_ptr<const VolumeMipChain> mips) {
+
+    this->texture = texture;
+    this->size = size;
+    format = VolumeFormatFloat32;
+
+    levels = { (const uint8_t*)voxels.get() };
+    if (mips) for (const std::vector<float>& mip : *mips) levels.push_back((const uint8_t*)mip.data());
+
+    this->voxels = std::move(voxels);
+    this->mips = std::move(mips);
+    Allocate();
+}
+
+void VolumeUpload::Begin(uint32_t texture, std::shared_ptr<const QuantizedVolume> volume) {
+
+    this->texture = texture;
+    size = volume->size;
+    format = volume->format;
+
+    levels.clear();
+    for (const std::vector<uint8_t>& data : volume->levels) levels.push_back(data.data());
+
+    voxels = std::move(volume);
+    mips.reset();
+    Allocate();
+}
+
+void VolumeUpload::Allocate() {
+
+    level = 0;
+    slice = 0;
+    row = 0;
+    active = true;
+
+    int mipLevels = (int)levels.size() - 1;
+    GLint internalFormat;
+    GLenum type;
+    volumeTextureFormat(format, internalFormat, type);
+
+    // Only allocate here; the contents arrive through Step()
+    glBindTexture(GL_TEXTURE_3D, texture);
+    for (int i = 0; i <= mipLevels; i++) {
+        int levelSize = std::max(size >> i, 1);
+        glTexImage3D(GL_TEXTURE_3D, i, internalFormat, levelSize, levelSize, levelSize, 0, GL_RED, type, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, mipLevels);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, mipLevels > 0 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
+
+// Returns true once the last byte has been submitted
+bool VolumeUpload::Step(size_t byteBudget) {
+
+    if (!active) return false;
+
+    int size = std::max(this->size >> level, 1);
+    const uint8_t* levelData = levels[level];
+
+    GLint internalFormat;
+    GLenum type;
+    volumeTextureFormat(format, internalFormat, type);
+
+    size_t rowBytes = size * volumeFormatBytes(format),
+           sliceBytes = rowBytes * size;
+
+    int slices = 0, rows = 0;
+    if (row == 0 && byteBudget >= sliceBytes) {
+        slices = std::min((int)(byteBudget / sliceBytes), size - slice);
+    }
+    else {
+        rows = std::min(std::max((int)(byteBudget / rowBytes), 1), size - row);
+    }
+
+    size_t bytes = slices > 0 ? slices * sliceBytes : rows * rowBytes;
+    const uint8_t* source = levelData + ((size_t)slice * size + row) * rowBytes;
+
+    // Alternate between two buffers and orphan the storage, so mapping never waits
+    // on the transfer that was started last frame
+    int index = nextPixelBuffer;
+    nextPixelBuffer = 1 - nextPixelBuffer;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffers[index]);
+    if (pixelBufferSize[index] < bytes) pixelBufferSize[index] = bytes;
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, pixelBufferSize[index], nullptr, GL_STREAM_DRAW);
+
+    // If the driver refuses the mapping, fall back to a plain client-memory upload
+    const void* pixels = (const void*)0;
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped) {
+        memcpy(mapped, source, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    else {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        pixels = source;
+    }
+
+    // Rows of 8- and 16-bit mip levels are not 4-byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_3D, texture);
+    if (slices > 0) {
+        glTexSubImage3D(GL_TEXTURE_3D, level, 0, 0, slice, size, size, slices, GL_RED, type, pixels);
+        slice += slices;
+    }
+    else {
+        glTexSubImage3D(GL_TEXTURE_3D, level, 0, row, slice, size, rows, 1, GL_RED, type, pixels);
+        row += rows;
+        if (row == size) {
+            row = 0;
+            slice++;
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (slice < size) return false;
+
+    // On to the next mip level, if there is one
+    slice = 0;
+    level++;
+    if (level < (int)levels.size()) return false;
+
+    active = false;
+    levels.clear();
+    voxels.reset();
+    mips.reset();
+    return true;
+}
+
+bool VolumeUpload::Active() {
+    return active;
+}
+
+#endif /* volume_upload_h */
@@ -0,0 +1,162 @@
+//
+//  wind_volume.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef wind_volume_h
+#define wind_volume_h
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Clouds drifting with the wind. The texture is a toroidal size³ window over the
+// unbounded field of GenerateNoiseWindow: texel t of an axis holds the voxel congruent
+// to t modulo size. As the window moves, only the slabs of voxels it newly covers are
+// generated, and written with glTexSubImage3D over the slabs it left behind, so the
+// work per frame follows the wind speed rather than size³. The shader samples with
+// GL_REPEAT at uv + WrapOffset(); the edge fade of the box hides the seam where the
+// newest slab meets the oldest.
+//
+// Mips, macrocells and the baked transmittance would all have to follow every slab,
+// so the texture has a single level and the WIND_VOLUME shader path neither skips
+// macrocells nor reads transmittance; it marches toward the light itself.
+class WindVolume {
+public:
+    NoiseParameters parameters;
+    glm::vec3 wind;             // voxels per second
+    uint32_t texture;
+
+    static WindVolume Create(const NoiseParameters& parameters, glm::vec3 wind);
+    static glm::vec3 WindFromEnvironment();
+
+    void Update();
+    glm::vec3 WrapOffset();
+
+private:
+    double position[3];         // window start in voxels of the field
+    int origin[3];              // first voxel of the window in the texture, floor(position)
+    std::vector<float> slab;
+    std::chrono::steady_clock::time_point lastUpdate;
+
+    int Advance(int axis, int target);
+    void Write(const int begin[3], const int extent[3]);
+};
+
+WindVolume WindVolume::Create(const NoiseParameters& parameters, glm::vec3 wind) {
+    WindVolume volume = WindVolume();
+    volume.parameters = parameters;
+    volume.wind = wind;
+    volume.lastUpdate = std::chrono::steady_clock::now();
+
+    int size = parameters.size;
+    for (int axis = 0; axis < 3; axis++) {
+        volume.position[axis] = 0.0;
+        volume.origin[axis] = 0;
+    }
+
+    glGenTextures(1, &volume.texture);
+    glBindTexture(GL_TEXTURE_3D, volume.texture);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, size, size, size, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+
+    ScopedCpuTimer timer("startup volume");
+    const int begin[3] = { 0, 0, 0 }, extent[3] = { size, size, size };
+    volume.Write(begin, extent);
+
+    return volume;
+}
+
+// VOLUMETRIC_WIND="x y z" in voxels per second; unset or zero keeps the volume still
+glm::vec3 WindVolume::WindFromEnvironment() {
+    glm::vec3 wind = glm::vec3(0.0f);
+    const char* setting = std::getenv("VOLUMETRIC_WIND");
+    if (setting) sscanf(setting, "%f %f %f", &wind.x, &wind.y, &wind.z);
+    return wind;
+}
+
+// Called once per frame. Moves the window by the wind since the last call and fills
+// whatever whole voxels it crossed.
+void WindVolume::Update() {
+
+    auto now = std::chrono::steady_clock::now();
+    // A long stall (a breakpoint, a dragged window) should not turn into a full regeneration
+    double seconds = std::min(std::chrono::duration<double>(now - lastUpdate).count(), 0.1);
+    lastUpdate = now;
+
+    auto start = now;
+    int voxels = 0;
+
+    for (int axis = 0; axis < 3; axis++) {
+        position[axis] += wind[axis] * seconds;
+        int target = (int)std::floor(position[axis]);
+        if (target != origin[axis]) voxels += Advance(axis, target);
+    }
+
+    if (voxels == 0) return;
+
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    profiler.AddCpu("wind", milliseconds);
+    telemetry.Generation("wind", voxels, milliseconds);
+}
+
+// Where the box's uv = 0 corner is in the texture; GL_REPEAT makes only the fraction matter
+glm::vec3 WindVolume::WrapOffset() {
+    glm::vec3 offset;
+    for (int axis = 0; axis < 3; axis++) {
+        double window = position[axis] / parameters.size;
+        offset[axis] = (float)(window - std::floor(window));
+    }
+    return offset;
+}
+
+// Moves the window start along one axis to `target` and generates the voxels that came
+// into view: ahead of the old window when moving forward, behind it when moving back,
+// and all of it when the window moved by its whole size or more. Their texels form one
+// slab that wraps around the texture at most once. Returns the number of voxels written.
+int WindVolume::Advance(int axis, int target) {
+
+    int size = parameters.size;
+    int delta = target - origin[axis];
+    int count = std::min(std::abs(delta), size);
+    int first = delta > 0 ? std::max(origin[axis] + size, target) : target;
+    origin[axis] = target;
+
+    int texel = ((first % size) + size) % size;
+    int voxels = count * size * size;
+
+    while (count > 0) {
+        int run = std::min(count, size - texel);
+
+        int begin[3] = { 0, 0, 0 }, extent[3] = { size, size, size };
+        begin[axis] = texel;
+        extent[axis] = run;
+        Write(begin, extent);
+
+        texel = 0;
+        count -= run;
+    }
+    return voxels;
+}
+
+void WindVolume::Write(const int begin[3], const int extent[3]) {
+
+    slab.resize((size_t)extent[0] * extent[1] * extent[2]);
+    GenerateNoiseWindow(parameters, origin, begin, extent, slab.data());
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_3D, texture);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, begin[0], begin[1], begin[2], extent[0], extent[1], extent[2], GL_RED, GL_FLOAT, slab.data());
+}
+
+#endif /* wind_volume_h */
@@ -8,14 +8,35 @@ uniform sampler2D albedo;
 
 // ----- 3D Noise Texture ----- //
 uniform sampler3D noiseTexture;
+uniform vec2 noiseRange;        // noise = noiseRange.x + texel * noiseRange.y (see QuantizedVolume)
 
-// ----- Output Color ----- //
-out vec4 fragc;
+#ifdef WIND_VOLUME
+// ----- Toroidal window drifting with the wind (see WindVolume), GL_REPEAT ----- //
+uniform vec3 wrapOffset;
+#endif
+
+// ----- Min/max noise per macrocell (see MacrocellGrid) ----- //
+uniform sampler3D macrocellTexture;
 
-uniform mat4 inverseProjection;
-uniform mat4 inverseLookAt;
-uniform vec3 cameraPosition;
-uniform vec2 screenSize;
+// ----- Output Color ----- //
+layout (location = 0) out vec4 fragc;
+
+#ifdef CLOUD_TARGET
+// ----- Reduced-resolution target (see CloudReprojection) ----- //
+layout (location = 1) out vec4 cloudDistance;
+uniform int cloudScale;
+uniform vec2 cloudJitter;
+#endif
+
+// ----- Per-frame camera, shared by every program ----- //
+layout (std140) uniform CameraBlock {
+    mat4 projection;
+    mat4 lookAt;
+    mat4 inverseProjection;
+    mat4 inverseLookAt;
+    vec3 cameraPosition;
+    vec2 screenSize;
+};
 
 in prop {
     vec3 normal;
@@ -23,13 +44,93 @@ in prop {
     vec2 uv;
 } fs_in;
 
-// ----- Cloud Box ----- //
-vec3 boxPosition = vec3(0.0, 0.0, -10.0);
-vec3 halfSize = vec3(2.0, 2.0, 2.0) * 2.25;
-vec3 boxMin = boxPosition - halfSize;
-vec3 boxMax = boxPosition + halfSize;
+// ----- Cloud Box and Light ----- //
+uniform vec3 boxPosition;
+uniform vec3 halfSize;
+uniform vec3 lightDirection;
+
+// Set at the start of main()
+vec3 boxMin;
+vec3 boxMax;
+
+// ----- Transmittance toward the light (see ComputeTransmittanceVolume) ----- //
+uniform sampler3D transmittanceTexture;
+
+#ifdef SPARSE_VOLUME
+// ----- Sparse brick volume (see SparseVolume); the box is the whole virtual volume ----- //
+uniform usampler3D pageTable;       // per brick: atlas slot in xyz, BrickState in w
+uniform sampler3D brickAtlas;
+uniform float voxelWorldSize;
+uniform float densityScale;         // optical thickness of a voxel, in dense-box units
+
+const float brickSize = 32.0;
+const float brickApron = 1.0;
+#endif
+
+#ifdef CLOUD_SCENE
+// ----- Cloud volumes and their BVH (see CloudScene); the box is the BVH root ----- //
+uniform samplerBuffer sceneNodes;       // two texels per node: (min, first), (max, count)
+uniform samplerBuffer sceneVolumes;     // five texels per volume, see CloudScene::VolumeTexels
+
+const int maxIntervals = 8;
+const int maxStackDepth = 24;
+#endif
+
+#ifdef ATMOSPHERE_LUT
+// ----- Precomputed sky (see SkyAtmosphere); lengths in kilometres ----- //
+uniform sampler2D transmittanceLUT;
+uniform sampler2D skyViewLUT;
+uniform vec3 sunDirection;
+uniform vec3 atmosphereRadii;       // ground, top of the atmosphere, observer
+uniform float skyExposure;
+
+// transmittanceLutUV in atmosphere.h
+vec2 transmittanceUV(float r, float mu) {
+    float bottom = atmosphereRadii.x, top = atmosphereRadii.y;
+    float horizon = sqrt(top * top - bottom * bottom);
+    float rho = sqrt(max(r * r - bottom * bottom, 0.0));
+
+    float rayLength = max(-r * mu + sqrt(max(r * r * (mu * mu - 1.0) + top * top, 0.0)), 0.0);
+    float minimum = top - r, maximum = rho + horizon;
+    return vec2((rayLength - minimum) / (maximum - minimum), rho / horizon);
+}
+
+// The inverse of skyViewZenithAngle in atmosphere.h, with the azimuth measured from the sun
+vec2 skyViewUV(vec3 direction) {
+    float r = atmosphereRadii.z, bottom = atmosphereRadii.x;
+    float beta = acos(sqrt(r * r - bottom * bottom) / r);
+    float horizonZenith = 3.14159265 - beta;
+
+    float zenithAngle = acos(clamp(direction.y, -1.0, 1.0));
+    float v = zenithAngle < horizonZenith ? 0.5 - 0.5 * sqrt(1.0 - zenithAngle / horizonZenith)
+                                          : 0.5 + 0.5 * sqrt((zenithAngle - horizonZenith) / beta);
+
+    float azimuth = 1.0;
+    if (length(direction.xz) > 1e-5 && length(sunDirection.xz) > 1e-5) {
+        azimuth = dot(normalize(direction.xz), normalize(sunDirection.xz));
+    }
+    return vec2(sqrt(clamp(0.5 - 0.5 * azimuth, 0.0, 1.0)), v);
+}
+
+// Sunlight reaching the observer, black once the sun is behind the planet
+vec3 atmosphereSunColor() {
+    float r = atmosphereRadii.z, mu = sunDirection.y, bottom = atmosphereRadii.x;
+    if (mu < 0.0 && r * r * (mu * mu - 1.0) + bottom * bottom >= 0.0) return vec3(0.0);
+    return texture(transmittanceLUT, transmittanceUV(r, mu)).rgb;
+}
+
+vec3 atmosphereSky(vec3 direction) {
+    vec3 luminance = texture(skyViewLUT, skyViewUV(direction)).rgb;
+
+    // The sun's disk, about half a degree across
+    if (dot(direction, sunDirection) > 0.99996) luminance += atmosphereSunColor() * 20.0;
+    return 1.0 - exp(-luminance * skyExposure);
+}
+#endif
 
+// Sky and sun light on the clouds; from the sky tables when there are any (skyLighting)
 vec3 cloudAmbient = vec3(0.2, 0.3, 0.6);
+vec3 sunColor = vec3(1.0);
 
 
 vec3 zenithColor = vec3(0.05, 0.15, 0.4);
@@ -72,31 +173,316 @@ float phaseSchlick(float cosTheta, float k) {
 // ----------------------------------------------------------- //
 // ----------------------------------------------------------- //
 
-// Compute the light from a point in the cloud
-float computeLightTransmittance(vec3 p, vec3 lightDirection) {
-    float t = 0.0;
+// Where a point of the box is in the noise texture
+vec3 windowUV(vec3 uv) {
+#ifdef WIND_VOLUME
+    return uv + wrapOffset;
+#else
+    return uv;
+#endif
+}
+
+#ifdef WIND_VOLUME
+// The drifting volume has no baked transmittance, so march toward the light with the
+// model of ComputeTransmittanceVolume, in 8 steps twice as long
+float computeLightTransmittance(vec3 uv) {
+    const int steps = 8;
+    const float lightStep = 0.1;
+    vec3 uvStep = lightDirection * lightStep / (2.0 * halfSize);
     float attenuation = 0.0;
-    const float stepSize = 0.05;
-    
-    // use ray marching to calculate the attenuation
-    for (int i = 0; i < 16; ++i) {
-        vec3 samplePos = p + lightDirection * t;
-        vec3 uv = (samplePos - boxMin) / (boxMax - boxMin);
-        if (any(lessThan(uv, vec3(0.0))) || any(greaterThan(uv, vec3(1.0))))
-            break;
 
-        float sampledNoise = texture(noiseTexture, uv).r;
-        float localDensity = clamp(pow(sampledNoise, 1.4) * 1.2 - 0.2, 0.0, 1.0);
-        attenuation += localDensity * stepSize;
-        t += stepSize;
-    }
+    for (int i = 0; i < steps; i++) {
+        if (any(lessThan(uv, vec3(0.0))) || any(greaterThan(uv, vec3(1.0)))) break;
 
+        float sampledNoise = max(noiseRange.x + textureLod(noiseTexture, windowUV(uv), 0.0).r * noiseRange.y, 0.0);
+        attenuation += clamp(pow(sampledNoise, 1.4) * 1.2 - 0.2, 0.0, 1.0) * lightStep;
+        uv += uvStep;
+    }
     return exp(-attenuation * 10.1);
 }
+#else
+// Light reaching a point in the cloud, precomputed per voxel on the CPU with the
+// same 16-step march toward the light that used to run here
+float computeLightTransmittance(vec3 uv) {
+    return texture(transmittanceTexture, uv).r;
+}
+#endif
 
 // ----------------------------------------------------------- //
 // ----------------------------------------------------------- //
 
+// If the macrocell around uv cannot reach the density threshold, returns the distance
+// along the ray to where it is left; otherwise 0. The pyramid level is the coarser of
+// the two mips textureLod blends at `lod` (MacrocellGrid::Level), and the last cell on
+// each axis runs to the far side (MacrocellGrid::CellBounds). The remap is the one in
+// rayMarch, taken at the cell's maximum with the edge fade at its largest (1.0).
+float macrocellSkip(vec3 rayOrigin, vec3 rayDirection, vec3 uv, float lod) {
+    const float macrocellSize = 8.0;        // voxels per level-0 cell, as in macrocells.h
+
+    int level = int(ceil(lod));
+    ivec3 cells = textureSize(macrocellTexture, level);
+    float span = macrocellSize * exp2(float(level)) / float(textureSize(noiseTexture, 0).x);
+    ivec3 cell = clamp(ivec3(uv / span), ivec3(0), cells - 1);
+
+    float maximum = texelFetch(macrocellTexture, cell, level).g;
+    float density = clamp(pow(maximum, 2.0) * 3.0 - 0.2, 0.0, 1.0) * 2.5;
+    if (density >= 0.01) return 0.0;
+
+    vec3 low = min(vec3(cell) * span, vec3(1.0));
+    vec3 high = mix(min(vec3(cell + 1) * span, vec3(1.0)), vec3(1.0), equal(cell, cells - 1));
+    vec3 cellMin = boxMin + (boxMax - boxMin) * low;
+    vec3 cellMax = boxMin + (boxMax - boxMin) * high;
+
+    vec3 exit = (mix(cellMin, cellMax, step(0.0, rayDirection)) - rayOrigin) / rayDirection;
+    return min(min(exit.x, exit.y), exit.z);
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+#ifdef SPARSE_VOLUME
+
+// Noise at a world position from the brick atlas, or -1 where the brick holding it is
+// not resident (not loaded yet, evicted, or empty and never allocated)
+float sparseNoise(vec3 position) {
+    vec3 voxel = (position - boxMin) / voxelWorldSize;
+    ivec3 brick = ivec3(floor(voxel / brickSize));
+    if (any(lessThan(brick, ivec3(0))) || any(greaterThanEqual(brick, textureSize(pageTable, 0)))) return -1.0;
+
+    uvec4 entry = texelFetch(pageTable, brick, 0);
+    if (entry.a != 1u) return -1.0;
+
+    vec3 texel = vec3(entry.xyz) * (brickSize + 2.0 * brickApron) + brickApron + (voxel - vec3(brick) * brickSize);
+    return textureLod(brickAtlas, texel / vec3(textureSize(brickAtlas, 0)), 0.0).r;
+}
+
+// Distance along the ray to where it leaves the brick around position
+float brickExit(vec3 rayOrigin, vec3 rayDirection, vec3 position) {
+    float brickWorldSize = brickSize * voxelWorldSize;
+    vec3 brickMin = boxMin + floor((position - boxMin) / brickWorldSize) * brickWorldSize;
+
+    vec3 exit = (brickMin + step(0.0, rayDirection) * brickWorldSize - rayOrigin) / rayDirection;
+    return min(min(exit.x, exit.y), exit.z);
+}
+
+// There is no baked transmittance for bricks, so march a few steps toward the light
+// with the model ComputeTransmittanceVolume uses for the dense volume
+float sparseLightTransmittance(vec3 position) {
+    const int steps = 6;
+    float lightStep = 2.0 * voxelWorldSize;
+    float attenuation = 0.0;
+
+    for (int i = 1; i <= steps; i++) {
+        float sampledNoise = sparseNoise(position + lightDirection * lightStep * float(i));
+        if (sampledNoise <= 0.0) continue;
+        attenuation += clamp(pow(sampledNoise, 1.4) * 1.2 - 0.2, 0.0, 1.0) * lightStep * densityScale;
+    }
+    return exp(-attenuation * 10.1);
+}
+
+// rayMarch over the sparse volume: whole bricks that are not resident are skipped,
+// steps are a voxel long near the camera and a pixel footprint wide farther out
+float rayMarch(vec3 rayOrigin, vec3 rayDirection, out vec3 hitPosition, out vec3 cloudColor) {
+
+    float tNear, tFar;
+    if (!intersectBox(rayOrigin, rayDirection, tNear, tFar)) {
+        hitPosition = vec3(0.0);
+        cloudColor = vec3(0.0);
+        return -1.0;
+    }
+
+    const float k = 0.5;
+    const int maxSteps = 256;
+    float pixelAngle = 2.0 / (projection[1][1] * screenSize.y);
+    float phase = phaseSchlick(dot(rayDirection, lightDirection), k);
+
+    float t = max(tNear, 0.0);
+    float opacity = 0.0;
+    vec3 color = vec3(0.0);
+
+    for (int i = 0; i < maxSteps && t < tFar; ++i) {
+
+        vec3 rayPosition = rayOrigin + rayDirection * t;
+        float stride = max(voxelWorldSize, t * pixelAngle);
+
+        float sampledNoise = sparseNoise(rayPosition);
+        if (sampledNoise < 0.0) {
+            t = max(brickExit(rayOrigin, rayDirection, rayPosition), t) + 0.01 * voxelWorldSize;
+            continue;
+        }
+
+        float density = clamp(pow(sampledNoise, 2.0) * 3.0 - 0.2, 0.0, 1.0) * 2.5;
+        if (density < 0.01) {
+            t += stride * 2.0;
+            continue;
+        }
+
+        float transmittance = sparseLightTransmittance(rayPosition);
+        vec3 scatter = sunColor * transmittance * phase * density + cloudAmbient * density;
+        float thickness = stride * densityScale;
+
+        color += (1.0 - opacity) * scatter * thickness;
+        opacity += (1.0 - opacity) * density * thickness;
+
+        if (opacity >= 0.99) break;
+        t += stride;
+    }
+
+    if (opacity > 0.0) {
+        hitPosition = rayOrigin + rayDirection * t;
+        cloudColor = color * 1.75;
+        return opacity;
+    }
+    hitPosition = vec3(0.0);
+    cloudColor = vec3(0.0);
+    return -1.0;
+}
+
+#elif defined(CLOUD_SCENE)
+
+bool intersectBounds(vec3 rayOrigin, vec3 inverseDirection, vec3 lower, vec3 upper, out float tNear, out float tFar) {
+    vec3 t0 = (lower - rayOrigin) * inverseDirection;
+    vec3 t1 = (upper - rayOrigin) * inverseDirection;
+
+    vec3 tmin = min(t0, t1);
+    vec3 tmax = max(t0, t1);
+
+    tNear = max(max(tmin.x, tmin.y), tmin.z);
+    tFar  = min(min(tmax.x, tmax.y), tmax.z);
+
+    return tFar >= max(tNear, 0.0);
+}
+
+// Position inside a volume's box, [0, 1] on every axis
+vec3 sceneVolumeUV(int volume, vec3 position) {
+    vec4 p = vec4(position, 1.0);
+    return vec3(dot(texelFetch(sceneVolumes, volume * 5 + 0), p),
+                dot(texelFetch(sceneVolumes, volume * 5 + 1), p),
+                dot(texelFetch(sceneVolumes, volume * 5 + 2), p)) * 0.5 + 0.5;
+}
+
+// rayMarch over the scene. The BVH is walked once to collect the entry and exit of every
+// volume the ray crosses, sorted by entry; only those intervals are marched, so the
+// cost follows the volumes on the ray rather than the size of the scene. Overlapping
+// volumes are composited one after the other in entry order.
+float rayMarch(vec3 rayOrigin, vec3 rayDirection, out vec3 hitPosition, out vec3 cloudColor) {
+
+    float starts[maxIntervals];
+    float ends[maxIntervals];
+    int volumes[maxIntervals];
+    int intervals = 0;
+
+    vec3 inverseDirection = 1.0 / rayDirection;
+    int stack[maxStackDepth];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        int node = stack[--top];
+        vec4 lower = texelFetch(sceneNodes, node * 2);
+        vec4 upper = texelFetch(sceneNodes, node * 2 + 1);
+
+        float tNear, tFar;
+        if (!intersectBounds(rayOrigin, inverseDirection, lower.xyz, upper.xyz, tNear, tFar)) continue;
+
+        int first = int(lower.w), count = int(upper.w);
+        if (count == 0) {
+            if (top + 2 <= maxStackDepth) {
+                stack[top++] = first + 1;
+                stack[top++] = first;
+            }
+            continue;
+        }
+
+        for (int volume = first; volume < first + count && intervals < maxIntervals; volume++) {
+            vec4 row0 = texelFetch(sceneVolumes, volume * 5 + 0),
+                 row1 = texelFetch(sceneVolumes, volume * 5 + 1),
+                 row2 = texelFetch(sceneVolumes, volume * 5 + 2);
+
+            vec3 localOrigin = vec3(dot(row0, vec4(rayOrigin, 1.0)), dot(row1, vec4(rayOrigin, 1.0)), dot(row2, vec4(rayOrigin, 1.0)));
+            vec3 localDirection = vec3(dot(row0.xyz, rayDirection), dot(row1.xyz, rayDirection), dot(row2.xyz, rayDirection));
+
+            // The transform is affine, so t along the local ray is t along the world ray
+            if (!intersectBounds(localOrigin, 1.0 / localDirection, vec3(-1.0), vec3(1.0), tNear, tFar)) continue;
+            tNear = max(tNear, 0.0);
+
+            int i = intervals++;
+            while (i > 0 && starts[i - 1] > tNear) {
+                starts[i] = starts[i - 1];
+                ends[i] = ends[i - 1];
+                volumes[i] = volumes[i - 1];
+                i--;
+            }
+            starts[i] = tNear;
+            ends[i] = tFar;
+            volumes[i] = volume;
+        }
+    }
+
+    const float k = 0.5;
+    const float maxLod = 3.0;
+    const int maxSteps = 256;
+
+    float pixelAngle = 2.0 / (projection[1][1] * screenSize.y);
+    float phase = phaseSchlick(dot(rayDirection, lightDirection), k);
+
+    float t = 0.0;
+    float opacity = 0.0;
+    vec3 color = vec3(0.0);
+    int steps = 0;
+
+    for (int i = 0; i < intervals && opacity < 0.99; i++) {
+
+        int volume = volumes[i];
+        vec4 slice = texelFetch(sceneVolumes, volume * 5 + 3);        // noise origin, noise extent
+        vec4 material = texelFetch(sceneVolumes, volume * 5 + 4);     // density scale, step size, voxel size
+
+        for (t = starts[i]; t < ends[i] && steps < maxSteps; steps++) {
+
+            vec3 rayPosition = rayOrigin + rayDirection * t;
+            vec3 uv = clamp(sceneVolumeUV(volume, rayPosition), 0.0, 1.0);
+
+            float lod = clamp(log2(max(t * pixelAngle / material.z, 1.0)), 0.0, maxLod);
+            float stride = material.y * exp2(lod);
+
+            vec3 noiseUV = slice.xyz + uv * slice.w;
+            float sampledNoise = noiseRange.x + textureLod(noiseTexture, noiseUV, lod).r * noiseRange.y;
+
+            const float margin = 0.1;
+            vec3 fade = smoothstep(0.0, margin, uv) * (1.0 - smoothstep(1.0 - margin, 1.0, uv));
+
+            float density = clamp(pow(sampledNoise, 2.0) * 3.0 - 0.2, 0.0, 1.0);
+            density *= fade.x * fade.y * fade.z * 2.5;
+
+            if (density < 0.01) {
+                t += stride * 2.0;
+                continue;
+            }
+
+            float transmittance = texture(transmittanceTexture, noiseUV).r;
+            vec3 scatter = sunColor * transmittance * phase * density + cloudAmbient * density;
+            float thickness = stride * material.x;
+
+            color += (1.0 - opacity) * scatter * thickness;
+            opacity += (1.0 - opacity) * density * thickness;
+
+            if (opacity >= 0.99) break;
+            t += stride;
+        }
+    }
+
+    if (opacity > 0.0) {
+        hitPosition = rayOrigin + rayDirection * t;
+        cloudColor = color * 1.75;
+        return opacity;
+    }
+    hitPosition = vec3(0.0);
+    cloudColor = vec3(0.0);
+    return -1.0;
+}
+
+#else
+
 // Main ray marching function
 float rayMarch(vec3 rayOrigin, vec3 rayDirection, out vec3 hitPosition, out vec3 cloudColor) {
     
@@ -111,7 +497,11 @@ float rayMarch(vec3 rayOrigin, vec3 rayDirection, out vec3 hitPosition, out vec3
     // Constants
     const float stepSize = 0.05;
     const float k = 0.5;
-    const vec3 lightDirection = normalize(vec3(1.0, 1.0, 0.5));
+    
+    // Width of a pixel one unit from the camera, and of a voxel of the full-resolution volume
+    float pixelAngle = 2.0 / (projection[1][1] * screenSize.y);
+    float voxelSize = 2.0 * halfSize.x / float(textureSize(noiseTexture, 0).x);
+    const float maxLod = 3.0;       // deepest level of the macrocell pyramid (macrocellLevels - 1); raise both together
     
     int maxSteps = int(min(128.0, (tFar - tNear) / stepSize));
     float t = max(tNear, 0.0);
@@ -130,8 +520,22 @@ float rayMarch(vec3 rayOrigin, vec3 rayDirection, out vec3 hitPosition, out vec3
             continue;
         }
         
+        // Once a pixel covers more than a voxel, read the mip level that matches its
+        // footprint and stretch the step by the same factor
+        float lod = clamp(log2(max(t * pixelAngle / voxelSize, 1.0)), 0.0, maxLod);
+        float stride = stepSize * exp2(lod);
+        
+#ifndef WIND_VOLUME
+        // Jump whole macrocells that are empty, staying on the same step grid
+        float cellExit = macrocellSkip(rayOrigin, rayDirection, uv, lod);
+        if (cellExit > t) {
+            t += ceil((cellExit - t) / stride) * stride;
+            continue;
+        }
+#endif
+        
         // Sample the from the 3D noise (Voronoi noise + Layered noise)
-        float sampledNoise = texture(noiseTexture, uv).r;
+        float sampledNoise = noiseRange.x + textureLod(noiseTexture, windowUV(uv), lod).r * noiseRange.y;
 
         
         float margin = 0.1;
@@ -148,26 +552,26 @@ float rayMarch(vec3 rayOrigin, vec3 rayDirection, out vec3 hitPosition, out vec3
         density *= edgeFade * 2.5;
         
         if (density < 0.01) {
-            t += stepSize * 2.0;
+            t += stride * 2.0;
             continue;
         }
         
         // Calculate the light penetrating the clouds
-        float transmittance = computeLightTransmittance(rayPosition, lightDirection);
+        float transmittance = computeLightTransmittance(uv);
         float cosTheta = dot(rayDirection, lightDirection);
         float phase = phaseSchlick(cosTheta, k);
         
         // Calculate scatter color and opacity
-        vec3 lightColor = vec3(1.0);
+        vec3 lightColor = sunColor;
         
         vec3 ambient = cloudAmbient * density;
         vec3 scatter = lightColor * transmittance * phase * density + ambient;
         
-        color += (1.0 - opacity) * scatter * stepSize;
-        opacity += (1.0 - opacity) * density * stepSize;
+        color += (1.0 - opacity) * scatter * stride;
+        opacity += (1.0 - opacity) * density * stride;
 
         if (opacity >= 0.99) break;
-        t += stepSize;
+        t += stride;
     }
     
     if (opacity > 0.0) {
@@ -182,6 +586,8 @@ float rayMarch(vec3 rayOrigin, vec3 rayDirection, out vec3 hitPosition, out vec3
     }
 }
 
+#endif
+
 // ----------------------------------------------------------- //
 // ----------------------------------------------------------- //
 
@@ -198,7 +604,96 @@ vec3 computeRayDirection(vec2 fragp) {
 // ----------------------------------------------------------- //
 // ----------------------------------------------------------- //
 
+// G-buffer reads, for either layout (see DeferredRenderer)
+vec3 octahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec4 gbufferNormal(vec2 uv) {
+#ifdef GBUFFER_COMPACT
+    return vec4(octahedralDecode(texture(normal, uv).rg), 1.0);
+#else
+    return texture(normal, uv);
+#endif
+}
+
+vec3 gbufferPosition(vec2 uv) {
+#ifdef GBUFFER_COMPACT
+    return cameraPosition + computeRayDirection(uv * screenSize) * texture(distanceToCamera, uv).r;
+#else
+    return texture(position, uv).xyz;
+#endif
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+#ifdef ATMOSPHERE_LUT
+// The sun through the atmosphere, and the sky overhead as the ambient light
+void skyLighting() {
+    sunColor = atmosphereSunColor();
+    cloudAmbient = 1.0 - exp(-texture(skyViewLUT, skyViewUV(vec3(0.0, 1.0, 0.0))).rgb * skyExposure);
+}
+#endif
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+#ifdef CLOUD_TARGET
+
+// Marches one full-resolution pixel out of every cloudScale x cloudScale block (picked
+// by cloudJitter) and writes premultiplied colour and opacity, plus the cloud and
+// scene distances the reprojection pass needs. The background is added later.
 void main() {
+    boxMin = boxPosition - halfSize;
+    boxMax = boxPosition + halfSize;
+#ifdef ATMOSPHERE_LUT
+    skyLighting();
+#endif
+
+    vec2 pixel = floor(gl_FragCoord.xy) * float(cloudScale) + cloudJitter + 0.5;
+    vec3 rayDirection = computeRayDirection(pixel);
+    float depth = texture(distanceToCamera, pixel / screenSize).r;
+
+    float tNear, tFar;
+    if (!intersectBox(cameraPosition, rayDirection, tNear, tFar)) {
+        fragc = vec4(0.0);
+        cloudDistance = vec4(1000.0, depth, 0.0, 0.0);
+        return;
+    }
+
+    vec3 hitPosition, cloudColor;
+    float opacity = rayMarch(cameraPosition, rayDirection, hitPosition, cloudColor);
+
+    if (opacity <= 0.0) {
+        fragc = vec4(0.0);
+        cloudDistance = vec4(max(tNear, 0.0), depth, 0.0, 0.0);
+        return;
+    }
+
+    vec3 toneMappedCloud = cloudColor / (cloudColor + vec3(1.0));
+    toneMappedCloud = pow(toneMappedCloud, vec3(1.0 / 2.2));
+
+    fragc = vec4(toneMappedCloud * opacity, opacity);
+    cloudDistance = vec4(length(hitPosition - cameraPosition), depth, 0.0, 0.0);
+}
+
+#else
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+void main() {
+    boxMin = boxPosition - halfSize;
+    boxMax = boxPosition + halfSize;
+#ifdef ATMOSPHERE_LUT
+    skyLighting();
+#endif
+
     vec3 rayDirection = computeRayDirection(gl_FragCoord.xy);
     
     vec2 uv = gl_FragCoord.xy;
@@ -212,6 +707,9 @@ void main() {
         float y = viewDir.y;
 
         vec3 skyColor;
+#ifdef ATMOSPHERE_LUT
+        skyColor = atmosphereSky(viewDir);
+#else
         if (y > 0.0) {
             float t = pow(y, 0.65);
             skyColor = mix(horizonColor, zenithColor, t);
@@ -219,17 +717,18 @@ void main() {
             float t = pow(-y, 0.7);
             skyColor = mix(horizonColor, groundColor, t);
         }
+#endif
 
         fragc = vec4(skyColor, 1.0);
     }
     else {
-        fragc = texture(normal, fs_in.uv);
+        fragc = gbufferNormal(fs_in.uv);
     }
 
     float tNear, tFar;
         
     if (!intersectBox(cameraPosition, rayDirection, tNear, tFar)) {
-        fragc += texture(normal, fs_in.uv);
+        fragc += gbufferNormal(fs_in.uv);
         return;
     }
     
@@ -243,3 +742,5 @@ void main() {
 
     fragc = (opacity > 0.0) ? vec4(mix(background, toneMappedCloud, opacity), 1.0) : vec4(background, 1.0);
 }
+
+#endif
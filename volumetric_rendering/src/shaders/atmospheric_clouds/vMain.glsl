@@ -4,10 +4,20 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 uv;
 
-uniform mat4 projection;
-uniform mat4 lookAt;
 uniform mat4 model;
 
+#ifdef CLOUD_PROXY
+// ----- Per-frame camera, shared by every program ----- //
+layout (std140) uniform CameraBlock {
+    mat4 projection;
+    mat4 lookAt;
+    mat4 inverseProjection;
+    mat4 inverseLookAt;
+    vec3 cameraPosition;
+    vec2 screenSize;
+};
+#endif
+
 out prop {
     vec3 normal;
     vec3 fragp;
@@ -19,6 +29,11 @@ void main() {
     vs_out.fragp = vec3(model * vec4(position, 1.0));
     vs_out.uv = uv;
 
+#ifdef CLOUD_PROXY
+    // The cloud box itself rather than a full-screen quad (see CloudReprojection)
+    gl_Position = projection * lookAt * model * vec4(position, 1.0);
+#else
     gl_Position = vec4(position.xy, 0.0, 1.0);
+#endif
     gl_PointSize = 20.0;
 }
@@ -11,8 +11,6 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 uv;
 
-uniform mat4 projection;
-uniform mat4 lookAt;
 uniform mat4 model;
 
 out prop {
@@ -0,0 +1,156 @@
+#version 410 core
+
+// Draws the background (sky, or the G-buffer for geometry) and lays the full-resolution
+// clouds from the reprojection pass over it. The clouds are premultiplied by opacity.
+// With BACKGROUND_PASS it draws only the background, for clouds blended on afterwards.
+
+// ----- G-BUFFER TEXTURES ----- //
+uniform sampler2D distanceToCamera;
+uniform sampler2D normal;
+
+#ifndef BACKGROUND_PASS
+// ----- Upsampled clouds ----- //
+uniform sampler2D clouds;
+#endif
+
+// ----- Output Color ----- //
+out vec4 fragc;
+
+// ----- Per-frame camera, shared by every program ----- //
+layout (std140) uniform CameraBlock {
+    mat4 projection;
+    mat4 lookAt;
+    mat4 inverseProjection;
+    mat4 inverseLookAt;
+    vec3 cameraPosition;
+    vec2 screenSize;
+};
+
+in prop {
+    vec2 uv;
+} fs_in;
+
+#ifdef ATMOSPHERE_LUT
+// ----- Precomputed sky (see SkyAtmosphere); lengths in kilometres ----- //
+uniform sampler2D transmittanceLUT;
+uniform sampler2D skyViewLUT;
+uniform vec3 sunDirection;
+uniform vec3 atmosphereRadii;       // ground, top of the atmosphere, observer
+uniform float skyExposure;
+
+// transmittanceLutUV in atmosphere.h
+vec2 transmittanceUV(float r, float mu) {
+    float bottom = atmosphereRadii.x, top = atmosphereRadii.y;
+    float horizon = sqrt(top * top - bottom * bottom);
+    float rho = sqrt(max(r * r - bottom * bottom, 0.0));
+
+    float rayLength = max(-r * mu + sqrt(max(r * r * (mu * mu - 1.0) + top * top, 0.0)), 0.0);
+    float minimum = top - r, maximum = rho + horizon;
+    return vec2((rayLength - minimum) / (maximum - minimum), rho / horizon);
+}
+
+// The inverse of skyViewZenithAngle in atmosphere.h, with the azimuth measured from the sun
+vec2 skyViewUV(vec3 direction) {
+    float r = atmosphereRadii.z, bottom = atmosphereRadii.x;
+    float beta = acos(sqrt(r * r - bottom * bottom) / r);
+    float horizonZenith = 3.14159265 - beta;
+
+    float zenithAngle = acos(clamp(direction.y, -1.0, 1.0));
+    float v = zenithAngle < horizonZenith ? 0.5 - 0.5 * sqrt(1.0 - zenithAngle / horizonZenith)
+                                          : 0.5 + 0.5 * sqrt((zenithAngle - horizonZenith) / beta);
+
+    float azimuth = 1.0;
+    if (length(direction.xz) > 1e-5 && length(sunDirection.xz) > 1e-5) {
+        azimuth = dot(normalize(direction.xz), normalize(sunDirection.xz));
+    }
+    return vec2(sqrt(clamp(0.5 - 0.5 * azimuth, 0.0, 1.0)), v);
+}
+
+// Sunlight reaching the observer, black once the sun is behind the planet
+vec3 atmosphereSunColor() {
+    float r = atmosphereRadii.z, mu = sunDirection.y, bottom = atmosphereRadii.x;
+    if (mu < 0.0 && r * r * (mu * mu - 1.0) + bottom * bottom >= 0.0) return vec3(0.0);
+    return texture(transmittanceLUT, transmittanceUV(r, mu)).rgb;
+}
+
+vec3 atmosphereSky(vec3 direction) {
+    vec3 luminance = texture(skyViewLUT, skyViewUV(direction)).rgb;
+
+    // The sun's disk, about half a degree across
+    if (dot(direction, sunDirection) > 0.99996) luminance += atmosphereSunColor() * 20.0;
+    return 1.0 - exp(-luminance * skyExposure);
+}
+#endif
+
+vec3 zenithColor = vec3(0.05, 0.15, 0.4);
+vec3 horizonColor = vec3(0.6, 0.7, 0.9);
+vec3 groundColor = vec3(0.4, 0.35, 0.3);
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+vec3 computeRayDirection(vec2 fragp) {
+    vec2 uv = (fragp / screenSize) * 2.0 - 1.0;
+    vec4 clip = vec4(uv, -1.0, 1.0);
+    vec4 view = inverseProjection * clip;
+    view.z = -1.0;
+    view.w = 0.0;
+    vec4 world = inverseLookAt * view;
+    return normalize(world.xyz);
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+// G-buffer reads, for either layout (see DeferredRenderer)
+vec3 octahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec4 gbufferNormal(vec2 uv) {
+#ifdef GBUFFER_COMPACT
+    return vec4(octahedralDecode(texture(normal, uv).rg), 1.0);
+#else
+    return texture(normal, uv);
+#endif
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+void main() {
+    vec2 uv = gl_FragCoord.xy / screenSize;
+    float depth = texture(distanceToCamera, uv).r;
+
+    vec3 background;
+    if (depth <= 0.0001) {
+        vec3 viewDir = computeRayDirection(gl_FragCoord.xy);
+        float y = viewDir.y;
+
+#ifdef ATMOSPHERE_LUT
+        background = atmosphereSky(viewDir);
+#else
+        if (y > 0.0) {
+            float t = pow(y, 0.65);
+            background = mix(horizonColor, zenithColor, t);
+        } else {
+            float t = pow(-y, 0.7);
+            background = mix(horizonColor, groundColor, t);
+        }
+#endif
+    }
+    else {
+        background = gbufferNormal(fs_in.uv).rgb;
+    }
+
+#ifdef BACKGROUND_PASS
+    fragc = vec4(background, 1.0);
+#else
+    vec4 cloud = texture(clouds, uv);
+    fragc = vec4(background * (1.0 - cloud.a) + cloud.rgb, 1.0);
+#endif
+}
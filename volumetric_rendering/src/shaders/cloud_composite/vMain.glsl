@@ -0,0 +1,15 @@
+#version 410 core
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 uv;
+
+out prop {
+    vec2 uv;
+} vs_out;
+
+void main() {
+    vs_out.uv = uv;
+
+    gl_Position = vec4(position.xy, 0.0, 1.0);
+}
@@ -0,0 +1,121 @@
+#version 410 core
+
+// Brings the reduced-resolution clouds up to full resolution and blends them into the
+// reprojected history. The upsample is bilinear, with each low-resolution sample
+// weighted down when the scene distance it saw differs from this pixel's. The history
+// is clamped to the colours around this pixel in the new frame, so anything that was
+// uncovered or moved does not leave a trail behind.
+
+// ----- G-BUFFER TEXTURES ----- //
+uniform sampler2D distanceToCamera;
+
+// ----- Reduced-resolution clouds and the previous result ----- //
+uniform sampler2D cloudColor;
+uniform sampler2D cloudDistance;
+uniform sampler2D history;
+
+uniform mat4 previousViewProjection;
+uniform int cloudScale;
+uniform vec2 cloudJitter;
+uniform float historyWeight;
+
+// ----- Output Color ----- //
+layout (location = 0) out vec4 fragc;
+
+// ----- Per-frame camera, shared by every program ----- //
+layout (std140) uniform CameraBlock {
+    mat4 projection;
+    mat4 lookAt;
+    mat4 inverseProjection;
+    mat4 inverseLookAt;
+    vec3 cameraPosition;
+    vec2 screenSize;
+};
+
+in prop {
+    vec2 uv;
+} fs_in;
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+vec3 computeRayDirection(vec2 fragp) {
+    vec2 uv = (fragp / screenSize) * 2.0 - 1.0;
+    vec4 clip = vec4(uv, -1.0, 1.0);
+    vec4 view = inverseProjection * clip;
+    view.z = -1.0;
+    view.w = 0.0;
+    vec4 world = inverseLookAt * view;
+    return normalize(world.xyz);
+}
+
+// The G-buffer is cleared to 0 where nothing was drawn; treat that as very far away
+float sceneDistance(float distance) {
+    return distance <= 0.0001 ? 10000.0 : distance;
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+void main() {
+    vec2 pixel = gl_FragCoord.xy;
+    ivec2 lowSize = textureSize(cloudColor, 0);
+
+    // Low-resolution texel i was marched at full-resolution pixel i * cloudScale + cloudJitter
+    vec2 lowPosition = (pixel - 0.5 - cloudJitter) / float(cloudScale);
+    ivec2 base = ivec2(floor(lowPosition));
+    vec2 f = lowPosition - vec2(base);
+
+    float depth = sceneDistance(texture(distanceToCamera, pixel / screenSize).r);
+
+    vec4 current = vec4(0.0);
+    float currentDistance = 0.0;
+    float totalWeight = 0.0;
+
+    for (int y = 0; y <= 1; y++) {
+        for (int x = 0; x <= 1; x++) {
+            ivec2 texel = clamp(base + ivec2(x, y), ivec2(0), lowSize - 1);
+            vec4 color = texelFetch(cloudColor, texel, 0);
+            vec2 distances = texelFetch(cloudDistance, texel, 0).rg;
+
+            float bilinear = (x == 0 ? 1.0 - f.x : f.x) * (y == 0 ? 1.0 - f.y : f.y);
+            float edge = exp(-abs(sceneDistance(distances.g) - depth) / (0.05 * depth));
+            float weight = bilinear * edge + 0.0001;
+
+            current += color * weight;
+            currentDistance += distances.r * weight;
+            totalWeight += weight;
+        }
+    }
+    current /= totalWeight;
+    currentDistance /= totalWeight;
+
+    if (historyWeight <= 0.0) {
+        fragc = current;
+        return;
+    }
+
+    // Range of the new frame around this pixel
+    ivec2 center = clamp(ivec2(floor(lowPosition + 0.5)), ivec2(0), lowSize - 1);
+    vec4 minimum = vec4(1.0), maximum = vec4(0.0);
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec4 color = texelFetch(cloudColor, clamp(center + ivec2(x, y), ivec2(0), lowSize - 1), 0);
+            minimum = min(minimum, color);
+            maximum = max(maximum, color);
+        }
+    }
+
+    // Where this point of the cloud was on screen last frame
+    vec3 world = cameraPosition + computeRayDirection(pixel) * currentDistance;
+    vec4 previous = previousViewProjection * vec4(world, 1.0);
+    vec2 previousUv = (previous.xy / previous.w) * 0.5 + 0.5;
+
+    if (previous.w <= 0.0 || any(lessThan(previousUv, vec2(0.0))) || any(greaterThan(previousUv, vec2(1.0)))) {
+        fragc = current;
+        return;
+    }
+
+    vec4 reprojected = clamp(texture(history, previousUv), minimum, maximum);
+    fragc = mix(current, reprojected, historyWeight);
+}
@@ -1,21 +1,50 @@
 #version 410 core
 
+#ifndef GBUFFER_COMPACT
 layout (location = 0) out vec4 fragp;
+#endif
 layout (location = 1) out vec4 dst;
 layout (location = 2) out vec4 normal;
 layout (location = 3) out vec4 fragc;
 
-uniform vec3 cameraPosition;
+// ----- Per-frame camera, shared by every program ----- //
+layout (std140) uniform CameraBlock {
+    mat4 projection;
+    mat4 lookAt;
+    mat4 inverseProjection;
+    mat4 inverseLookAt;
+    vec3 cameraPosition;
+    vec2 screenSize;
+};
 
 in prop {
     vec3 normal;
     vec3 fragp;
 } fs_in;
 
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+// Unit normal folded onto the octahedron and flattened into [-1, 1]^2
+vec2 octahedralEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return n.xy;
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
 void main() {
     fragc = vec4(vec3(1.0), 1.0);
+#ifdef GBUFFER_COMPACT
+    normal = vec4(octahedralEncode(normalize(fs_in.normal)), 0.0, 1.0);
+#else
     fragp = vec4(fs_in.fragp, 1.0);
     normal = vec4(fs_in.normal, 1.0);
+#endif
 
     float linearDepth = length(fs_in.fragp - cameraPosition);
     dst = vec4(linearDepth, 0.0, 0.0, 1.0);
@@ -4,9 +4,22 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 uv;
 
-uniform mat4 projection;
-uniform mat4 lookAt;
+// ----- Per-frame camera, shared by every program ----- //
+layout (std140) uniform CameraBlock {
+    mat4 projection;
+    mat4 lookAt;
+    mat4 inverseProjection;
+    mat4 inverseLookAt;
+    vec3 cameraPosition;
+    vec2 screenSize;
+};
+
+#ifdef INSTANCED
+// One model matrix per instance, see MeshBatch
+layout (location = 3) in mat4 instanceModel;
+#else
 uniform mat4 model;
+#endif
 
 out prop {
     vec3 normal;
@@ -14,6 +27,9 @@ out prop {
 } vs_out;
 
 void main() {
+#ifdef INSTANCED
+    mat4 model = instanceModel;
+#endif
     vs_out.normal = normalize(transpose(inverse(mat3(model))) * normal);
     vs_out.fragp = vec3(model * vec4(position, 1.0));
 
@@ -0,0 +1,176 @@
+//
+//  file_watcher.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef file_watcher_h
+#define file_watcher_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Watches directories on a background thread and collects the files in them that were
+// written. On Linux it sleeps on inotify; elsewhere, or if inotify is unavailable, it
+// compares modification times every pollInterval. Changed() hands the collected paths
+// to the caller and forgets them.
+class FileWatcher {
+public:
+    std::chrono::milliseconds pollInterval{250};
+
+    FileWatcher() = default;
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Both may be called from any thread, before or after Start()
+    void Watch(const std::string& directory);
+    std::vector<std::string> Changed();
+
+    void Start();
+    void Stop();
+
+private:
+    std::mutex mutex;
+    std::vector<std::string> directories, added, changed;
+    std::thread worker;
+    std::atomic<bool> running{false};
+
+    void Report(const std::string& path);
+    std::vector<std::string> TakeAdded();
+    void RunInotify(int descriptor);
+    void RunPolling();
+};
+
+FileWatcher::~FileWatcher() {
+    Stop();
+}
+
+void FileWatcher::Watch(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::find(directories.begin(), directories.end(), directory) != directories.end()) return;
+    directories.push_back(directory);
+    added.push_back(directory);
+}
+
+std::vector<std::string> FileWatcher::Changed() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> paths;
+    paths.swap(changed);
+    return paths;
+}
+
+void FileWatcher::Start() {
+    if (running.exchange(true)) return;
+
+    worker = std::thread([this]() {
+#if defined(__linux__)
+        int descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (descriptor >= 0) {
+            RunInotify(descriptor);
+            close(descriptor);
+            return;
+        }
+#endif
+        RunPolling();
+    });
+}
+
+void FileWatcher::Stop() {
+    running.store(false);
+    if (worker.joinable()) worker.join();
+}
+
+void FileWatcher::Report(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::find(changed.begin(), changed.end(), path) == changed.end()) changed.push_back(path);
+}
+
+std::vector<std::string> FileWatcher::TakeAdded() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> directories;
+    directories.swap(added);
+    return directories;
+}
+
+#if defined(__linux__)
+// Editors either rewrite a file in place (close after write) or write a new one and
+// rename it over the old (moved to); both count as a change
+void FileWatcher::RunInotify(int descriptor) {
+
+    std::map<int, std::string> watches;
+    alignas(inotify_event) char buffer[4096];
+
+    while (running.load()) {
+        for (const std::string& directory : TakeAdded()) {
+            int watch = inotify_add_watch(descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+            if (watch >= 0) watches[watch] = directory;
+        }
+
+        pollfd request = { descriptor, POLLIN, 0 };
+        if (poll(&request, 1, (int)pollInterval.count()) <= 0) continue;
+
+        ssize_t length;
+        while ((length = read(descriptor, buffer, sizeof(buffer))) > 0) {
+            for (char* event = buffer; event < buffer + length; event += sizeof(inotify_event) + ((inotify_event*)event)->len) {
+                const inotify_event* notification = (const inotify_event*)event;
+                auto watch = watches.find(notification->wd);
+                if (watch == watches.end() || notification->len == 0) continue;
+                Report(watch->second + "/" + notification->name);
+            }
+        }
+    }
+}
+#else
+void FileWatcher::RunInotify(int descriptor) {}
+#endif
+
+void FileWatcher::RunPolling() {
+
+    std::map<std::string, std::filesystem::file_time_type> times;
+    std::vector<std::string> watched;
+
+    while (running.load()) {
+        for (const std::string& directory : TakeAdded()) {
+            watched.push_back(directory);
+
+            // Files already there are the baseline, not changes
+            std::error_code error;
+            for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+                times[entry.path().string()] = entry.last_write_time(error);
+            }
+        }
+
+        for (const std::string& directory : watched) {
+            std::error_code error;
+            for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+                std::string path = entry.path().string();
+                std::filesystem::file_time_type time = entry.last_write_time(error);
+
+                auto known = times.find(path);
+                if (known != times.end() && known->second == time) continue;
+                times[path] = time;
+                Report(path);
+            }
+        }
+
+        std::this_thread::sleep_for(pollInterval);
+    }
+}
+
+#endif /* file_watcher_h */
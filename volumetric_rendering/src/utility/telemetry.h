@@ -0,0 +1,291 @@
+//
+//  telemetry.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef telemetry_h
+#define telemetry_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Frame, camera, pass-timing, generation and log events from the render thread. Pushing
+// never blocks and never touches a file: events go into a single-producer,
+// single-consumer ring and a background thread drains it. When the ring is full the
+// event is dropped and counted instead.
+//
+// VOLUMETRIC_TELEMETRY=<path> writes every event to that file, as JSON lines, or as raw
+// TelemetryEvent records after an 8-byte "VRNTELE1" tag if the path ends in .bin.
+// Without it only log events are kept, and printed to stdout by the drain thread.
+enum TelemetryEventType : uint8_t {
+    TelemetryFrame,
+    TelemetryCamera,
+    TelemetryPass,
+    TelemetryGeneration,
+    TelemetryLog,
+};
+
+// Fixed size so the ring is one flat array. Text longer than `text` is split over
+// several log events; all but the last have `more` set.
+struct TelemetryEvent {
+    uint8_t type;
+    uint8_t gpu;
+    uint8_t more;
+    uint8_t reserved;
+    uint32_t frame;
+    double seconds;             // since Start()
+    float values[5];
+    char text[36];
+};
+static_assert(sizeof(TelemetryEvent) == 72, "telemetry event layout changed");
+
+const size_t telemetryCapacity = 4096;      // a power of two
+
+class TelemetryRing {
+public:
+    TelemetryRing() : events(telemetryCapacity) {}
+
+    // Producer side only
+    bool Push(const TelemetryEvent& event) {
+        uint64_t head = this->head.load(std::memory_order_relaxed);
+        if (head - tail.load(std::memory_order_acquire) >= telemetryCapacity) return false;
+
+        events[head & (telemetryCapacity - 1)] = event;
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side only
+    bool Pop(TelemetryEvent& event) {
+        uint64_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail == head.load(std::memory_order_acquire)) return false;
+
+        event = events[tail & (telemetryCapacity - 1)];
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<TelemetryEvent> events;
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+};
+
+class Telemetry {
+public:
+    std::atomic<uint64_t> pushed{0}, dropped{0};
+
+    Telemetry() = default;
+    ~Telemetry();
+
+    Telemetry(const Telemetry&) = delete;
+    Telemetry& operator=(const Telemetry&) = delete;
+
+    void Start();
+    void Stop();
+
+    // Render thread only
+    void Frame(int frame, double milliseconds);
+    void Camera(const float position[3], float yaw, float pitch);
+    void Pass(const char* name, bool gpu, double milliseconds);
+    void Generation(const char* stage, int items, double milliseconds);
+    void Log(const std::string& text);
+
+private:
+    TelemetryRing ring;
+    std::thread worker;
+    std::atomic<bool> running{false};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint32_t frame = 0;
+
+    FILE* file = nullptr;
+    bool binary = false;
+    std::string pendingLog;
+    uint64_t reportedDrops = 0;
+
+    TelemetryEvent Event(TelemetryEventType type);
+    void Push(const TelemetryEvent& event);
+    void Drain();
+    void Write(const TelemetryEvent& event);
+};
+
+Telemetry telemetry;
+
+Telemetry::~Telemetry() {
+    Stop();
+}
+
+void Telemetry::Start() {
+    if (running.exchange(true)) return;
+
+    const char* path = std::getenv("VOLUMETRIC_TELEMETRY");
+    if (path) {
+        std::string name = path;
+        binary = name.size() >= 4 && name.compare(name.size() - 4, 4, ".bin") == 0;
+        file = fopen(path, binary ? "wb" : "w");
+        if (file && binary) fwrite("VRNTELE1", 1, 8, file);
+    }
+
+    worker = std::thread([this]() {
+        while (running.load(std::memory_order_acquire)) {
+            Drain();
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        Drain();
+    });
+}
+
+// Drains what is left, then writes the counters as the last line
+void Telemetry::Stop() {
+    if (!running.exchange(false)) return;
+    worker.join();
+
+    if (file) {
+        if (!binary) fprintf(file, "{\"type\": \"summary\", \"pushed\": %llu, \"dropped\": %llu}\n",
+                             (unsigned long long)pushed.load(), (unsigned long long)dropped.load());
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+TelemetryEvent Telemetry::Event(TelemetryEventType type) {
+    TelemetryEvent event;
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    event.frame = frame;
+    event.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return event;
+}
+
+void Telemetry::Push(const TelemetryEvent& event) {
+    if (ring.Push(event)) pushed.fetch_add(1, std::memory_order_relaxed);
+    else dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Telemetry::Frame(int frame, double milliseconds) {
+    this->frame = (uint32_t)frame;
+    TelemetryEvent event = Event(TelemetryFrame);
+    event.values[0] = (float)milliseconds;
+    Push(event);
+}
+
+void Telemetry::Camera(const float position[3], float yaw, float pitch) {
+    TelemetryEvent event = Event(TelemetryCamera);
+    std::copy(position, position + 3, event.values);
+    event.values[3] = yaw;
+    event.values[4] = pitch;
+    Push(event);
+}
+
+void Telemetry::Pass(const char* name, bool gpu, double milliseconds) {
+    TelemetryEvent event = Event(TelemetryPass);
+    event.gpu = gpu;
+    event.values[0] = (float)milliseconds;
+    snprintf(event.text, sizeof(event.text), "%s", name);
+    Push(event);
+}
+
+void Telemetry::Generation(const char* stage, int items, double milliseconds) {
+    TelemetryEvent event = Event(TelemetryGeneration);
+    event.values[0] = (float)milliseconds;
+    event.values[1] = (float)items;
+    snprintf(event.text, sizeof(event.text), "%s", stage);
+    Push(event);
+}
+
+void Telemetry::Log(const std::string& text) {
+    size_t chunk = sizeof(TelemetryEvent::text) - 1;
+    for (size_t offset = 0; offset < std::max(text.size(), (size_t)1); offset += chunk) {
+        TelemetryEvent event = Event(TelemetryLog);
+        event.more = offset + chunk < text.size();
+        memcpy(event.text, text.data() + offset, std::min(chunk, text.size() - offset));
+        Push(event);
+    }
+}
+
+// ----------------------------------------------------------- //
+// ----------------------------------------------------------- //
+
+void Telemetry::Drain() {
+
+    TelemetryEvent event;
+    while (ring.Pop(event)) Write(event);
+
+    uint64_t drops = dropped.load(std::memory_order_relaxed);
+    if (file && !binary && drops != reportedDrops) {
+        fprintf(file, "{\"type\": \"dropped\", \"count\": %llu}\n", (unsigned long long)drops);
+        reportedDrops = drops;
+    }
+    if (file) fflush(file);
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        switch (c) {
+            case '"':  escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if ((unsigned char)c >= 0x20) escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void Telemetry::Write(const TelemetryEvent& event) {
+
+    if (file && binary) fwrite(&event, sizeof(event), 1, file);
+
+    std::string text(event.text, strnlen(event.text, sizeof(event.text)));
+
+    // Log text arrives in pieces; act on it once the last piece is in
+    if (event.type == TelemetryLog) {
+        pendingLog += text;
+        if (event.more) return;
+        text.swap(pendingLog);
+        pendingLog.clear();
+
+        if (!file) {
+            fwrite(text.data(), 1, text.size(), stdout);
+            fputc('\n', stdout);
+            fflush(stdout);
+        }
+    }
+
+    if (!file || binary) return;
+
+    switch (event.type) {
+        case TelemetryFrame:
+            fprintf(file, "{\"type\": \"frame\", \"frame\": %u, \"t\": %.6f, \"ms\": %.4f}\n", event.frame, event.seconds, event.values[0]);
+            break;
+        case TelemetryCamera:
+            fprintf(file, "{\"type\": \"camera\", \"frame\": %u, \"t\": %.6f, \"position\": [%.6g, %.6g, %.6g], \"yaw\": %.6g, \"pitch\": %.6g}\n",
+                    event.frame, event.seconds, event.values[0], event.values[1], event.values[2], event.values[3], event.values[4]);
+            break;
+        case TelemetryPass:
+            fprintf(file, "{\"type\": \"pass\", \"frame\": %u, \"t\": %.6f, \"name\": \"%s\", \"kind\": \"%s\", \"ms\": %.4f}\n",
+                    event.frame, event.seconds, jsonEscape(text).c_str(), event.gpu ? "gpu" : "cpu", event.values[0]);
+            break;
+        case TelemetryGeneration:
+            fprintf(file, "{\"type\": \"generation\", \"frame\": %u, \"t\": %.6f, \"stage\": \"%s\", \"items\": %d, \"ms\": %.4f}\n",
+                    event.frame, event.seconds, jsonEscape(text).c_str(), (int)event.values[1], event.values[0]);
+            break;
+        case TelemetryLog:
+            fprintf(file, "{\"type\": \"log\", \"frame\": %u, \"t\": %.6f, \"text\": \"%s\"}\n", event.frame, event.seconds, jsonEscape(text).c_str());
+            break;
+    }
+}
+
+#endif /* telemetry_h */
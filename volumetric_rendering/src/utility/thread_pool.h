@@ -0,0 +1,185 @@
+//
+//  thread_pool.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef thread_pool_h
+#define thread_pool_h
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool. Every worker owns a deque: it pops its own work from the back
+// and steals from the front of the others when it runs dry. The thread calling
+// ParallelFor helps out until its batch is done, so a pool with zero workers still works.
+class ThreadPool {
+public:
+    static ThreadPool& Shared();
+
+    ThreadPool(int workerCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Runs body(chunkBegin, chunkEnd) over [begin, end) in chunks of at most `grain`
+    void ParallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body);
+    int ThreadCount();
+
+private:
+    struct Batch {
+        std::atomic<int> remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    struct Task {
+        std::function<void()> run;
+        std::shared_ptr<Batch> batch;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int> queued{0};
+    std::atomic<unsigned int> nextQueue{0};
+    bool stopping = false;
+
+    void WorkerLoop(int index);
+    bool TryPop(int index, Task& task);
+    bool TrySteal(int index, Task& task);
+    void Execute(Task& task);
+};
+
+ThreadPool& ThreadPool::Shared() {
+    static ThreadPool pool((int)std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+ThreadPool::ThreadPool(int workerCount) {
+
+    // The calling thread always gets a queue of its own at index 0
+    for (int i = 0; i < workerCount + 1; i++) queues.push_back(std::make_unique<Queue>());
+    for (int i = 0; i < workerCount; i++) workers.emplace_back(&ThreadPool::WorkerLoop, this, i + 1);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+int ThreadPool::ThreadCount() {
+    return (int)workers.size() + 1;
+}
+
+void ThreadPool::ParallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body) {
+
+    if (end <= begin) return;
+    grain = std::max(grain, 1);
+
+    int chunks = (end - begin + grain - 1) / grain;
+    if (chunks == 1 || workers.empty()) {
+        for (int i = begin; i < end; i += grain) body(i, std::min(i + grain, end));
+        return;
+    }
+
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->remaining = chunks;
+
+    // Spread the chunks round-robin so every worker starts with local work
+    for (int c = 0; c < chunks; c++) {
+        int chunkBegin = begin + c * grain,
+            chunkEnd = std::min(chunkBegin + grain, end);
+
+        Queue& queue = *queues[nextQueue++ % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back({[&body, chunkBegin, chunkEnd]() { body(chunkBegin, chunkEnd); }, batch});
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued += chunks;
+    }
+    wake.notify_all();
+
+    // Help until this batch has drained, then wait for chunks still running elsewhere
+    Task task;
+    while (batch->remaining > 0 && (TryPop(0, task) || TrySteal(0, task))) Execute(task);
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->done.wait(lock, [&]() { return batch->remaining == 0; });
+}
+
+void ThreadPool::WorkerLoop(int index) {
+
+    Task task;
+    while (true) {
+        if (TryPop(index, task) || TrySteal(index, task)) {
+            Execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [&]() { return stopping || queued > 0; });
+        if (stopping) return;
+    }
+}
+
+bool ThreadPool::TryPop(int index, Task& task) {
+
+    Queue& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    queued--;
+    return true;
+}
+
+bool ThreadPool::TrySteal(int index, Task& task) {
+
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        Queue& queue = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::Execute(Task& task) {
+
+    task.run();
+
+    std::shared_ptr<Batch> batch = std::move(task.batch);
+    task.run = nullptr;
+
+    if (--batch->remaining == 0) {
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        batch->done.notify_all();
+    }
+}
+
+#endif /* thread_pool_h */
@@ -0,0 +1,30 @@
+//
+//  volume_core.h
+//  volumetric_rendering
+//
+//  Created by Dmitri Wamback on 2026-10-17.
+//
+
+#ifndef volume_core_h
+#define volume_core_h
+
+// The CPU side of the clouds: noise, volume generation and its caches, bricks, cloud
+// scenes, the reference renderer and the sky tables. Nothing here includes GL, so the
+// benchmarks can build it on its own; core.h includes it ahead of everything that does.
+#include "utility/thread_pool.h"
+
+#include "rendering/noise.h"
+#include "rendering/noise_simd.h"
+#include "rendering/noise_graph.h"
+#include "rendering/macrocells.h"
+#include "rendering/volume_mips.h"
+#include "rendering/volume_quantize.h"
+#include "rendering/volume_cache.h"
+#include "rendering/transmittance.h"
+#include "rendering/atmosphere.h"
+#include "rendering/noise_volume.h"
+#include "rendering/bricks.h"
+#include "rendering/cloud_scene.h"
+#include "rendering/reference_renderer.h"
+
+#endif /* volume_core_h */